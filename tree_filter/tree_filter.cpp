@@ -21,9 +21,30 @@ int wmain(int argc, wchar_t** argv)
       if (!result.empty())
          wcout << result << endl;
 
-      if (ctx.current_tree->get_filtered_tree())
+      if (!ctx.streamed_filename.empty())
+      {
+         result = ctx.filter_streamed_file(wcout);
+         if (!result.empty())
+            wcout << result << endl;
+      }
+      else if (ctx.lazy_tree)
+      {
+         result = ctx.filter_lazy_tree(wcout);
+         if (!result.empty())
+            wcout << result << endl;
+      }
+      else if (ctx.current_tree && ctx.current_tree->get_filtered_tree())
+      {
          print_tree(wcout, *ctx.current_tree->get_filtered_tree(), ctx.options.output_line_indent) << endl;
 
+         if (ctx.is_following)
+         {
+            result = ctx.follow_current_tree(wcout);
+            if (!result.empty())
+               wcout << result << endl;
+         }
+      }
+
       if (!ctx.is_interactive)
          break;
 
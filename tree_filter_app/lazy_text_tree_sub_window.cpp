@@ -0,0 +1,82 @@
+#include "lazy_text_tree_sub_window.h"
+#include "text_tree_model.h"
+
+#include "dak/tree_reader/tree_filtering.h"
+#include "dak/tree_reader/tree_filter_helpers.h"
+
+#include <QtWidgets/qtreeview.h>
+
+#include <chrono>
+
+namespace dak::tree_reader::app
+{
+   using namespace dak::tree_reader;
+   using namespace std;
+
+   lazy_text_tree_sub_window_t::lazy_text_tree_sub_window_t(const lazy_text_tree_ptr_t& a_tree, const filesystem::path& path)
+   : tree(a_tree)
+   {
+      _tree_view = new QTreeView;
+      _tree_view->setUniformRowHeights(true);
+      _tree_view->setHeaderHidden(true);
+      _tree_view->setSizePolicy(QSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding));
+
+      _model = new text_tree_model_t;
+      _model->set_tree(tree);
+
+      auto old_model = _tree_view->model();
+      _tree_view->setModel(_model);
+      delete old_model;
+
+      setWidget(_tree_view);
+
+      setWindowTitle(QString::fromStdWString(path.wstring()));
+      setAttribute(Qt::WA_DeleteOnClose);
+   }
+
+   lazy_text_tree_sub_window_t::~lazy_text_tree_sub_window_t()
+   {
+      if (_filtering.valid())
+         _filtering.wait();
+   }
+
+   bool lazy_text_tree_sub_window_t::filter_async(const tree_filter_ptr_t& filter)
+   {
+      if (!filter)
+      {
+         if (_filtering.valid())
+            _filtering.wait();
+         _filtering = {};
+         _model->set_tree(tree);
+         return true;
+      }
+
+      if (!is_streamable_filter(filter))
+         return false;
+
+      if (_filtering.valid())
+         _filtering.wait();
+
+      // The filter is copied so the filter being edited can change during the filtering.
+      _filtering = async(launch::async, [lazy = tree, filter = deep_clone_filter(*filter)]()
+      {
+         auto filtered = make_shared<text_tree_t>();
+         filter_simple_text(*lazy, *filtered, *filter);
+         return filtered;
+      });
+
+      return true;
+   }
+
+   bool lazy_text_tree_sub_window_t::update_if_filter_ready()
+   {
+      if (!_filtering.valid())
+         return true;
+
+      if (_filtering.wait_for(chrono::seconds(0)) != future_status::ready)
+         return false;
+
+      _model->set_tree(_filtering.get());
+      return true;
+   }
+}
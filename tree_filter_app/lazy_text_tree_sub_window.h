@@ -0,0 +1,55 @@
+#pragma once
+
+#include "dak/tree_reader/lazy_text_tree.h"
+#include "dak/tree_reader/tree_filter.h"
+
+#include <QtWidgets/qmdisubwindow.h>
+
+#include <filesystem>
+#include <future>
+
+class QTreeView;
+
+namespace dak::tree_reader::app
+{
+   using lazy_text_tree_ptr_t = tree_reader::lazy_text_tree_ptr_t;
+   using text_tree_ptr_t = tree_reader::text_tree_ptr_t;
+   using tree_filter_ptr_t = tree_reader::tree_filter_ptr_t;
+   struct text_tree_model_t;
+
+   /////////////////////////////////////////////////////////////////////////
+   //
+   // A MDI sub-window for a text tree too large to be loaded.
+   //
+   // The lines of the file are only read when shown, so the tree can be
+   // browsed and filtered by the filters that only look at each line and
+   // its parents. See lazy_text_tree_t and is_streamable_filter.
+
+   struct lazy_text_tree_sub_window_t : QMdiSubWindow
+   {
+      // The tree shown.
+      lazy_text_tree_ptr_t tree;
+
+      // Create a sub-window for the lazy tree indexed from the given file.
+      lazy_text_tree_sub_window_t(const lazy_text_tree_ptr_t& tree, const std::filesystem::path& path);
+
+      // Wait for the filtering in progress, if any.
+      ~lazy_text_tree_sub_window_t();
+
+      // Filter the lines of the tree in the background, showing all lines when
+      // there is no filter. Returns false if the filter needs the loaded tree.
+      bool filter_async(const tree_filter_ptr_t& filter);
+
+      // Show the filtered lines once the filtering is done.
+      // Returns false while the filtering is in progress.
+      bool update_if_filter_ready();
+
+   private:
+      QTreeView* _tree_view;
+      text_tree_model_t* _model;
+
+      std::future<text_tree_ptr_t> _filtering;
+
+      Q_OBJECT;
+   };
+}
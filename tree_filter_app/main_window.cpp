@@ -1,6 +1,7 @@
 #include "main_window.h"
 #include "text_tree_model.h"
 #include "text_tree_sub_window.h"
+#include "lazy_text_tree_sub_window.h"
 #include "options_dialog.h"
 
 #include "dak/QtAdditions/QtUtilities.h"
@@ -460,7 +461,16 @@ namespace dak::tree_reader::app
    void main_window_t::load_tree()
    {
       filesystem::path path = AskOpen(tr("Load Text Tree"), tr(tree_commands_t::tree_file_types), this);
-      auto new_tree = _data.load_tree(path);
+
+      // Files that cannot be loaded are only indexed, and read when shown.
+      lazy_text_tree_ptr_t lazy_tree;
+      auto new_tree = _data.load_tree(path, lazy_tree);
+      if (lazy_tree)
+      {
+         add_lazy_text_tree_tab(lazy_tree, path);
+         return;
+      }
+
       add_text_tree_tab(new_tree);
       search_in_tree();
    }
@@ -492,8 +502,25 @@ namespace dak::tree_reader::app
       update_create_tab_action();
    }
 
+   void main_window_t::add_lazy_text_tree_tab(const lazy_text_tree_ptr_t& new_tree, const filesystem::path& path)
+   {
+      if (!new_tree || new_tree->size() == 0)
+         return;
+
+      auto sub_window = new lazy_text_tree_sub_window_t(new_tree, path);
+      _tabs->addSubWindow(sub_window);
+      sub_window->showMaximized();
+   }
+
    void main_window_t::update_active_tab()
    {
+      // Show the lines of a lazy tree filtered while it was not the active tab.
+      if (get_current_lazy_sub_window())
+      {
+         _filtering_timer->start(10);
+         return;
+      }
+
       auto window = get_current_sub_window();
       if (!window)
          return;
@@ -532,6 +559,11 @@ namespace dak::tree_reader::app
       return dynamic_cast<text_tree_sub_window_t*>(_tabs->currentSubWindow());
    }
 
+   lazy_text_tree_sub_window_t* main_window_t::get_current_lazy_sub_window()
+   {
+      return dynamic_cast<lazy_text_tree_sub_window_t*>(_tabs->currentSubWindow());
+   }
+
    vector<text_tree_sub_window_t*> main_window_t::get_all_sub_windows()
    {
       vector<text_tree_sub_window_t*> subs;
@@ -549,6 +581,14 @@ namespace dak::tree_reader::app
 
    void main_window_t::filter_tree()
    {
+      // Lazy trees are only filtered by the filters that look at each line and its parents.
+      if (auto lazy_window = get_current_lazy_sub_window())
+      {
+         if (lazy_window->filter_async(_filter_editor->get_edited()))
+            _filtering_timer->start(10);
+         return;
+      }
+
       auto window = get_current_sub_window();
       if (!window)
          return;
@@ -564,6 +604,13 @@ namespace dak::tree_reader::app
 
    void main_window_t::verify_async_filtering()
    {
+      if (auto lazy_window = get_current_lazy_sub_window())
+      {
+         if (!lazy_window->update_if_filter_ready())
+            _filtering_timer->start(10);
+         return;
+      }
+
       auto window = get_current_sub_window();
       if (!window)
          return;
@@ -6,6 +6,7 @@
 #include "dak/QtAdditions/QWidgetScrollListWidget.h"
 
 #include "dak/tree_reader/global_commands.h"
+#include "dak/tree_reader/lazy_text_tree.h"
 
 #include <QtWidgets/qmainwindow.h>
 
@@ -32,10 +33,12 @@ namespace dak::tree_reader::app
    using global_commands_t = tree_reader::global_commands_t;
    using undo_stack = tree_reader::undo_stack;
    using tree_commands_ptr_t = std::shared_ptr<tree_reader::tree_commands_t>;
+   using lazy_text_tree_ptr_t = tree_reader::lazy_text_tree_ptr_t;
 
    using QWidgetScrollListWidget = QtAdditions::QWidgetScrollListWidget;
 
    struct text_tree_sub_window_t;
+   struct lazy_text_tree_sub_window_t;
 
    ////////////////////////////////////////////////////////////////////////////
    //
@@ -74,11 +77,13 @@ namespace dak::tree_reader::app
 
       // Tab management.
       void add_text_tree_tab(const tree_commands_ptr_t& newTree);
+      void add_lazy_text_tree_tab(const lazy_text_tree_ptr_t& newTree, const std::filesystem::path& path);
       void update_active_tab(); 
       void update_text_tree_tab();
 
       // Current tab.
       text_tree_sub_window_t* get_current_sub_window();
+      lazy_text_tree_sub_window_t* get_current_lazy_sub_window();
       std::vector<text_tree_sub_window_t*> get_all_sub_windows();
 
       // Main window state.
@@ -47,6 +47,10 @@ namespace dak::tree_reader::app
       _tab_size_edit = new QLineEdit;
       form_layout->addRow(tr("Tab size"), _tab_size_edit);
 
+      _max_loaded_file_size_edit = new QLineEdit;
+      _max_loaded_file_size_edit->setToolTip(tr("Larger files are read only when shown. Zero loads any file that fits in memory."));
+      form_layout->addRow(tr("Maximum loaded file size (MB)"), _max_loaded_file_size_edit);
+
       _buttons = new QDialogButtonBox(QDialogButtonBox::StandardButton::Ok | QDialogButtonBox::StandardButton::Cancel);
       layout->addWidget(_buttons);
    }
@@ -65,6 +69,7 @@ namespace dak::tree_reader::app
       _input_indent_edit->setText(QString::fromStdWString(_options.read_options.input_indent));
       _input_filter_edit->setText(QString::fromStdWString(_options.read_options.input_filter));
       _tab_size_edit->setText(QString().setNum(_options.read_options.tab_size));
+      _max_loaded_file_size_edit->setText(QString().setNum(_options.max_loaded_file_megabytes));
    }
 
    // Fill the data from the UI.
@@ -74,6 +79,7 @@ namespace dak::tree_reader::app
       _options.read_options.input_indent = _input_indent_edit->text().toStdWString();
       _options.read_options.input_filter = _input_filter_edit->text().toStdWString();
       _options.read_options.tab_size = _tab_size_edit->text().toUInt();
+      _options.max_loaded_file_megabytes = _max_loaded_file_size_edit->text().toULongLong();
    }
 }
 
@@ -42,6 +42,7 @@ namespace dak::tree_reader::app
       QLineEdit* _input_indent_edit = nullptr;
       QLineEdit* _input_filter_edit = nullptr;
       QLineEdit* _tab_size_edit = nullptr;
+      QLineEdit* _max_loaded_file_size_edit = nullptr;
       QDialogButtonBox* _buttons = nullptr;
 
       Q_OBJECT;
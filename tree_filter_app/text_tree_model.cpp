@@ -4,30 +4,127 @@ namespace dak::tree_reader::app
 {
    using namespace std;
    using namespace dak::tree_reader;
-   using node = text_tree_t::node_t;
+   using node_id = size_t;
+   using lazy_node_id = lazy_text_tree_t::node_id_t;
 
-   void text_tree_model_t::reset()
+   void text_tree_model_t::set_tree(const text_tree_ptr_t& tree)
    {
       beginResetModel();
+      _tree = tree;
+      _lazy.reset();
+      _lazy_child_counts.clear();
+      _last_lazy_child = lazy_child_t();
       endResetModel();
    }
 
-   QVariant text_tree_model_t::data(const QModelIndex& index, int role) const
+   void text_tree_model_t::set_tree(const lazy_text_tree_ptr_t& tree)
    {
-      if (!tree)
-         return QVariant();
+      beginResetModel();
+      _tree.reset();
+      _lazy = tree;
+      _lazy_child_counts.clear();
+      _last_lazy_child = lazy_child_t();
+      endResetModel();
+   }
 
-      if (role != Qt::DisplayRole)
-         return QVariant();
+   void text_tree_model_t::reset()
+   {
+      if (_lazy)
+         set_tree(_lazy);
+      else
+         set_tree(_tree);
+   }
+
+   size_t text_tree_model_t::count_lazy_children(node_id node) const
+   {
+      auto pos = _lazy_child_counts.find(node);
+      if (pos != _lazy_child_counts.end())
+         return pos->second;
+
+      size_t count = 0;
+      for (lazy_node_id child = _lazy->first_child(node == no_node ? lazy_text_tree_t::no_node : lazy_node_id(node)); child != lazy_text_tree_t::no_node; child = _lazy->next_siblings[child])
+         ++count;
 
+      _lazy_child_counts.emplace(node, count);
+      return count;
+   }
+
+   size_t text_tree_model_t::count_children(node_id node) const
+   {
+      if (_lazy)
+         return count_lazy_children(node);
+
+      if (!_tree)
+         return 0;
+
+      return node == no_node ? _tree->roots.size() : _tree->node(node).children.size();
+   }
+
+   node_id text_tree_model_t::get_child(node_id node, size_t row) const
+   {
+      if (_lazy)
+      {
+         // Continue from the last child found when it is before the row, otherwise start over.
+         lazy_child_t& last = _last_lazy_child;
+         if (last.parent != node || last.child == lazy_text_tree_t::no_node || last.row > row)
+            last = lazy_child_t{ node, 0, _lazy->first_child(node == no_node ? lazy_text_tree_t::no_node : lazy_node_id(node)) };
+
+         for (; last.row < row && last.child != lazy_text_tree_t::no_node; ++last.row)
+            last.child = _lazy->next_siblings[last.child];
+
+         return last.child;
+      }
+
+      return node == no_node ? _tree->roots[row]->index : _tree->node(node).children[row]->index;
+   }
+
+   node_id text_tree_model_t::get_parent(node_id node) const
+   {
+      if (_lazy)
+      {
+         const lazy_node_id parent = _lazy->parents[node];
+         return parent == lazy_text_tree_t::no_node ? no_node : parent;
+      }
+
+      const text_tree_t::node_t* parent = _tree->node(node).parent;
+      return parent ? parent->index : no_node;
+   }
+
+   size_t text_tree_model_t::get_row(node_id node) const
+   {
+      if (_lazy)
+         return _lazy->rows[node];
+
+      return _tree->node(node).index_in_parent;
+   }
+
+   node_id text_tree_model_t::get_node(const QModelIndex& index) const
+   {
       if (!index.isValid())
+         return no_node;
+
+      const quintptr id = index.internalId();
+      const size_t count = _lazy ? _lazy->size() : _tree ? _tree->size() : 0;
+      if (id >= count)
+         return no_node;
+
+      return node_id(id);
+   }
+
+   QVariant text_tree_model_t::data(const QModelIndex& index, int role) const
+   {
+      if (role != Qt::DisplayRole)
          return QVariant();
 
-      const node* a_node = static_cast<node*>(index.internalPointer());
-      if (!a_node)
+      const node_id a_node = get_node(index);
+      if (a_node == no_node)
          return QVariant();
 
-      return QVariant(QString::fromWCharArray(a_node->text_ptr));
+      if (_lazy)
+         return QVariant(QString::fromStdWString(_lazy->text(lazy_node_id(a_node))));
+
+      const auto& shown = _tree->node(a_node);
+      return QVariant(QString::fromWCharArray(shown.text_ptr, shown.text_length));
    }
 
    QVariant text_tree_model_t::headerData(int section, Qt::Orientation orientation, int role) const
@@ -37,52 +134,41 @@ namespace dak::tree_reader::app
 
    QModelIndex text_tree_model_t::index(int row, int column, const QModelIndex& parent) const
    {
-      if (!tree)
+      const node_id parent_node = get_node(parent);
+      if (parent.isValid() && parent_node == no_node)
          return QModelIndex();
 
-      const node* parent_node = parent.isValid() ? static_cast<node*>(parent.internalPointer()) : nullptr;
-      const std::vector<node*>& nodes = parent_node ? parent_node->children : tree->roots;
-      if (row < 0 || row >= nodes.size())
+      if (row < 0 || row >= count_children(parent_node))
          return QModelIndex();
 
-      return createIndex(row, column, static_cast<void*>(nodes[row]));
+      return createIndex(row, column, quintptr(get_child(parent_node, row)));
    }
 
    QModelIndex text_tree_model_t::parent(const QModelIndex& index) const
    {
-      if (!tree)
-         return QModelIndex();
-
-      if (!index.isValid())
+      const node_id a_node = get_node(index);
+      if (a_node == no_node)
          return QModelIndex();
 
-      const node* a_node = static_cast<node*>(index.internalPointer());
-      if (!a_node)
+      const node_id parent_node = get_parent(a_node);
+      if (parent_node == no_node)
          return QModelIndex();
 
-      if (!a_node->parent)
-         return QModelIndex();
-
-      return createIndex(int(a_node->index_in_parent), 0, static_cast<void*>(a_node->parent));
+      return createIndex(int(get_row(parent_node)), 0, quintptr(parent_node));
    }
 
    int text_tree_model_t::rowCount(const QModelIndex& parent) const
    {
-      if (!tree)
-         return 0;
-
-      if (!parent.isValid())
-         return int(tree->roots.size());
-
-      const node* a_node = static_cast<node*>(parent.internalPointer());
-      if (!a_node)
+      const node_id a_node = get_node(parent);
+      if (parent.isValid() && a_node == no_node)
          return 0;
 
-      return int(a_node->children.size());
+      return int(count_children(a_node));
    }
+
    int text_tree_model_t::columnCount(const QModelIndex& parent) const
    {
-      if (!tree)
+      if (!_tree && !_lazy)
          return 0;
       return 1;
    }
@@ -1,20 +1,33 @@
 #include "dak/tree_reader/text_tree.h"
+#include "dak/tree_reader/lazy_text_tree.h"
 
 #include <QtCore/qabstractitemmodel.h>
 
 #include <memory>
+#include <unordered_map>
 
 namespace dak::tree_reader::app
 {
    using text_tree_ptr_t = tree_reader::text_tree_ptr_t;
+   using lazy_text_tree_ptr_t = tree_reader::lazy_text_tree_ptr_t;
 
    ////////////////////////////////////////////////////////////////////////////
    //
    // Tree model containing all lines of a text tree.
+   //
+   // The model works directly on the nodes of the shown tree, without
+   // copying it. Model indexes hold the index of the node in the tree.
+   //
+   // The model can instead show a lazy tree, whose text is only read
+   // from its file when shown. Model indexes then hold the lazy node id.
+   // The children of a lazy node are reached through its siblings index,
+   // continuing from the last child found, since views ask for consecutive rows.
 
    struct text_tree_model_t : QAbstractItemModel
    {
-      text_tree_ptr_t tree;
+      // Set the shown tree and reset the model.
+      void set_tree(const text_tree_ptr_t& tree);
+      void set_tree(const lazy_text_tree_ptr_t& tree);
 
       void reset();
 
@@ -24,6 +37,39 @@ namespace dak::tree_reader::app
       QModelIndex parent(const QModelIndex& index) const override;
       int rowCount(const QModelIndex& parent = QModelIndex()) const override;
       int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+
+   private:
+      using node_id_t = size_t;
+      static constexpr node_id_t no_node = node_id_t(-1);
+
+      // The number of children of the lazy tree nodes that were shown, counted when first needed.
+      size_t count_lazy_children(node_id_t node) const;
+
+      // The number of children of a node, or of roots for no node.
+      size_t count_children(node_id_t node) const;
+
+      // The child at the given row of a node, or the root for no node.
+      node_id_t get_child(node_id_t node, size_t row) const;
+
+      node_id_t get_parent(node_id_t node) const;
+
+      // The row of a node among its siblings.
+      size_t get_row(node_id_t node) const;
+
+      node_id_t get_node(const QModelIndex& index) const;
+
+      text_tree_ptr_t _tree;
+      lazy_text_tree_ptr_t _lazy;
+      mutable std::unordered_map<node_id_t, size_t> _lazy_child_counts;
+
+      // The last lazy child found, its parent and its row.
+      struct lazy_child_t
+      {
+         node_id_t parent = no_node;
+         size_t row = 0;
+         lazy_text_tree_t::node_id_t child = lazy_text_tree_t::no_node;
+      };
+      mutable lazy_child_t _last_lazy_child;
    };
 }
 
@@ -27,7 +27,7 @@ namespace dak::tree_reader::app
       _tree_view->setSizePolicy(QSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding));
 
       _model = new text_tree_model_t;
-      _model->tree = tree->get_original_tree();
+      _model->set_tree(tree->get_original_tree());
 
       auto old_model = _tree_view->model();
       _tree_view->setModel(_model);
@@ -42,8 +42,7 @@ namespace dak::tree_reader::app
    void text_tree_sub_window_t::update_shown_model(const text_tree_ptr_t& a_tree)
    {
       // note: we don't change the OriginalTree variable, only which tree is shown (original tree or filtered).
-      _model->tree = a_tree;
-      _model->reset();
+      _model->set_tree(a_tree);
    }
 
    /////////////////////////////////////////////////////////////////////////
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "dak/tree_reader/text_tree.h"
+#include "dak/tree_reader/line_scanner.h"
 
 namespace dak::tree_reader
 {
@@ -21,14 +22,33 @@ namespace dak::tree_reader
    ////////////////////////////////////////////////////////////////////////////
    //
    // Read text lines from an input stream and stores them in the holder.
+   //
+   // Each buffer is scanned in one pass for all its lines and their indentation.
 
    struct buffers_text_holder_reader_t
    {
       std::shared_ptr<buffers_text_holder_t> holder = std::make_shared<buffers_text_holder_t>();
 
-      wchar_t* pos_in_buffer = nullptr;
-      wchar_t* buffer_end = nullptr;
+      // How many characters a tab represent to calculate the indentation.
+      size_t tab_size = 8;
+
+      // When false, the buffers of the lines already read are released when
+      // a new buffer is read, so lines must be used before reading further.
+      bool keep_read_buffers = true;
+
+      wchar_t* buffer = nullptr;
+      size_t buffer_size = 0;
+      bool at_end = false;
+
+      scanned_lines_t lines;
+      size_t next_line = 0;
+
+      // Indentation width and count of leading spaces and tabs of the last line read.
+      size_t indent = 0;
+      size_t text_index = 0;
 
+      // Returns the next line, null-terminated, and its length.
+      // Empty lines are skipped. Returns a zero length at the end of the stream.
       std::pair<wchar_t*, size_t> read_line(std::wistream& stream);
    };
 }
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/multi_substring_searcher.h"
+#include "dak/tree_reader/leaf_match_cache.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // filter that evaluates a tree of filters compiled into a flat program.
+   //
+   // The combining filters (or, and, not), the named filters and the filters
+   // that only depend on the node (contains, regex, levels, ...) become
+   // instructions of the program. The or and and filters jump over their
+   // remaining sub-filters as soon as the result is known, so evaluating a
+   // node does no virtual call and touches no shared pointer.
+   //
+   // When an or or and filter has many contains or literal regex sub-filters,
+   // possibly inverted or named, they are searched together: each node is
+   // scanned once for all of them and each sub-filter reads if it was found.
+   // Likewise, its other regex sub-filters are matched together as a set.
+   //
+   // When given a leaf match cache, the contains and regex filters instead
+   // read their result from the bitmaps of the cache, which are retrieved
+   // or computed together when filtering begins.
+   //
+   // Filters that keep state between nodes or look at other nodes
+   // (unique, under, if-subtree, if-sibling) are called as-is.
+   //
+   // When filtering begins, the sub-filters of the or and and filters are
+   // evaluated cheapest and most decisive first: their cost is estimated from
+   // their kind and how often they keep a node is measured on a sample of the
+   // nodes of the tree. This is only done when all the sub-filters are stateless
+   // and never stop nor skip children, so that the order cannot change results.
+   //
+   // The compiled filter is meant to filter whole trees: when the tree has
+   // sub-tree sketches, it drops and skips the sub-trees where the source
+   // filter cannot keep any node. See subtree_pruner_t.
+   //
+   // The compiled filter refers to the source filter, which must outlive it
+   // unless given as a shared pointer.
+
+   struct compiled_tree_filter_t : tree_filter_t
+   {
+      compiled_tree_filter_t(tree_filter_t& filter, const leaf_match_cache_ptr_t& cache = nullptr);
+      compiled_tree_filter_t(const tree_filter_ptr_t& filter, const leaf_match_cache_ptr_t& cache = nullptr);
+
+      result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) override;
+      void begin_filtering(const text_tree_t& tree) override;
+      std::wstring get_name() const override;
+      std::wstring get_short_name() const override;
+      std::wstring get_description() const override;
+      tree_filter_ptr_t clone() const override;
+
+      // The number of instructions in the program.
+      size_t size() const { return _program.size(); }
+
+   private:
+      enum class op_t : uint8_t
+      {
+         accept,           // keep.
+         stop,             // stop, keeping the node if the flag is set.
+         contains,         // keep if the node contains the searched text.
+         fused_contains,   // keep if the node contains the pattern of the group of fused texts at the index.
+         fused_regex,      // keep if the node matches the pattern of the group of fused regexes at the index.
+         cached_match,     // keep if the node is in the cached matches of the filter.
+         regex,            // keep if the node matches the regex.
+         text_address,     // keep if the node text is at the address.
+         level_range,      // keep if the level is within the range, skip children if deeper.
+         call,             // call the filter.
+         invert,           // not: invert the keep flag of the current result.
+         stop_when_kept,   // add stop to the current result if kept.
+         until,            // stop and drop if the current result is kept, otherwise drop.
+         remove_children,  // skip the children if kept, keeping the node if the flag is not set.
+         begin_any,        // start an or: set the accumulator at the index to drop.
+         any_step,         // or the current result in the accumulator, jump to the target if kept.
+         begin_all,        // start an and: set the accumulator at the index to keep.
+         all_step,         // and the current result in the accumulator, jump to the target if not kept.
+         end_combine,      // the current result becomes the accumulator at the index.
+      };
+
+      struct instruction_t
+      {
+         op_t op = op_t::accept;
+         bool flag = false;
+         uint32_t index = 0;
+         uint32_t target = 0;
+         uint32_t pattern = 0;
+         size_t min_level = 0;
+         size_t max_level = 0;
+         const wchar_t* address = nullptr;
+         const substring_searcher_t* searcher = nullptr;
+         linear_regex_t* regex = nullptr;
+         const leaf_match_cache_t::matches_t* matches = nullptr;
+         tree_filter_t* filter = nullptr;
+      };
+
+      void compile();
+      void compile(tree_filter_t* filter, size_t depth, std::vector<const tree_filter_t*>& named_in_progress);
+      void compile_combine(const combine_tree_filter_t& combine, bool is_or, size_t depth, std::vector<const tree_filter_t*>& named_in_progress);
+      instruction_t& add(op_t op);
+
+      // Plan the order of evaluation of the sub-filters of the combining filters.
+      bool plan(const text_tree_t& tree);
+      void plan(const tree_filter_t* filter, const text_tree_t& tree, const std::vector<const text_tree_t::node_t*>& samples, std::vector<const tree_filter_t*>& named_in_progress);
+
+      // A group of texts searched together, with the result of the last node searched.
+      // The node is identified by its address and index, since a node can be reused
+      // for each line of a streamed text.
+      struct fused_group_t
+      {
+         multi_substring_searcher_t searcher;
+         std::vector<bool> found;
+         const text_tree_t::node_t* searched_node = nullptr;
+         size_t searched_index = 0;
+      };
+
+      // A group of regexes matched together, with the result of the last node matched.
+      struct fused_regex_group_t
+      {
+         linear_regex_set_t regexes;
+         std::vector<bool> found;
+         const text_tree_t::node_t* searched_node = nullptr;
+         size_t searched_index = 0;
+      };
+
+      tree_filter_ptr_t _kept_source;
+      tree_filter_t* _source = nullptr;
+
+      // The cache of leaf matches and the matches in use by the program.
+      leaf_match_cache_ptr_t _cache;
+      std::vector<std::shared_ptr<const leaf_match_cache_t::matches_t>> _cached_matches;
+
+      // The planned order of the sub-filters of the combining filters, when not as given.
+      std::unordered_map<const combine_tree_filter_t*, std::vector<size_t>> _orders;
+
+      // Finds the sub-trees where no node can be kept.
+      subtree_pruner_t _pruner;
+
+      std::vector<instruction_t> _program;
+      std::vector<result_t> _accumulators;
+      std::vector<fused_group_t> _fused_groups;
+      std::vector<fused_regex_group_t> _fused_regex_groups;
+
+      // The group and pattern of each fused filter, while compiling.
+      std::unordered_map<const tree_filter_t*, std::pair<uint32_t, uint32_t>> _fused_filters;
+      std::unordered_map<const tree_filter_t*, std::pair<uint32_t, uint32_t>> _fused_regex_filters;
+   };
+}
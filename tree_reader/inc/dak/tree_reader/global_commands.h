@@ -4,6 +4,7 @@
 #include "dak/tree_reader/tree_filter.h"
 #include "dak/tree_reader/tree_filtering.h"
 #include "dak/tree_reader/simple_tree_reader.h"
+#include "dak/tree_reader/lazy_text_tree.h"
 #include "dak/tree_reader/named_filters.h"
 #include "dak/utility/undo_stack.h"
 
@@ -27,10 +28,15 @@ namespace dak::tree_reader
 
       load_simple_text_tree_options_t read_options;
 
+      // Files larger than this many megabytes are only indexed into a lazy tree
+      // when loaded. Zero means files are loaded whenever they fit in memory.
+      size_t max_loaded_file_megabytes = 0;
+
       bool operator!=(const commands_options_t& other) const
       {
-         return output_line_indent != other.output_line_indent
-             || read_options       != other.read_options;
+         return output_line_indent        != other.output_line_indent
+             || read_options              != other.read_options
+             || max_loaded_file_megabytes != other.max_loaded_file_megabytes;
       }
    };
 
@@ -64,11 +70,30 @@ namespace dak::tree_reader
       void set_output_indentation(const std::wstring& indentText);
 
       // Tree loading, removing and creation of derived tree.
+      //
+      // Loading uses the snapshot of the file when it is still valid.
+      // See text_tree_snapshot.h.
 
       tree_commands_ptr_t load_tree(const std::filesystem::path& filename);
+      bool save_tree_snapshot(const tree_commands_ptr_t& tree);
+
+      // Files that cannot be loaded, because they are larger than the maximum
+      // loaded file size option or would not fit in the available memory, are
+      // instead indexed into the given lazy tree, unless they have a valid snapshot.
+      // See lazy_text_tree_t.
+
+      tree_commands_ptr_t load_tree(const std::filesystem::path& filename, lazy_text_tree_ptr_t& lazy_tree);
+      bool can_load_tree(const std::filesystem::path& filename) const;
       void remove_tree(const tree_commands_ptr_t& tree);
       tree_commands_ptr_t create_tree_from_filtered(const tree_commands_ptr_t& tree);
 
+      // Following the files of trees as they grow, read with the options each tree was loaded with.
+      // Updating appends the new lines of all followed trees and returns how many were added.
+      // See tree_commands_t::follow_tree_file.
+
+      bool follow_tree(const tree_commands_ptr_t& tree);
+      size_t update_followed_trees();
+
       // Named filters management.
 
       named_filter_ptr name_filter(const std::wstring& filterName, const tree_commands_ptr_t& tree);
@@ -86,6 +111,9 @@ namespace dak::tree_reader
 
    protected:
 
+      // Add a loaded tree to the known trees.
+      tree_commands_ptr_t add_loaded_tree(const text_tree_ptr_t& new_tree, const std::filesystem::path& filename);
+
       // The known trees being filtered.
       std::vector<tree_commands_ptr_t> _trees;
 
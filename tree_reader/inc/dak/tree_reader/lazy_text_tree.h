@@ -0,0 +1,104 @@
+#pragma once
+
+#include "dak/tree_reader/mapped_text_holder.h"
+#include "dak/tree_reader/simple_tree_reader.h"
+#include "dak/tree_reader/text_line_batch_queue.h"
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // A tree of text read from its file only when needed, for files too large
+   // to be loaded in memory.
+   //
+   // Loading reads the file once to index its lines: the parent, depth, next
+   // sibling and row among its siblings of each line and where each page of
+   // consecutive lines starts in the file. That is 16 bytes per line, without
+   // any node or decoded text.
+   //
+   // The text of the lines is decoded from the memory-mapped file a page
+   // at a time and kept in a bounded cache of the most recently used pages.
+   //
+   // Nodes are identified by 32-bit ids in the order of the lines. Since the
+   // lines are in pre-order, the first child of a node is the next line when
+   // it is deeper, and the other children are reached through the siblings.
+
+   struct lazy_text_tree_t
+   {
+      typedef uint32_t node_id_t;
+
+      // The id used when there is no node: no parent.
+      static constexpr node_id_t no_node = UINT32_MAX;
+
+      // The number of lines decoded together.
+      static constexpr size_t lines_per_page = 1024;
+
+      // The number of decoded pages kept in the cache.
+      size_t max_cached_pages = 64;
+
+      // Per-node arrays, indexed by the node id.
+      std::vector<node_id_t> parents;
+      std::vector<uint32_t> depths;
+      std::vector<node_id_t> next_siblings;
+      std::vector<uint32_t> rows;
+
+      // Where the first line of each page starts in the file.
+      std::vector<uint64_t> page_offsets;
+
+      // The mapped file and the options used to read it.
+      std::shared_ptr<mapped_text_holder_t> source_file;
+      load_simple_text_tree_options_t read_options;
+
+      // The number of nodes.
+      size_t size() const { return parents.size(); }
+
+      // The first child of a node, or no_node if it has none.
+      // Pass no_node to get the first root.
+      node_id_t first_child(node_id_t node) const;
+
+      // Gather the children of a node, in order.
+      // Pass no_node to gather the roots.
+      std::vector<node_id_t> get_children(node_id_t node) const;
+
+      // The text of a node, decoded from the file unless its page is cached.
+      // Returns an empty text if the file no longer has the line.
+      std::wstring text(node_id_t node) const;
+
+      // Read all lines in order, giving each line and its depth to the function.
+      // The pages are decoded without going through the cache and the system
+      // is asked to read the next pages ahead. Reading stops when the function
+      // returns false.
+      void read_lines(const read_line_function_t& func) const;
+
+   private:
+      struct cached_page_t
+      {
+         text_line_batch_t lines;
+         std::list<size_t>::iterator recent_pos;
+      };
+
+      // Decode the lines of a page, with their depth.
+      void decode_page(size_t page, text_line_batch_t& lines) const;
+
+      // The cached pages, and their numbers from the most to the least recently used.
+      mutable std::mutex _cache_mutex;
+      mutable std::unordered_map<size_t, cached_page_t> _cached_pages;
+      mutable std::list<size_t> _recent_pages;
+   };
+
+   typedef std::shared_ptr<lazy_text_tree_t> lazy_text_tree_ptr_t;
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Index a simple flat text file into a lazy tree, using initial white-space
+   // indentation to determine the tree structure like load_simple_text_tree.
+   //
+   // Returns null if the file cannot be mapped or has too many lines.
+
+   lazy_text_tree_ptr_t load_lazy_text_tree(const std::filesystem::path& path, const load_simple_text_tree_options_t& options = load_simple_text_tree_options_t());
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "dak/tree_reader/text_tree.h"
+#include "dak/tree_reader/text_trigram_index.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   struct tree_filter_t;
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Cache of which nodes of a tree match each leaf filter.
+   //
+   // The contains and regex filters only depend on the text of the node,
+   // so their result over all the nodes of a tree is kept as a bitmap,
+   // indexed by the node index. When a filter is edited and applied again,
+   // only its new leaves are evaluated, the others read their bitmap.
+   //
+   // Leaves are identified by their kind and text, so equal leaves in
+   // different filters share their bitmap. The least recently used bitmaps
+   // are dropped when there are too many, but the cache always holds all
+   // the leaves of the last filter.
+   //
+   // The leaves of a filter that are not cached are evaluated together:
+   // the nodes are scanned once for all their texts and once for all their
+   // regexes. Large trees are scanned by multiple threads, each over a range
+   // of nodes.
+   //
+   // The cache is tied to a single tree, which must not be modified.
+   // Using it with another tree clears it.
+   //
+   // When given the trigram index of the tree, only the nodes that may
+   // contain the text of a contains filter or the literal text required
+   // by a regex are evaluated. See text_trigram_index_t.
+
+   struct leaf_match_cache_t
+   {
+      // The bits of the nodes matching a leaf, indexed by the node index.
+      typedef std::vector<uint64_t> matches_t;
+
+      // The maximum number of bitmaps kept, unless a filter has more leaves.
+      static constexpr size_t max_cached_leaves = 64;
+
+      // Trees with fewer nodes are scanned by a single thread.
+      static constexpr size_t min_parallel_nodes = 20000;
+
+      // Verify if the filter is a leaf whose matches can be cached.
+      static bool is_cacheable(const tree_filter_t& filter);
+
+      // Get the matches of a cacheable filter over all nodes of the tree,
+      // evaluating the filter on all nodes if not cached.
+      std::shared_ptr<const matches_t> get_matches(const text_tree_t& tree, tree_filter_t& filter);
+
+      // Get the matches of all the cacheable filters of a filter over all nodes of the tree,
+      // evaluating together the filters that are not cached. The matches are in the order
+      // of the filters.
+      std::vector<std::shared_ptr<const matches_t>> get_matches(const text_tree_t& tree, const std::vector<tree_filter_t*>& filters);
+
+      // Use the trigram index when evaluating filters over the tree it indexes.
+      void set_index(text_trigram_index_ptr_t index);
+
+      // The number of cached bitmaps.
+      size_t size() const;
+
+      void clear();
+
+      // Verify if the node is in the matches.
+      static bool is_in(const matches_t& matches, size_t index) { return (matches[index / 64] >> (index % 64)) & 1u; }
+
+   private:
+      // Evaluate the filters over all nodes of the tree.
+      std::vector<std::shared_ptr<matches_t>> evaluate(const text_tree_t& tree, const std::vector<tree_filter_t*>& filters) const;
+
+      struct entry_t
+      {
+         std::wstring key;
+         std::shared_ptr<const matches_t> matches;
+         uint64_t last_use = 0;
+      };
+
+      mutable std::mutex _mutex;
+      const text_tree_t* _tree = nullptr;
+      size_t _tree_size = 0;
+      std::vector<entry_t> _entries;
+      size_t _capacity = max_cached_leaves;
+      uint64_t _use_count = 0;
+      text_trigram_index_ptr_t _index;
+   };
+
+   typedef std::shared_ptr<leaf_match_cache_t> leaf_match_cache_ptr_t;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Lines found in a buffer of text in a single pass.
+   //
+   // Each line is described by the offset of its first character and
+   // its length, excluding the new-line. Empty lines are skipped.
+   //
+   // The indentation is the width of the leading spaces and tabs and
+   // the text index is the number of those leading characters.
+
+   struct scanned_lines_t
+   {
+      std::vector<size_t> offsets;
+      std::vector<size_t> lengths;
+      std::vector<size_t> indents;
+      std::vector<size_t> text_indexes;
+
+      // Offset where scanning stopped: after the last new-line found, or at
+      // the end of the buffer when the final partial line was also scanned.
+      size_t scanned_end = 0;
+
+      size_t size() const { return offsets.size(); }
+
+      void clear();
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Scan a whole buffer for line ends and leading indentation, replacing
+   // the previous scanned lines.
+   //
+   // Unless at the end of the input, the last line is only scanned if a
+   // new-line ends it, since more of it may still be read.
+   //
+   // The scanning uses AVX2 or SSE2 when the processor supports it.
+
+   void scan_lines(const char* buffer, size_t size, bool at_end, size_t tab_size, scanned_lines_t& lines);
+   void scan_lines(const wchar_t* buffer, size_t size, bool at_end, size_t tab_size, scanned_lines_t& lines);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   template <class CHAR>
+   struct regex_matcher_t;
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Regular expression matched in time linear in the length of the text.
+   //
+   // The pattern uses the ECMAScript syntax of std::regex, without
+   // backreferences and lookaheads, which cannot be matched in linear time.
+   // Named classes in brackets, like [[:alpha:]], only contain ASCII characters.
+   // Collating elements and equivalence classes, like [[.a.]] and [[=a=]],
+   // are not supported. Invalid or unsupported patterns throw std::regex_error.
+   //
+   // The pattern is compiled into an automaton. Searching uses a DFA built
+   // lazily from the automaton, falling back to simulating the automaton
+   // when the pattern has word boundaries or the DFA grows too large.
+   // A literal prefix and a substring that all matches must contain are
+   // searched first to skip texts and positions that cannot match.
+   //
+   // Matching never recurses. The DFA is kept in the regex, so a regex
+   // must not be used by multiple threads at once. Copies do not share it.
+
+   template <class CHAR>
+   struct basic_linear_regex_t
+   {
+      using string_view_t = std::basic_string_view<CHAR>;
+
+      // A default regex matches nothing.
+      basic_linear_regex_t();
+      basic_linear_regex_t(string_view_t pattern);
+      basic_linear_regex_t(const basic_linear_regex_t& other);
+      basic_linear_regex_t(basic_linear_regex_t&& other);
+      ~basic_linear_regex_t();
+
+      basic_linear_regex_t& operator=(const basic_linear_regex_t& other);
+      basic_linear_regex_t& operator=(basic_linear_regex_t&& other);
+
+      // Verify if the regex matches somewhere in the text.
+      bool search(string_view_t text);
+
+      // Find the first match starting at or after the given position, preferring
+      // matches like std::regex: leftmost, then following the pattern priorities.
+      //
+      // When continuous, the match must start at the given position.
+      // When not empty, empty matches are ignored.
+      bool find(string_view_t text, size_t from, size_t& match_start, size_t& match_end, bool continuous = false, bool not_empty = false);
+
+      // A literal text that all matches contain, empty if there is none.
+      std::basic_string<CHAR> required_text() const;
+
+   private:
+      std::unique_ptr<regex_matcher_t<CHAR>> _matcher;
+   };
+
+   using linear_regex_t = basic_linear_regex_t<wchar_t>;
+   using utf8_linear_regex_t = basic_linear_regex_t<char>;
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // A set of regular expressions matched together.
+   //
+   // A text is scanned once whatever the number of regular expressions,
+   // reporting which ones were found.
+
+   template <class CHAR>
+   struct basic_linear_regex_set_t
+   {
+      using string_view_t = std::basic_string_view<CHAR>;
+
+      basic_linear_regex_set_t();
+      basic_linear_regex_set_t(const std::vector<std::basic_string<CHAR>>& patterns);
+      basic_linear_regex_set_t(const basic_linear_regex_set_t& other);
+      basic_linear_regex_set_t(basic_linear_regex_set_t&& other);
+      ~basic_linear_regex_set_t();
+
+      basic_linear_regex_set_t& operator=(const basic_linear_regex_set_t& other);
+      basic_linear_regex_set_t& operator=(basic_linear_regex_set_t&& other);
+
+      // The number of regular expressions.
+      size_t size() const;
+
+      // Find which regular expressions match in the text. The found flags
+      // are indexed like the patterns given when created.
+      void find_all(string_view_t text, std::vector<bool>& found);
+
+   private:
+      std::unique_ptr<regex_matcher_t<CHAR>> _matcher;
+   };
+
+   using linear_regex_set_t = basic_linear_regex_set_t<wchar_t>;
+}
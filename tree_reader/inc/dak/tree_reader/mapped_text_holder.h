@@ -0,0 +1,171 @@
+#pragma once
+
+#include "dak/tree_reader/text_tree.h"
+#include "dak/tree_reader/line_scanner.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // A memory mapping of a whole file.
+   //
+   // The mapping is either read-only or copy-on-write. Writing to a
+   // copy-on-write mapping never modifies the file.
+
+   struct mapped_file_t
+   {
+      enum class access_t { read_only, copy_on_write };
+
+      mapped_file_t() = default;
+      ~mapped_file_t();
+
+      mapped_file_t(const mapped_file_t&) = delete;
+      mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+      // Map the file. Returns false if the file could not be mapped.
+      // Empty files cannot be mapped.
+      bool open(const std::filesystem::path& path, access_t access = access_t::read_only);
+      void close();
+
+      bool is_open() const { return _data != nullptr; }
+
+      // note: the data must only be modified in a copy-on-write mapping.
+      char* data() { return _data; }
+      const char* data() const { return _data; }
+      size_t size() const { return _size; }
+
+      // Ask the system to start reading a part of the file, so it is already
+      // in memory when used. Does nothing if the system cannot do it.
+      void will_need(size_t offset, size_t size) const;
+
+   private:
+      char* _data = nullptr;
+      size_t _size = 0;
+
+   #ifdef _WIN32
+      void* _file = nullptr;
+      void* _mapping = nullptr;
+   #endif
+   };
+
+   // The physical memory currently available, in bytes, or zero if unknown.
+   uint64_t get_available_memory();
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Holds a memory-mapped file and the text decoded from it.
+   //
+   // Wide text is decoded only once, directly from the mapping,
+   // into a single buffer that never moves. When the indentation is
+   // measured while scanning, only the text after it is decoded.
+   // The wide text still takes a wchar_t per character, use the UTF-8
+   // tree to keep the text in the mapping.
+   //
+   // UTF-8 text is used directly from the mapping, except for the last line
+   // when the file does not end with a new-line, since there is no room to
+   // terminate it in the mapping.
+
+   struct mapped_text_holder_t : text_holder_t
+   {
+      mapped_file_t file;
+      std::unique_ptr<wchar_t[]> text;
+      std::string last_line;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Read UTF-8 text lines from a memory-mapped file and stores them in the holder.
+   //
+   // Invalid UTF-8 bytes are kept as-is, as if the text was latin-1.
+   //
+   // Line ends and indentation are found directly in the UTF-8 bytes,
+   // a window of the file at a time.
+
+   struct mapped_text_holder_reader_t
+   {
+      std::shared_ptr<mapped_text_holder_t> holder = std::make_shared<mapped_text_holder_t>();
+
+      // How many characters a tab represent to calculate the indentation.
+      size_t tab_size = 8;
+
+      // When false, each line is decoded over the previous one instead of
+      // keeping the text of the whole file, so lines must be used before
+      // reading further. Must be set before opening the file.
+      bool keep_read_text = true;
+      std::vector<wchar_t> line_text;
+
+      // When false, the indentation measured while scanning is not decoded,
+      // so the lines start at their text and the text index is zero.
+      bool decode_indentation = true;
+
+      const char* pos_in_file = nullptr;
+      const char* file_end = nullptr;
+      wchar_t* pos_in_text = nullptr;
+
+      // Lines scanned in the current window of the file, and the next one to read.
+      const char* window = nullptr;
+      size_t window_size = 256 * 1024;
+      scanned_lines_t lines;
+      size_t next_line = 0;
+
+      // Indentation width and count of leading spaces and tabs of the last line read.
+      size_t indent = 0;
+      size_t text_index = 0;
+
+      // Where the last line read starts in the file, before its indentation.
+      const char* line_in_file = nullptr;
+
+      // Map the file and prepare to read its lines. Returns false if the file could not be mapped.
+      bool open(const std::filesystem::path& path);
+
+      // Returns the next line, null-terminated, and its length.
+      // Empty lines are skipped. Returns a zero length at the end of the file.
+      std::pair<wchar_t*, size_t> read_line();
+
+      // Split the remaining text in up to count readers of consecutive chunks of lines,
+      // so they can be read in parallel. Must be called before reading any line.
+      std::vector<mapped_text_holder_reader_t> split(size_t count);
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Read UTF-8 text lines in-place from a copy-on-write memory-mapped file.
+   //
+   // Lines are terminated in-place, so they point directly into the mapping.
+
+   struct mapped_utf8_text_holder_reader_t
+   {
+      std::shared_ptr<mapped_text_holder_t> holder = std::make_shared<mapped_text_holder_t>();
+
+      // How many characters a tab represent to calculate the indentation.
+      size_t tab_size = 8;
+
+      char* pos_in_file = nullptr;
+      char* file_end = nullptr;
+
+      // Lines scanned in the current window of the file, and the next one to read.
+      char* window = nullptr;
+      size_t window_size = 256 * 1024;
+      scanned_lines_t lines;
+      size_t next_line = 0;
+
+      // Indentation width and count of leading spaces and tabs of the last line read.
+      size_t indent = 0;
+      size_t text_index = 0;
+
+      // Map the file and prepare to read its lines. Returns false if the file could not be mapped.
+      bool open(const std::filesystem::path& path);
+
+      // Returns the next line, null-terminated, and its length.
+      // Empty lines are skipped. Returns a zero length at the end of the file.
+      std::pair<char*, size_t> read_line();
+
+      // Split the remaining text in up to count readers of consecutive chunks of lines,
+      // so they can be read in parallel.
+      std::vector<mapped_utf8_text_holder_reader_t> split(size_t count);
+   };
+}
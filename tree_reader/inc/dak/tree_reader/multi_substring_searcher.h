@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Searches texts for many fixed substrings at once.
+   //
+   // The substrings are compiled into an Aho-Corasick automaton, so a text
+   // is scanned once whatever the number of substrings, reporting which
+   // substrings were found.
+   //
+   // The characters used by the substrings are mapped to a small set of
+   // classes, all other characters sharing a single class, which keeps
+   // the transition table small.
+
+   struct multi_substring_searcher_t
+   {
+      multi_substring_searcher_t() = default;
+      multi_substring_searcher_t(const std::vector<std::wstring>& needles);
+
+      // The number of searched substrings.
+      size_t size() const { return _needle_count; }
+
+      // Find which substrings are in the text. The found flags are indexed
+      // like the needles given when created. An empty needle is in every text.
+      void find_all(std::wstring_view text, std::vector<bool>& found) const;
+
+   private:
+      uint32_t class_of(wchar_t c) const;
+
+      size_t _needle_count = 0;
+      std::vector<uint32_t> _empty_needles;
+
+      // The class of characters below 256, then the sorted other characters and their class.
+      std::vector<uint32_t> _low_classes;
+      std::vector<std::pair<wchar_t, uint32_t>> _high_classes;
+      uint32_t _class_count = 1;
+
+      // The transitions of each state, for each class of characters.
+      std::vector<uint32_t> _transitions;
+
+      // The needles found when reaching each state, in ranges of the needles array.
+      std::vector<uint32_t> _output_starts;
+      std::vector<uint32_t> _outputs;
+   };
+}
@@ -26,6 +26,7 @@ namespace dak::tree_reader
       named_tree_filter_t() = default;
 
       result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) override;
+      void begin_filtering(const text_tree_t& tree) override;
       std::wstring get_short_name() const override;
       std::wstring get_description() const override;
       tree_filter_ptr_t clone() const override;
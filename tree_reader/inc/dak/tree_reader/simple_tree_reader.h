@@ -3,10 +3,14 @@
 #include "dak/tree_reader/text_tree.h"
 
 #include <filesystem>
-#include <regex>
+#include <functional>
+#include <string_view>
+#include <vector>
 
 namespace dak::tree_reader
 {
+   struct mapped_text_holder_reader_t;
+
    ////////////////////////////////////////////////////////////////////////////
    //
    // options controling how the text is read and its indentation calculated.
@@ -38,7 +42,76 @@ namespace dak::tree_reader
    //
    // Read a simple flat text file, using initial white-space indentation
    // to determine the tree structure.
+   //
+   // Files are memory-mapped and decoded as UTF-8 directly from the mapping
+   // when possible, otherwise they are read through a wide stream.
+   //
+   // Mapped files are split in up to one chunk of lines per processor, and per
+   // 4 MB of the file, which are read in parallel. The maximum number of chunks
+   // can also be given.
 
    text_tree_t load_simple_text_tree(const std::filesystem::path& path, const load_simple_text_tree_options_t& options = load_simple_text_tree_options_t());
+   text_tree_t load_simple_text_tree(const std::filesystem::path& path, const load_simple_text_tree_options_t& options, size_t max_chunk_count);
    text_tree_t load_simple_text_tree(std::wistream& stream, const load_simple_text_tree_options_t& options = load_simple_text_tree_options_t());
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Read a simple flat text file one line at a time, without building the tree.
+   //
+   // Each line is given to the function as soon as it is read, with the depth
+   // it would have in the tree built by load_simple_text_tree. The text is only
+   // valid during the call. Reading stops when the function returns false.
+   //
+   // Only the indentation of the current branch and the buffer of the current
+   // lines are kept, so the memory used is bounded by the depth of the tree
+   // and the length of the lines, not by the size of the text.
+
+   using read_line_function_t = std::function<bool(std::wstring_view text, size_t depth)>;
+
+   void read_simple_text_lines(const std::filesystem::path& path, const read_line_function_t& func, const load_simple_text_tree_options_t& options = load_simple_text_tree_options_t());
+   void read_simple_text_lines(std::wistream& stream, const read_line_function_t& func, const load_simple_text_tree_options_t& options = load_simple_text_tree_options_t());
+
+   // Read the lines of an opened memory-mapped file reader, which can be limited
+   // to a part of the file. During each call, the reader tells where the line
+   // is in the file. The depths are relative to the first line read.
+
+   void read_simple_text_lines(mapped_text_holder_reader_t& reader, const read_line_function_t& func, const load_simple_text_tree_options_t& options = load_simple_text_tree_options_t());
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Read the lines appended to a simple flat text file since the previous read.
+   //
+   // Only the bytes after the last complete line read are read, a block at
+   // a time, so the cost of a read is proportional to the appended text.
+   // A partial last line is left for a later read, once a new-line ends it.
+   // The depths of the lines continue those of the lines read before.
+
+   struct appended_text_lines_reader_t
+   {
+      // Where the next read starts in the file.
+      uint64_t file_position = 0;
+
+      // The indentation of the lines of the current branch.
+      std::vector<size_t> branch_indents;
+
+      // Read the new complete lines, giving each line and its depth to the function.
+      // When the function returns false, reading stops and the following lines
+      // of the current block are skipped.
+      //
+      // Returns false if the file cannot be read or is now shorter than what was read.
+      bool read_lines(const std::filesystem::path& path, const read_line_function_t& func, const load_simple_text_tree_options_t& options = load_simple_text_tree_options_t());
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Read a simple flat UTF-8 text file into a UTF-8 tree.
+   //
+   // The file is memory-mapped and the nodes point directly into the mapping.
+   // Returns an empty tree if the file cannot be mapped.
+   //
+   // The input filter regular expression is applied to the UTF-8 bytes,
+   // so only ASCII characters should be used in character classes and
+   // input indentation.
+
+   utf8_text_tree_t load_utf8_text_tree(const std::filesystem::path& path, const load_simple_text_tree_options_t& options = load_simple_text_tree_options_t());
 }
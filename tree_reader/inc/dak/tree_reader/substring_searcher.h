@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Searches texts for a fixed substring.
+   //
+   // The needle is prepared once and the way to search is chosen by its length:
+   // a single character uses a character search, short needles compare the
+   // first and last characters of the needle with SIMD instructions over
+   // a block of positions, long needles use Boyer-Moore-Horspool skips.
+   //
+   // The searched text is given with its length, it does not need a terminating null.
+
+   template <class CHAR>
+   struct basic_substring_searcher_t
+   {
+      using string_view_t = std::basic_string_view<CHAR>;
+
+      basic_substring_searcher_t() = default;
+      basic_substring_searcher_t(string_view_t needle);
+
+      // The searched substring.
+      const std::basic_string<CHAR>& needle() const { return _needle; }
+
+      // Find the first position of the needle in the text, or npos if not found.
+      size_t find(string_view_t text) const;
+
+      // Verify if the text contains the needle. An empty needle is in every text.
+      bool is_in(string_view_t text) const { return find(text) != string_view_t::npos; }
+
+   private:
+      enum class method_t : uint8_t { empty, single, first_last, horspool };
+
+      std::basic_string<CHAR> _needle;
+      method_t _method = method_t::empty;
+
+      // Horspool skips, indexed by the low byte of the characters.
+      std::vector<uint32_t> _skips;
+   };
+
+   using substring_searcher_t = basic_substring_searcher_t<wchar_t>;
+   using utf8_substring_searcher_t = basic_substring_searcher_t<char>;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Hash of a text, using the wyhash algorithm.
+   //
+   // All characters and their order affect the hash, so texts that only
+   // differ by a permutation of their characters have different hashes.
+
+   uint64_t hash_text(std::wstring_view text);
+   uint64_t hash_text(std::string_view text);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Set of texts keyed by their precomputed hash.
+   //
+   // Uses open addressing: the hash selects a slot and colliding texts go
+   // in the following slots. The texts are only compared when their hashes
+   // are equal, so inserting a text is usually a single comparison.
+   //
+   // The set refers to the texts, which must outlive it.
+
+   struct text_hash_set_t
+   {
+      // Insert the text with its hash, returns false if it was already in the set.
+      bool insert(std::wstring_view text, uint64_t hash);
+
+      // The number of texts in the set.
+      size_t size() const { return _entries.size(); }
+
+      void clear();
+
+   private:
+      void grow();
+
+      struct slot_t
+      {
+         // The index of the text plus one, zero when the slot is free.
+         uint32_t text = 0;
+
+         // The upper bits of the hash, compared before the text.
+         uint32_t hash = 0;
+      };
+
+      struct entry_t
+      {
+         std::wstring_view text;
+         uint64_t hash = 0;
+      };
+
+      std::vector<slot_t> _slots;
+      std::vector<entry_t> _entries;
+   };
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // A batch of lines, with their depth in the tree.
+   //
+   // The texts of all lines are kept one after the other in a single string,
+   // so a batch only allocates while it grows beyond its previous size.
+
+   struct text_line_batch_t
+   {
+      struct line_t
+      {
+         size_t text_index = 0;
+         size_t text_length = 0;
+         size_t depth = 0;
+      };
+
+      std::wstring texts;
+      std::vector<line_t> lines;
+
+      void add_line(std::wstring_view text, size_t depth);
+      std::wstring_view text(const line_t& line) const { return std::wstring_view(texts.data() + line.text_index, line.text_length); }
+
+      size_t size() const { return lines.size(); }
+      bool empty() const { return lines.empty(); }
+
+      // Remove all lines, keeping the memory for the next lines.
+      void clear();
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // A bounded queue of line batches between one producer thread and one consumer thread.
+   //
+   // The queue is a ring of batches whose read and write positions are atomics,
+   // so it never locks. A full queue makes the producer wait and an empty queue
+   // makes the consumer wait, so each thread only runs ahead of the other by
+   // the capacity of the queue.
+   //
+   // The batches are swapped in and out of the ring, so their memory is
+   // reused by the producer instead of being freed and allocated again.
+
+   struct text_line_batch_queue_t
+   {
+      text_line_batch_queue_t(size_t capacity = 8);
+
+      // Push a batch, waiting while the queue is full. The given batch is
+      // swapped with an old batch that can be refilled.
+      //
+      // Returns false if the consumer canceled the queue, so the producer
+      // should stop producing.
+      bool push(text_line_batch_t& batch);
+
+      // Pop a batch, waiting while the queue is empty.
+      //
+      // Returns false once the producer closed the queue and all batches were popped.
+      bool pop(text_line_batch_t& batch);
+
+      // Called by the producer when no more batches will be pushed.
+      void close();
+
+      // Called by the consumer when no more batches will be popped.
+      void cancel();
+
+   private:
+      std::vector<text_line_batch_t> _batches;
+
+      // The number of batches pushed and popped so far.
+      //
+      // Closing sets the done flag in the pushed count and canceling sets it in
+      // the popped count, so the waiting thread sees the change and wakes up.
+      static constexpr size_t done_flag = size_t(1) << (sizeof(size_t) * 8 - 1);
+
+      std::atomic<size_t> _pushed = 0;
+      std::atomic<size_t> _popped = 0;
+   };
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "dak/tree_reader/text_tree.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   struct tree_filter_t;
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Summaries of the texts found in the sub-trees of a tree.
+   //
+   // Each node with children has a small Bloom filter of the trigrams of the
+   // texts of its whole sub-tree, itself included. A text whose trigrams are
+   // not all in the sketch of a node is in no node of its sub-tree, so the
+   // sub-tree can be skipped when searching for that text.
+   //
+   // The sketches of large sub-trees fill up, so they mostly help in deep
+   // trees where matches are grouped in a few branches.
+   //
+   // The sketches refer to the nodes of their tree by their index, so they
+   // are only valid for the tree they were built from, while it is not modified.
+
+   struct text_subtree_sketches_t
+   {
+      // The minimum number of nodes for which building the sketches pays off.
+      static constexpr size_t min_sketched_nodes = 100000;
+
+      // The number of 64-bits words per sketch.
+      static constexpr size_t sketch_words = 4;
+
+      using sketch_t = std::array<uint64_t, sketch_words>;
+
+      // No sketches, valid for no tree.
+      text_subtree_sketches_t() = default;
+
+      // Sketch the sub-trees of the tree. If aborted, there are no sketches.
+      text_subtree_sketches_t(const text_tree_t& tree, const std::atomic<bool>* abort = nullptr);
+
+      // Verify if the sketches were built from the tree, in its current state.
+      bool is_of(const text_tree_t& tree) const { return _tree == &tree && _tree_size == tree.size(); }
+
+      // Sketch the trigrams of a text. Texts shorter than a trigram have an
+      // empty sketch, which may be found anywhere.
+      static sketch_t sketch_text(std::wstring_view text);
+
+      // Verify if the sketched text may be in the sub-tree of the node.
+      // Nodes without children have no sketch, so it always may be.
+      bool may_contain(const text_tree_t::node_t& node, const sketch_t& text) const;
+
+      // The number of sketched nodes.
+      size_t size() const { return _sketches.size(); }
+
+   private:
+      static constexpr uint32_t no_sketch = uint32_t(-1);
+
+      const text_tree_t* _tree = nullptr;
+      size_t _tree_size = 0;
+      std::vector<uint32_t> _sketch_indexes;
+      std::vector<sketch_t> _sketches;
+   };
+
+   typedef std::shared_ptr<const text_subtree_sketches_t> text_subtree_sketches_ptr_t;
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Build the sketches of a tree in the background.
+   //
+   // Set the abort flag to stop building, there are then no sketches.
+
+   using async_subtree_sketches_t = std::pair<std::future<text_subtree_sketches_ptr_t>, std::shared_ptr<std::atomic<bool>>>;
+
+   async_subtree_sketches_t build_subtree_sketches_async(const text_tree_ptr_t& tree);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Finds the sub-trees in which a filter cannot keep any node, using
+   // the sketches of the tree.
+   //
+   // The contains filters and the regex filters with a required text are
+   // verified against the sketches, combined by the and and or filters,
+   // directly or through named filters. Other filters may keep any node.
+   //
+   // Only stateless filters are handled (see is_stateless_filter), so that
+   // not calling them on the skipped nodes changes nothing. Otherwise, or
+   // when the tree has no valid sketches, no sub-tree is ever skipped.
+   //
+   // Prepare it after the filter began filtering the tree, since that can
+   // change the regex of the regex filters.
+
+   struct subtree_pruner_t
+   {
+      subtree_pruner_t() = default;
+      subtree_pruner_t(const tree_filter_t& filter, const text_tree_t& tree);
+
+      // Verify if some sub-trees may be skipped.
+      bool is_active() const { return bool(_sketches); }
+
+      // Verify if the filter keeps no node in the sub-tree of the node, itself included.
+      // Never true for a tree other than the one it was prepared for.
+      bool can_skip(const text_tree_t& tree, const text_tree_t::node_t& node) const { return _sketches && _sketches->is_of(tree) && !may_keep(0, node); }
+
+   private:
+      enum class term_kind_t : uint8_t
+      {
+         any_node,   // may keep any node.
+         text,       // may keep nodes containing the sketched text.
+         all,        // may keep a node only where all sub-terms may.
+         any,        // may keep a node where any sub-term may.
+      };
+
+      struct term_t
+      {
+         term_kind_t kind = term_kind_t::any_node;
+         text_subtree_sketches_t::sketch_t sketch = {};
+         std::vector<uint32_t> sub_terms;
+      };
+
+      uint32_t add_term(const tree_filter_t* filter, std::vector<const tree_filter_t*>& named_in_progress);
+      bool may_keep(uint32_t term, const text_tree_t::node_t& node) const;
+
+      text_subtree_sketches_ptr_t _sketches;
+      std::vector<term_t> _terms;
+   };
+}
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "dak/tree_reader/text_hash.h"
+
 #include <string>
+#include <string_view>
 #include <deque>
 #include <vector>
 #include <memory>
@@ -26,24 +29,45 @@ namespace dak::tree_reader
    // Each node contains its text, children and index in its parent.
    //
    // Use a text_holder to make the text used by the tree nodes valid.
+   //
+   // The tree can hold wide text or UTF-8 text. (See text_tree_t and utf8_text_tree_t.)
 
-   struct text_tree_t
+   template <class CHAR>
+   struct basic_text_tree_t
    {
+      typedef CHAR char_t;
+
       // Each node contains its text and the index of the next sibling and the first child.
 
       struct node_t
       {
          // Points into the source text lines.
-         const wchar_t* text_ptr = nullptr;
+         const CHAR* text_ptr = nullptr;
+
+         // The length of the text, recorded when the node is added
+         // so the text never needs to be scanned for its terminator.
+         size_t text_length = 0;
+
+         // The hash of the text, computed once when the node is added.
+         uint64_t text_hash = 0;
 
          node_t* parent = nullptr;
 
          size_t index_in_parent = 0;
 
+         // The number of ancestors of the node. Roots have a depth of zero.
+         size_t depth = 0;
+
+         // The position of the node in the order nodes were added to the tree.
+         size_t index = 0;
+
          std::vector<node_t *> children;
 
          node_t() = default;
-         node_t(const wchar_t* text, node_t* parent) : text_ptr(text), parent(parent) {}
+         node_t(const CHAR* text, size_t length, uint64_t hash, node_t* parent)
+            : text_ptr(text), text_length(length), text_hash(hash), parent(parent), depth(parent ? parent->depth + 1 : 0) {}
+
+         std::basic_string_view<CHAR> text() const { return std::basic_string_view<CHAR>(text_ptr, text_length); }
       };
 
       // Source text lines are kept constant so that the text pointers are kept valid.
@@ -52,11 +76,34 @@ namespace dak::tree_reader
       // The roots of the tree of nodes.
       std::vector<node_t *> roots;
 
+      basic_text_tree_t() = default;
+
+      // Copying adds the nodes again, so the copy never points into the nodes
+      // of the original. The texts are shared through the source text lines.
+      basic_text_tree_t(const basic_text_tree_t& other);
+      basic_text_tree_t& operator=(const basic_text_tree_t& other);
+
+      basic_text_tree_t(basic_text_tree_t&&) = default;
+      basic_text_tree_t& operator=(basic_text_tree_t&&) = default;
+
       // clear the tree.
       void reset();
 
       // adding new nodes. To add the a root, pass nullptr.
-      node_t* add_child(node_t* undernode, const wchar_t* text);
+      node_t* add_child(node_t* undernode, const CHAR* text);
+      node_t* add_child(node_t* undernode, const CHAR* text, size_t length);
+
+      // adding a node with the already known hash of its text.
+      node_t* add_child(node_t* undernode, const CHAR* text, size_t length, uint64_t hash);
+
+      // Remove the last node that was added. It has no children.
+      void remove_last_node();
+
+      // The number of nodes.
+      size_t size() const { return _nodes.size(); }
+
+      // Access a node by its index.
+      const node_t& node(size_t index) const { return _nodes[index]; }
 
       // Count the number of chilren of a node.
       // Pass null to count the number of roots.
@@ -76,12 +123,45 @@ namespace dak::tree_reader
 
    };
 
+   extern template struct basic_text_tree_t<wchar_t>;
+   extern template struct basic_text_tree_t<char>;
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // The tree of wide text.
+   //
+   // This is the tree used by the filters, the commands and the application.
+
+   struct text_subtree_sketches_t;
+
+   struct text_tree_t : basic_text_tree_t<wchar_t>
+   {
+      // Optional summaries of the texts of the sub-trees, allowing filters
+      // to skip the sub-trees where they cannot match. See text_subtree_sketches_t.
+      std::shared_ptr<const text_subtree_sketches_t> subtree_sketches;
+   };
+
    typedef std::shared_ptr<text_tree_t> text_tree_ptr_t;
 
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // The tree of UTF-8 text.
+   //
+   // Uses a quarter of the memory of the wide tree for mostly ASCII text.
+
+   struct utf8_text_tree_t : basic_text_tree_t<char>
+   {
+   };
+
+   typedef std::shared_ptr<utf8_text_tree_t> utf8_text_tree_ptr_t;
+
    ////////////////////////////////////////////////////////////////////////////
    //
    // Convert the text tree to a textual form with indentation.
 
    std::wostream& print_tree(std::wostream& stream, const text_tree_t& tree, const std::wstring& indentation = L"  ");
    std::wostream& operator<<(std::wostream& stream, const text_tree_t& tree);
+
+   std::ostream& print_tree(std::ostream& stream, const utf8_text_tree_t& tree, const std::string& indentation = "  ");
+   std::ostream& operator<<(std::ostream& stream, const utf8_text_tree_t& tree);
 }
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "dak/tree_reader/text_tree.h"
+#include "dak/tree_reader/simple_tree_reader.h"
+#include "dak/tree_reader/text_line_batch_queue.h"
+
+#include <chrono>
+#include <filesystem>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Follows a text file that grows, appending its new lines to the tree
+   // that was loaded from it.
+   //
+   // Only the bytes appended since the last read are read, and each new line
+   // is added to the last branch of the tree at the depth given by its
+   // indentation, as if the whole file had been loaded. The cost of each
+   // update is proportional to the appended text, not the size of the file.
+   //
+   // Starting to follow reads the file once to find where the lines of the
+   // tree end and the indentation of its last branch. If the tree was loaded
+   // while the last line was being written, the node of that incomplete line
+   // is replaced once the line is complete. A file that ends without a line
+   // end keeps its last node until more text is appended.
+   //
+   // Changes are detected with inotify on Linux and by polling the size
+   // and modification time of the file otherwise.
+   //
+   // The tree must not be used by other threads while lines are appended.
+
+   struct text_tree_follower_t
+   {
+      // Follow the file from which the tree was loaded with the given options.
+      text_tree_follower_t(const std::filesystem::path& path, const text_tree_ptr_t& tree, const load_simple_text_tree_options_t& options);
+      ~text_tree_follower_t();
+
+      text_tree_follower_t(const text_tree_follower_t&) = delete;
+      text_tree_follower_t& operator=(const text_tree_follower_t&) = delete;
+
+      // The interval between checks of the file when polling.
+      std::chrono::milliseconds poll_interval = std::chrono::milliseconds(250);
+
+      // Wait up to the timeout for the file to change.
+      // Returns true if the file may have changed.
+      bool wait_for_change(std::chrono::milliseconds timeout);
+
+      // Append the new complete lines of the file to the tree.
+      // Returns the number of nodes added.
+      size_t append_new_lines();
+
+      // Verify if the last appending replaced the last node of the tree,
+      // because it was an incomplete line, instead of only adding nodes.
+      // The trees filtered from it must then be filtered again.
+      // Clears the indication.
+      bool was_last_node_replaced();
+
+      // Verify if the file became shorter than what was read, in which case
+      // it was truncated or replaced and the tree must be loaded again.
+      bool was_truncated() const { return _truncated; }
+
+      const text_tree_ptr_t& tree() const { return _tree; }
+
+   private:
+      // Add the lines to the last branch of the tree at their depth.
+      size_t add_lines(const text_line_batch_t& lines);
+
+      // Set the branch to the nodes from the last root to the last node.
+      void set_branch_to_last_node();
+
+      // Verify if the size or modification time of the file changed since the last check.
+      bool has_file_info_changed();
+
+      std::filesystem::path _path;
+      text_tree_ptr_t _tree;
+      load_simple_text_tree_options_t _options;
+      appended_text_lines_reader_t _reader;
+      bool _truncated = false;
+
+      // The last node of the tree is a line not yet complete in the file,
+      // or was replaced by the last appending.
+      bool _last_line_incomplete = false;
+      bool _last_node_replaced = false;
+
+      // The nodes of the last branch of the tree, by depth.
+      std::vector<text_tree_t::node_t*> _branch;
+
+      // The file information seen by the last check, when polling.
+      uintmax_t _file_size = 0;
+      std::filesystem::file_time_type _file_time;
+
+      // The inotify instance, or -1 when polling.
+      int _notify = -1;
+   };
+
+   typedef std::shared_ptr<text_tree_follower_t> text_tree_follower_ptr_t;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "dak/tree_reader/text_tree.h"
+#include "dak/tree_reader/simple_tree_reader.h"
+
+#include <filesystem>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // A binary snapshot of a text tree loaded from a text file.
+   //
+   // Reloading the snapshot avoids reading, decoding and indenting the text
+   // file again. It still adds every node to the tree, in a single pass.
+   //
+   // The snapshot contains a header, the per-node arrays of parents, text
+   // offsets, text lengths and optionally text hashes, followed by the
+   // null-terminated texts of all nodes. The nodes are in the order they were
+   // added, so the tree is rebuilt by adding each node to its parent, which
+   // also gives the children, depths and indexes of the nodes.
+   //
+   // Each array starts on an 8-byte boundary, so the arrays are read directly
+   // from a memory mapping. The texts of the loaded tree point into the mapping
+   // and are only paged in when used.
+   //
+   // The header records the size and modification time of the text file and
+   // the options used to read it, so a snapshot is only loaded while it still
+   // gives the same tree as reading the text file.
+
+   // The path of the snapshot kept next to the given text file.
+   std::filesystem::path get_text_tree_snapshot_path(const std::filesystem::path& source_path);
+
+   // Save the tree loaded from the source file with the given options.
+   // Returns false if the snapshot could not be written.
+   bool save_text_tree_snapshot(const std::filesystem::path& snapshot_path, const text_tree_t& tree,
+                                const std::filesystem::path& source_path, const load_simple_text_tree_options_t& options,
+                                bool with_hashes = true);
+
+   // Load the tree from the snapshot if it matches the source file and the options.
+   // Returns false, leaving the tree unchanged, if the snapshot is missing, invalid or stale.
+   bool load_text_tree_snapshot(const std::filesystem::path& snapshot_path, const std::filesystem::path& source_path,
+                                const load_simple_text_tree_options_t& options, text_tree_t& tree);
+}
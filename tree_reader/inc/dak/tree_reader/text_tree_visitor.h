@@ -119,4 +119,17 @@ namespace dak::tree_reader
    {
       visit_in_order(tree, nullptr, true, func);
    }
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // visits each node of a UTF-8 tree in order, calling a function.
+
+   typedef std::function<tree_visitor_t::result_t(const utf8_text_tree_t& tree, const utf8_text_tree_t::node_t& node, size_t level)> utf8_node_visit_function_t;
+
+   void visit_in_order(const utf8_text_tree_t& tree, const utf8_text_tree_t::node_t* node, bool siblings, const utf8_node_visit_function_t& func);
+
+   inline void visit_in_order(const utf8_text_tree_t& tree, const utf8_node_visit_function_t& func)
+   {
+      visit_in_order(tree, nullptr, true, func);
+   }
 }
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "dak/tree_reader/text_tree.h"
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Index of the texts of the nodes of a tree by their trigrams.
+   //
+   // Each sequence of three characters found in the texts maps to the list
+   // of the indexes of the nodes containing it. A text of at least three
+   // characters can only be in the nodes found in the lists of all its
+   // trigrams, so only those nodes need to be verified.
+   //
+   // The lists are kept compressed, each node index being stored as the
+   // variable-length difference with the previous one.
+   //
+   // The index refers to the nodes of its tree by their index, so it is
+   // only valid for the tree it was built from, while it is not modified.
+
+   struct text_trigram_index_t
+   {
+      // The minimum number of nodes for which building the index pays off.
+      static constexpr size_t min_indexed_nodes = 100000;
+
+      // The length of the indexed character sequences.
+      static constexpr size_t trigram_length = 3;
+
+      // An empty index, valid for no tree.
+      text_trigram_index_t() = default;
+
+      // Index the texts of the tree. If aborted, the index is left empty.
+      text_trigram_index_t(const text_tree_t& tree, const std::atomic<bool>* abort = nullptr);
+
+      // Verify if the index was built from the tree, in its current state.
+      bool is_of(const text_tree_t& tree) const { return _tree == &tree && _tree_size == tree.size(); }
+
+      // Find the indexes of the nodes whose text may contain the given text,
+      // in increasing order. Returns false when the text is too short to use
+      // the index, in which case all nodes may contain it.
+      bool find_candidates(std::wstring_view text, std::vector<size_t>& candidates) const;
+
+      // The number of distinct trigrams.
+      size_t size() const { return _postings.size(); }
+
+   private:
+      struct posting_t
+      {
+         std::vector<uint8_t> deltas;
+         size_t count = 0;
+         size_t last = 0;
+      };
+
+      const text_tree_t* _tree = nullptr;
+      size_t _tree_size = 0;
+      std::unordered_map<uint64_t, posting_t> _postings;
+   };
+
+   typedef std::shared_ptr<const text_trigram_index_t> text_trigram_index_ptr_t;
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Build the index of a tree in the background.
+   //
+   // Set the abort flag to stop building, the index is then empty.
+
+   using async_trigram_index_t = std::pair<std::future<text_trigram_index_ptr_t>, std::shared_ptr<std::atomic<bool>>>;
+
+   async_trigram_index_t build_trigram_index_async(const text_tree_ptr_t& tree);
+}
@@ -4,9 +4,14 @@
 #include "dak/tree_reader/tree_filter.h"
 #include "dak/tree_reader/tree_filtering.h"
 #include "dak/tree_reader/named_filters.h"
+#include "dak/tree_reader/text_trigram_index.h"
+#include "dak/tree_reader/text_subtree_sketch.h"
+#include "dak/tree_reader/text_tree_follower.h"
 #include "dak/utility/undo_stack.h"
 
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <string>
 #include <filesystem>
 
@@ -27,6 +32,7 @@ namespace dak::tree_reader
       // Create a new tree command for the given tree.
 
       tree_commands_t(text_tree_ptr_t tree, std::wstring name, std::shared_ptr<named_filters_t> knownFilters, std::shared_ptr<undo_stack> undoRedo);
+      ~tree_commands_t();
 
       // Current filter.
 
@@ -40,6 +46,10 @@ namespace dak::tree_reader
       text_tree_ptr_t get_original_tree() const;
       std::wstring get_original_tree_filename() const;
 
+      // The options the tree was read with, if it was read from its file.
+      void set_original_tree_read_options(const load_simple_text_tree_options_t& options);
+      const std::optional<load_simple_text_tree_options_t>& get_original_tree_read_options() const;
+
       // _filtered tree.
 
       text_tree_ptr_t get_filtered_tree() const;
@@ -61,6 +71,24 @@ namespace dak::tree_reader
       bool is_async_search_ready();
       void apply_search_in_tree(bool async);
 
+      // Following the file of the tree as it grows.
+      //
+      // The lines appended to the file are added to the tree. When the filter only
+      // looks at the current node and its ancestors, only the new nodes are filtered
+      // and the kept ones are appended to the filtered tree, and likewise for the
+      // search. Otherwise the whole tree is filtered again.
+      //
+      // Updating does nothing while an asynchronous filtering or searching is in
+      // progress, the appended lines are read by a later update.
+      // See text_tree_follower_t and appended_nodes_filtering_t.
+
+      bool follow_tree_file(const load_simple_text_tree_options_t& options);
+      void stop_following_tree_file();
+      bool is_following_tree_file() const;
+      bool was_followed_tree_file_truncated() const;
+      bool wait_for_followed_tree_file_change(std::chrono::milliseconds timeout);
+      size_t update_followed_tree();
+
       // _filtered tree save.
 
       static constexpr char tree_file_types[] = "Text Tree files (*.txt *.log);;Text files (*.txt);;Log files (*.log)";
@@ -73,6 +101,18 @@ namespace dak::tree_reader
       void awaken_filters(const std::any& data);
       void commit_filter_to_undo();
 
+      // Filter and search the nodes appended to the followed tree.
+      void filter_followed_tree();
+
+      // Give the trigram index to the leaf match cache and the sub-tree
+      // sketches to the tree when they are ready.
+      void use_text_indexes_if_ready();
+
+      // Start indexing the texts and sketching the sub-trees of a new filtered tree,
+      // for the searches, and give them to its leaf match cache and to the tree when ready.
+      void index_filtered_tree();
+      void use_filtered_text_indexes_if_ready();
+
       // Asynchronous filtering and searching.
       async_filter_tree_result_t _async_filtering;
       async_filter_tree_result_t _async_searching;
@@ -81,9 +121,41 @@ namespace dak::tree_reader
       std::wstring _searched_text;
       text_tree_ptr_t _searched;
 
+      // The search filter that gave the searched tree and the tree it searched,
+      // allows refining the previous search when the search text is extended.
+      tree_filter_ptr_t _searched_filter;
+      text_tree_ptr_t _searched_source;
+      tree_filter_ptr_t _async_searched_filter;
+      text_tree_ptr_t _async_searched_source;
+
       std::wstring _tree_filename;
+      std::optional<load_simple_text_tree_options_t> _tree_read_options;
       text_tree_ptr_t _tree;
 
+      // Matches of the leaf filters over the tree, kept between filter edits.
+      leaf_match_cache_ptr_t _leaf_matches = std::make_shared<leaf_match_cache_t>();
+
+      // Index of the texts of large trees, built in the background
+      // and given to the leaf match cache once ready.
+      async_trigram_index_t _trigram_index;
+
+      // Sketches of the sub-trees of large trees, built in the background
+      // and given to the tree once ready.
+      async_subtree_sketches_t _subtree_sketches;
+
+      // Matches of the leaf filters over the filtered tree, and the index of its
+      // texts and sketches of its sub-trees, built in the background, used by the searches.
+      leaf_match_cache_ptr_t _filtered_leaf_matches = std::make_shared<leaf_match_cache_t>();
+      async_trigram_index_t _filtered_trigram_index;
+      async_subtree_sketches_t _filtered_subtree_sketches;
+
+      // The follower of the file of the tree, and the filtering and searching
+      // of the nodes appended to the tree and to the filtered tree.
+      text_tree_follower_ptr_t _follower;
+      std::shared_ptr<appended_nodes_filtering_t> _appended_filtering;
+      tree_filter_ptr_t _appended_filter;
+      std::shared_ptr<appended_nodes_filtering_t> _appended_searching;
+
       std::wstring _filtered_filename;
       text_tree_ptr_t _filtered;
       bool _filtered_was_saved = false;
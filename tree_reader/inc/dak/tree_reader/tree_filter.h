@@ -2,11 +2,13 @@
 
 #include "dak/tree_reader/text_tree.h"
 #include "dak/tree_reader/text_tree_visitor.h"
+#include "dak/tree_reader/substring_searcher.h"
+#include "dak/tree_reader/linear_regex.h"
+#include "dak/tree_reader/text_subtree_sketch.h"
 
 #include <string>
 #include <memory>
 #include <vector>
-#include <regex>
 #include <future>
 #include <unordered_set>
 
@@ -45,6 +47,10 @@ namespace dak::tree_reader
       // filter a node to decide to keep drop the node.
       virtual result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) = 0;
 
+      // Called before filtering a whole tree, to let the filter prepare data for this filtering run.
+      // Filters containing other filters forward the call to them.
+      virtual void begin_filtering(const text_tree_t& tree);
+
       // gets the name of the node, including its data.
       virtual std::wstring get_name() const;
 
@@ -73,6 +79,7 @@ namespace dak::tree_reader
       delegate_tree_filter_t(const delegate_tree_filter_t& other);
 
       result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) override;
+      void begin_filtering(const text_tree_t& tree) override;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -141,19 +148,28 @@ namespace dak::tree_reader
    ////////////////////////////////////////////////////////////////////////////
    //
    // filter that keeps nodes containing a given text.
+   //
+   // The searcher for the text is prepared when created and before filtering,
+   // so changes to the contained text take effect when filtering the next tree.
 
    struct contains_tree_filter_t : tree_filter_t
    {
       std::wstring contained;
 
       contains_tree_filter_t() = default;
-      contains_tree_filter_t(const std::wstring& text) : contained(text) { }
+      contains_tree_filter_t(const std::wstring& text) : contained(text), _searcher(text) { }
 
       result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) override;
+      void begin_filtering(const text_tree_t& tree) override;
       std::wstring get_name() const override;
       std::wstring get_short_name() const override;
       std::wstring get_description() const override;
       tree_filter_ptr_t clone() const override;
+
+      const substring_searcher_t& searcher() const { return _searcher; }
+
+   private:
+      substring_searcher_t _searcher;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -170,10 +186,7 @@ namespace dak::tree_reader
       tree_filter_ptr_t clone() const override;
 
    private:
-      struct hash { int  operator()(const wchar_t* text) const; };
-      struct comp { bool operator()(const wchar_t* lhs, const wchar_t* rhs) const; };
-
-      std::unordered_set<const wchar_t*, hash, comp> _uniques;
+      text_hash_set_t _uniques;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -202,16 +215,20 @@ namespace dak::tree_reader
    struct regex_tree_filter_t : tree_filter_t
    {
       std::wstring regex_text;
-      std::wregex regex;
+      linear_regex_t regex;
 
       regex_tree_filter_t() = default;
-      regex_tree_filter_t(const std::wstring& reg) : regex_text(reg), regex(std::wregex(reg)) { }
+      regex_tree_filter_t(const std::wstring& reg) : regex_text(reg), regex(reg), _compiled_text(reg) { }
 
       result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) override;
+      void begin_filtering(const text_tree_t& tree) override;
       std::wstring get_name() const override;
       std::wstring get_short_name() const override;
       std::wstring get_description() const override;
       tree_filter_ptr_t clone() const override;
+
+   private:
+      std::wstring _compiled_text;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -227,6 +244,8 @@ namespace dak::tree_reader
       combine_tree_filter_t(const tree_filter_ptr_t& lhs, const tree_filter_ptr_t& rhs) { filters.push_back(lhs); filters.push_back(rhs); }
       combine_tree_filter_t(const std::vector<tree_filter_ptr_t>& filters) : filters(filters) {}
       combine_tree_filter_t(const combine_tree_filter_t& other);
+
+      void begin_filtering(const text_tree_t& tree) override;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -281,6 +300,10 @@ namespace dak::tree_reader
    // filter that accepts all children of a node that was accepted by another.
    //
    // Can accept or not that parent initial node.
+   //
+   // When the other filter only depends on the text of nodes and the tree
+   // has sub-tree sketches, the sub-trees where it cannot match are dropped
+   // without calling it. See subtree_pruner_t.
 
    struct under_tree_filter_t : delegate_tree_filter_t
    {
@@ -291,12 +314,15 @@ namespace dak::tree_reader
          : delegate_tree_filter_t(filter), include_self(includeSelf) {}
 
       result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) override;
+      void begin_filtering(const text_tree_t& tree) override;
       std::wstring get_short_name() const override;
       std::wstring get_description() const override;
       tree_filter_ptr_t clone() const override;
 
    private:
       size_t _keep_all_nodes_under_level = -1;
+      size_t _drop_all_nodes_under_level = -1;
+      subtree_pruner_t _pruner;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -343,6 +369,13 @@ namespace dak::tree_reader
    //
    // filter that accepts a node if at least one child is accepted
    // by another filter.
+   //
+   // When the other filter only depends on the text of nodes, the nodes
+   // having a matching descendant are all found in a single bottom-up pass
+   // when the filtering begins, instead of visiting the sub-tree of each node.
+   //
+   // When the tree has sub-tree sketches, the sub-trees where the other
+   // filter cannot match are not visited. See subtree_pruner_t.
 
    struct if_subtree_tree_filter_t : delegate_tree_filter_t
    {
@@ -350,12 +383,18 @@ namespace dak::tree_reader
       if_subtree_tree_filter_t(const tree_filter_ptr_t& filter) : delegate_tree_filter_t(filter) { }
 
       result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) override;
+      void begin_filtering(const text_tree_t& tree) override;
       std::wstring get_short_name() const override;
       std::wstring get_description() const override;
       tree_filter_ptr_t clone() const override;
 
    private:
       text_tree_t _filtered;
+
+      // The tree for which the matching descendants were found, if any.
+      const text_tree_t* _matched_tree = nullptr;
+      std::unordered_set<const text_tree_t::node_t*> _nodes_with_matching_descendant;
+      subtree_pruner_t _pruner;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -369,9 +408,29 @@ namespace dak::tree_reader
       if_sibling_tree_filter_t(const tree_filter_ptr_t& filter) : delegate_tree_filter_t(filter) { }
 
       result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) override;
+      void begin_filtering(const text_tree_t& tree) override;
       std::wstring get_short_name() const override;
       std::wstring get_description() const override;
       tree_filter_ptr_t clone() const override;
+
+   private:
+      // When the sub-filter only depends on the text of nodes, the siblings
+      // are matched once per group of siblings, in a reverse scan.
+      //
+      // For each sibling, records if it or a later sibling matches
+      // before the sub-filter asked to stop.
+      //
+      // One group is kept per depth, since the children of a sibling
+      // are visited before the next sibling.
+      struct matched_group_t
+      {
+         const text_tree_t::node_t* parent = nullptr;
+         bool is_matched = false;
+         std::vector<bool> later_sibling_matches;
+      };
+
+      const text_tree_t* _matched_tree = nullptr;
+      std::vector<matched_group_t> _matched_groups;
    };
 
    ////////////////////////////////////////////////////////////////////////////
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "dak/tree_reader/global_commands.h"
+#include "dak/tree_reader/lazy_text_tree.h"
+
+#include <filesystem>
+#include <ostream>
 
 namespace dak::tree_reader
 {
@@ -18,6 +22,18 @@ namespace dak::tree_reader
 
       tree_commands_ptr_t current_tree;
 
+      // The file filtered while it is read, instead of being loaded.
+
+      std::filesystem::path streamed_filename;
+
+      // The file indexed without being loaded, for files too large to be loaded.
+
+      lazy_text_tree_ptr_t lazy_tree;
+
+      // Keep reading the lines appended to the file of the current tree.
+
+      bool is_following = false;
+
       // Help.
 
       std::wstring get_help() const;
@@ -30,11 +46,31 @@ namespace dak::tree_reader
       std::wstring create_filter();
       std::wstring create_filter(const std::wstring& filterText);
 
+      // Filter the streamed file while it is read and print the kept lines.
+      // Returns an error message if the filter needs the whole tree.
+
+      std::wstring filter_streamed_file(std::wostream& output);
+
+      // Filter the lines of the lazy tree and print the kept lines.
+      // Returns an error message if the filter needs the whole tree.
+
+      std::wstring filter_lazy_tree(std::wostream& output);
+
+      // Follow the file of the current tree and print the kept lines as they are appended.
+      // Runs until the file becomes shorter and returns why it stopped.
+
+      std::wstring follow_current_tree(std::wostream& output);
+
       // Named filters management.
 
       std::wstring list_filters();
 
       // Command parsing.
+      //
+      // A loaded file is only read once a command needs its tree. When no command
+      // needs it, the program is not interactive nor following the file and the
+      // filter only looks at the current line and its parents, the file is
+      // streamed instead, so reading, filtering and printing overlap.
 
       std::wstring parse_commands(const std::wstring& cmdText);
       std::wstring parse_commands(const std::vector<std::wstring>& cmds);
@@ -50,7 +86,14 @@ namespace dak::tree_reader
       }
 
    protected:
+      // Load the file given to the last load command, if not yet loaded.
+      void load_pending_tree();
+
+      // Verify if the file given to the last load command can be streamed instead.
+      bool can_stream_pending_tree() const;
+
       std::wstring filter_text;
+      std::filesystem::path pending_load_filename;
    };
 
 }
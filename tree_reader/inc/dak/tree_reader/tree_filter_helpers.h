@@ -20,5 +20,63 @@ namespace dak::tree_reader
    {
       return visit_filters(filter, true, func);
    }
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Verify if a filter only depends on the text of each node.
+   //
+   // That is, it ignores the level, keeps no state between nodes and
+   // never stops nor skips children, so it always gives the same result
+   // for a given node. Named filters are verified through the filter they name.
+
+   bool is_text_only_filter(const tree_filter_ptr_t& filter);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Verify if a contains filter, or an and of contains filters, keeps a
+   // subset of the nodes kept by another such filter.
+   //
+   // This is the case when each text searched by the wider filter is part
+   // of a text searched by the narrower one, for example when a search text
+   // is extended while being typed. Filtering the result of the wider filter
+   // with the narrower one then gives the same tree as filtering the original.
+
+   bool is_narrower_contains_filter(const tree_filter_ptr_t& narrower, const tree_filter_ptr_t& wider);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Verify if a filter result only depends on the node and its level.
+   //
+   // That is, it keeps no state between nodes, never stops and does not look
+   // at other nodes, so nodes can be filtered in any order. For example, contains,
+   // regex, level range and not are stateless while unique, under, until and stop
+   // are not. Named filters are verified through the filter they name.
+
+   bool is_stateless_filter(const tree_filter_t& filter);
+   bool is_stateless_filter(const tree_filter_ptr_t& filter);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Verify if a filter only looks at the current node and its ancestors.
+   //
+   // That is, it only needs the text and level of each node and the state it
+   // keeps while nodes are visited in order, so the lines of a text can be
+   // filtered while they are read, without building the tree. For example,
+   // contains, regex, level range, under, not, and and or are streamable while
+   // unique, which remembers all texts, and if-subtree and if-sibling, which
+   // look at other nodes, are not. Named filters are verified through
+   // the filter they name.
+
+   bool is_streamable_filter(const tree_filter_t& filter);
+   bool is_streamable_filter(const tree_filter_ptr_t& filter);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Clone a filter and all its sub-filters, including the filters named
+   // by named filters, so the copy shares nothing with the original.
+   //
+   // Allows using copies of a filter in multiple threads.
+
+   tree_filter_ptr_t deep_clone_filter(const tree_filter_t& filter);
 }
 
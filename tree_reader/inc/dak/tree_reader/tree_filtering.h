@@ -1,6 +1,8 @@
 #pragma once
 
 #include "dak/tree_reader/text_tree_visitor.h"
+#include "dak/tree_reader/leaf_match_cache.h"
+#include "dak/tree_reader/simple_tree_reader.h"
 
 #include <memory>
 #include <vector>
@@ -10,17 +12,113 @@ namespace dak::tree_reader
 {
    struct tree_filter_t;
    typedef std::shared_ptr<tree_filter_t> tree_filter_ptr_t;
+   struct utf8_tree_filter_t;
+   struct lazy_text_tree_t;
 
    ////////////////////////////////////////////////////////////////////////////
    //
    // named_filters a source tree into a filtered tree using the given filter.
+   //
+   // The filter is compiled into a flat program before filtering.
+   // See compiled_tree_filter_t.
+   //
+   // When given a leaf match cache for the source tree, the contains and regex
+   // filters read their matches from the cache. See leaf_match_cache_t.
 
-   void filter_tree(const text_tree_t& sourceTree, text_tree_t& filteredTree, tree_filter_t& filter);
-   void filter_tree(const text_tree_t& sourceTree, text_tree_t& filteredTree, const tree_filter_ptr_t& filter);
+   void filter_tree(const text_tree_t& sourceTree, text_tree_t& filteredTree, tree_filter_t& filter, const leaf_match_cache_ptr_t& cache = nullptr);
+   void filter_tree(const text_tree_t& sourceTree, text_tree_t& filteredTree, const tree_filter_ptr_t& filter, const leaf_match_cache_ptr_t& cache = nullptr);
 
    using async_filter_tree_result_t = std::pair<std::future<text_tree_t>, std::shared_ptr<can_abort_tree_visitor>>;
 
-   async_filter_tree_result_t filter_tree_async(const text_tree_ptr_t& sourceTree, const tree_filter_ptr_t& filter);
+   async_filter_tree_result_t filter_tree_async(const text_tree_ptr_t& sourceTree, const tree_filter_ptr_t& filter, const leaf_match_cache_ptr_t& cache = nullptr);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // filter a source tree into a filtered tree using multiple threads.
+   //
+   // When the filter is stateless (see is_stateless_filter), the sub-trees
+   // are filtered in parallel, each thread taking the next sub-tree when done,
+   // then the filtered tree is assembled in order. Other filters are applied
+   // on the calling thread.
+   //
+   // filter_tree and filter_tree_async do this for large trees.
+
+   void filter_tree_in_parallel(const text_tree_t& sourceTree, text_tree_t& filteredTree, tree_filter_t& filter, size_t thread_count, const leaf_match_cache_ptr_t& cache = nullptr);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // filter a UTF-8 source tree into a filtered UTF-8 tree using the given UTF-8 filter.
+
+   void filter_tree(const utf8_text_tree_t& sourceTree, utf8_text_tree_t& filteredTree, utf8_tree_filter_t& filter);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // filter a simple flat text file while it is read and print the kept lines.
+   //
+   // Each line is filtered as soon as it is read and printed if kept, indented
+   // like print_tree would print the filtered tree, without building any tree.
+   // Only the current branch of lines is remembered, so the memory used is
+   // bounded by the depth of the tree, not by the size of the text.
+   //
+   // Reading, filtering and printing are done by separate threads, passing
+   // batches of lines to each other through bounded queues.
+   //
+   // The filter must only look at the current node and its ancestors.
+   // See is_streamable_filter.
+
+   void filter_simple_text(const std::filesystem::path& path, std::wostream& output, tree_filter_t& filter, const load_simple_text_tree_options_t& read_options, const std::wstring& indentation = L"  ");
+   void filter_simple_text(std::wistream& input, std::wostream& output, tree_filter_t& filter, const load_simple_text_tree_options_t& read_options, const std::wstring& indentation = L"  ");
+
+   // The lines of a lazy tree are read in order from its index, with its
+   // pages decoded ahead of the filtering. See lazy_text_tree_t.
+
+   void filter_simple_text(const lazy_text_tree_t& tree, std::wostream& output, tree_filter_t& filter, const std::wstring& indentation = L"  ");
+
+   // The kept lines of a lazy tree can instead be added to a filtered tree,
+   // which then holds a copy of their text.
+
+   void filter_simple_text(const lazy_text_tree_t& tree, text_tree_t& filtered_tree, tree_filter_t& filter);
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // filter a source tree that grows by appending nodes to its last branch,
+   // only filtering the nodes appended since the previous filtering.
+   //
+   // The nodes are filtered in the order they were added, which is the order
+   // they are visited in trees read from text. The appended nodes come after
+   // all the others, so filtering them continues the filtering of the whole
+   // tree and appends to the same filtered tree as filtering the whole tree
+   // again would, for filters that only look at the current node and its
+   // ancestors. See is_streamable_filter.
+   //
+   // The filter is copied, so its state is kept between filterings.
+   //
+   // The source tree must not have sub-tree sketches, since they would skip
+   // the sub-trees where no node was kept but where nodes can be appended.
+
+   struct appended_nodes_filtering_t
+   {
+      // Filter with the given filter, or keep all nodes when there is none.
+      appended_nodes_filtering_t(const tree_filter_ptr_t& filter);
+
+      // The kept nodes of all the source nodes filtered so far.
+      text_tree_ptr_t filtered_tree = std::make_shared<text_tree_t>();
+
+      // filter the source nodes appended since the previous call.
+      void filter_appended_nodes(const text_tree_t& sourceTree);
+
+   private:
+      tree_filter_ptr_t _filter;
+      size_t _filtered_count = 0;
+
+      // See filter_tree_visitor_t.
+      std::vector<text_tree_t::node_t*> _filtered_branch_nodes;
+      std::vector<bool> _fill_children;
+
+      // Nodes deeper than this level are in a sub-tree whose children are skipped.
+      size_t _skip_under_level = size_t(-1);
+      bool _stopped = false;
+   };
 
    ////////////////////////////////////////////////////////////////////////////
    //
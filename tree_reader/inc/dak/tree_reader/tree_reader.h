@@ -2,9 +2,14 @@
 
 #include "dak/tree_reader/text_tree.h"
 #include "dak/tree_reader/text_tree_visitor.h"
+#include "dak/tree_reader/lazy_text_tree.h"
+#include "dak/tree_reader/text_tree_follower.h"
+#include "dak/tree_reader/line_scanner.h"
 #include "dak/tree_reader/buffers_text_holder.h"
+#include "dak/tree_reader/mapped_text_holder.h"
 #include "dak/tree_reader/text_lines_text_holder.h"
 #include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/utf8_tree_filter.h"
 #include "dak/tree_reader/tree_filtering.h"
 #include "dak/tree_reader/named_filters.h"
 #include "dak/tree_reader/tree_filter_maker.h"
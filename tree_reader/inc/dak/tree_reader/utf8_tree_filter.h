@@ -0,0 +1,75 @@
+#pragma once
+
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/substring_searcher.h"
+#include "dak/tree_reader/linear_regex.h"
+
+#include <string>
+#include <memory>
+
+namespace dak::tree_reader
+{
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // filter used to reduce a UTF-8 text tree to another simpler UTF-8 text tree.
+   //
+   // Only the filters matching the text work directly on UTF-8 trees.
+   // All other filters work on the wide text tree.
+
+   struct utf8_tree_filter_t
+   {
+      using result_t = tree_filter_t::result_t;
+
+      virtual ~utf8_tree_filter_t() {};
+
+      // filter a node to decide to keep drop the node.
+      virtual result_t is_kept(const utf8_text_tree_t& tree, const utf8_text_tree_t::node_t& node, size_t level) = 0;
+   };
+
+   typedef std::shared_ptr<utf8_tree_filter_t> utf8_tree_filter_ptr_t;
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // filter that keeps UTF-8 nodes containing a given text.
+   //
+   // The searcher for the text is prepared when created.
+
+   struct utf8_contains_tree_filter_t : utf8_tree_filter_t
+   {
+      const std::string contained;
+
+      utf8_contains_tree_filter_t() = default;
+      utf8_contains_tree_filter_t(const std::string& text) : contained(text), _searcher(text) { }
+
+      result_t is_kept(const utf8_text_tree_t& tree, const utf8_text_tree_t::node_t& node, size_t level) override;
+
+   private:
+      utf8_substring_searcher_t _searcher;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // filter that keeps UTF-8 nodes matching a regular expression.
+   //
+   // The regular expression is applied to the UTF-8 bytes.
+
+   struct utf8_regex_tree_filter_t : utf8_tree_filter_t
+   {
+      std::string regex_text;
+      utf8_linear_regex_t regex;
+
+      utf8_regex_tree_filter_t() = default;
+      utf8_regex_tree_filter_t(const std::string& reg) : regex_text(reg), regex(reg) { }
+
+      result_t is_kept(const utf8_text_tree_t& tree, const utf8_text_tree_t::node_t& node, size_t level) override;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // functions to create UTF-8 filters.
+   //
+   // The text is converted to UTF-8 from wide text.
+
+   std::shared_ptr<utf8_contains_tree_filter_t> utf8_contains(const std::wstring& text);
+   std::shared_ptr<utf8_regex_tree_filter_t> utf8_regex(const std::wstring& reg);
+}
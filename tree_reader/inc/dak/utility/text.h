@@ -15,4 +15,7 @@ namespace dak::utility
 
    // join multiple text parts into one using the given delimiter.
    std::wstring join(const std::vector<std::wstring>& parts, wchar_t delimiter = L' ');
+
+   // convert wide text to UTF-8.
+   std::string to_utf8(const std::wstring& text);
 }
@@ -8,63 +8,49 @@ namespace dak::tree_reader
 
    pair<wchar_t*, size_t> buffers_text_holder_reader_t::read_line(wistream& stream)
    {
-      bool skip_newlines = true;
-
-      wchar_t* line = pos_in_buffer;
-      while (true)
+      while (next_line >= lines.size())
       {
-         if (pos_in_buffer >= buffer_end)
-         {
-            // Record how much we will need to transfer between the buffer
-            // and how big the new buffer must be.
-            const size_t amount_read_so_far = pos_in_buffer - line;
-            const size_t buffer_size = max(size_t(64 * 1024), amount_read_so_far * 2);
-
-            // allocate new buffer.
-            holder->text_buffers.emplace_back(make_shared<buffers_text_holder_t::buffer>());
-            auto buffer = holder->text_buffers.back();
-            // note: allocate one more character to be able to always put a terminating null.
-            buffer->resize(buffer_size + 1);
-
-            // Copy over the data that was reasd so far in th eprevious buffer.
-            if (amount_read_so_far > 0)
-               std::copy(line, line + amount_read_so_far, buffer->data());
-
-            // Adjust the variable to point into the new buffer.
-            line = buffer->data();
-            buffer_end = line + buffer_size;
-            pos_in_buffer = line + amount_read_so_far;
-
-            // Fill the empty part of the new buffer.
-            // stop if there was nothign left to read.
-            stream.read(pos_in_buffer, buffer_end - pos_in_buffer);
-            const auto amount_read = stream.gcount();
-            if (amount_read <= 0)
-               break;
-            buffer_end = pos_in_buffer + amount_read;
-         }
+         if (at_end)
+            return make_pair(buffer, 0);
+
+         // Record how much of the partial last line we will need to transfer
+         // between the buffers and how big the new buffer must be.
+         const size_t left_over = buffer_size - lines.scanned_end;
+         const size_t new_buffer_size = max(size_t(64 * 1024), left_over * 2);
+
+         // allocate new buffer.
+         holder->text_buffers.emplace_back(make_shared<buffers_text_holder_t::buffer>());
+         auto new_buffer = holder->text_buffers.back();
+         // note: allocate one more character to be able to always put a terminating null.
+         new_buffer->resize(new_buffer_size + 1);
+
+         // Copy over the partial line that was read in the previous buffer.
+         if (left_over > 0)
+            std::copy(buffer + lines.scanned_end, buffer + buffer_size, new_buffer->data());
+
+         // Release the previous buffers when the lines already read are not kept.
+         if (!keep_read_buffers)
+            holder->text_buffers.erase(holder->text_buffers.begin(), holder->text_buffers.end() - 1);
+
+         // Fill the empty part of the new buffer.
+         buffer = new_buffer->data();
+         stream.read(buffer + left_over, new_buffer_size - left_over);
+         buffer_size = left_over + size_t(max(streamsize(0), stream.gcount()));
+         at_end = !stream;
+
+         // Find all lines in the new buffer in one pass.
+         scan_lines(buffer, buffer_size, at_end, tab_size, lines);
+         next_line = 0;
+      }
 
-         if (skip_newlines)
-         {
-            if (*pos_in_buffer != '\n' && *pos_in_buffer != '\r')
-            {
-               line = pos_in_buffer;
-               skip_newlines = false;
-            }
-         }
-         else
-         {
-            if (*pos_in_buffer == '\n' || *pos_in_buffer == '\r')
-            {
-               *pos_in_buffer = 0;
-               pos_in_buffer++;
-               break;
-            }
-         }
+      wchar_t* line = buffer + lines.offsets[next_line];
+      const size_t count = lines.lengths[next_line];
+      indent = lines.indents[next_line];
+      text_index = lines.text_indexes[next_line];
+      ++next_line;
 
-         ++pos_in_buffer;
-      }
+      line[count] = 0;
 
-      return make_pair(line, pos_in_buffer - line);
+      return make_pair(line, count);
    }
 }
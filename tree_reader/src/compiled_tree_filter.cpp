@@ -0,0 +1,610 @@
+#include "dak/tree_reader/compiled_tree_filter.h"
+#include "dak/tree_reader/named_filters.h"
+
+#include <algorithm>
+#include <regex>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+   using result = tree_filter_t::result_t;
+   using node = text_tree_t::node_t;
+
+   constexpr result keep { false, false, true };
+   constexpr result drop { false, false, false };
+   constexpr result stop_and_keep { true, false, true };
+   constexpr result stop_and_drop { true, false, false };
+   constexpr result drop_and_skip { false, true, false };
+   constexpr result keep_and_skip { false, true, true };
+
+   namespace
+   {
+      // Combining filters with at least this many texts or regexes search them together.
+      constexpr size_t min_fused_texts = 4;
+      constexpr size_t min_fused_regexes = 2;
+
+      // Find the contains or regex filter under named and not filters,
+      // and its text. Literal regexes are treated like contains filters.
+      const tree_filter_t* find_text_filter(const tree_filter_t* filter, wstring& text, bool& is_regex)
+      {
+         vector<const tree_filter_t*> visited;
+         while (filter && find(visited.begin(), visited.end(), filter) == visited.end())
+         {
+            visited.emplace_back(filter);
+
+            if (auto named = dynamic_cast<const named_tree_filter_t*>(filter))
+            {
+               filter = named->filter.get();
+            }
+            else if (auto not_filter = dynamic_cast<const not_tree_filter_t*>(filter))
+            {
+               filter = not_filter->sub_filter.get();
+            }
+            else if (auto contains = dynamic_cast<const contains_tree_filter_t*>(filter))
+            {
+               text = contains->contained;
+               is_regex = false;
+               return filter;
+            }
+            else if (auto regex = dynamic_cast<const regex_tree_filter_t*>(filter))
+            {
+               text = regex->regex_text;
+               is_regex = (text.find_first_of(L"^$\\.*+?()[]{}|") != wstring::npos);
+               return filter;
+            }
+            else
+            {
+               return nullptr;
+            }
+         }
+
+         return nullptr;
+      }
+
+      // The number of nodes on which the sub-filters of combining filters are measured.
+      constexpr size_t planning_samples = 64;
+
+      // Verify if a filter keeps no state and never stops nor skips children,
+      // so that it can be evaluated in any order within an or or and filter.
+      bool is_reorderable(const tree_filter_t* filter, vector<const tree_filter_t*>& named_in_progress)
+      {
+         if (!filter)
+            return true;
+
+         if (auto named = dynamic_cast<const named_tree_filter_t*>(filter))
+         {
+            if (find(named_in_progress.begin(), named_in_progress.end(), named) != named_in_progress.end())
+               return false;
+
+            named_in_progress.emplace_back(named);
+            const bool reorderable = is_reorderable(named->filter.get(), named_in_progress);
+            named_in_progress.pop_back();
+            return reorderable;
+         }
+
+         if (auto not_filter = dynamic_cast<const not_tree_filter_t*>(filter))
+            return is_reorderable(not_filter->sub_filter.get(), named_in_progress);
+
+         if (auto combine = dynamic_cast<const combine_tree_filter_t*>(filter))
+         {
+            for (const auto& child : combine->filters)
+               if (!is_reorderable(child.get(), named_in_progress))
+                  return false;
+            return true;
+         }
+
+         // Level ranges skip the children of the nodes deeper than their maximum.
+         if (auto range = dynamic_cast<const level_range_tree_filter_t*>(filter))
+            return range->max_level == size_t(-1);
+
+         return dynamic_cast<const accept_tree_filter_t*>(filter)
+             || dynamic_cast<const contains_tree_filter_t*>(filter)
+             || dynamic_cast<const regex_tree_filter_t*>(filter)
+             || dynamic_cast<const text_address_tree_filter_t*>(filter);
+      }
+
+      // Estimate the relative cost of evaluating a filter on a node.
+      double estimate_cost(const tree_filter_t* filter, const leaf_match_cache_ptr_t& cache, vector<const tree_filter_t*>& named_in_progress)
+      {
+         if (!filter)
+            return 0.;
+
+         if (cache && leaf_match_cache_t::is_cacheable(*filter))
+            return 1.;
+
+         if (auto named = dynamic_cast<const named_tree_filter_t*>(filter))
+         {
+            if (find(named_in_progress.begin(), named_in_progress.end(), named) != named_in_progress.end())
+               return 1.;
+
+            named_in_progress.emplace_back(named);
+            const double cost = estimate_cost(named->filter.get(), cache, named_in_progress);
+            named_in_progress.pop_back();
+            return cost;
+         }
+
+         if (auto not_filter = dynamic_cast<const not_tree_filter_t*>(filter))
+            return 1. + estimate_cost(not_filter->sub_filter.get(), cache, named_in_progress);
+
+         if (auto combine = dynamic_cast<const combine_tree_filter_t*>(filter))
+         {
+            double cost = 1.;
+            for (const auto& child : combine->filters)
+               cost += estimate_cost(child.get(), cache, named_in_progress);
+            return cost;
+         }
+
+         if (dynamic_cast<const contains_tree_filter_t*>(filter))
+            return 4.;
+
+         if (dynamic_cast<const regex_tree_filter_t*>(filter))
+            return 16.;
+
+         return 1.;
+      }
+   }
+
+   compiled_tree_filter_t::compiled_tree_filter_t(tree_filter_t& filter, const leaf_match_cache_ptr_t& cache)
+   : _source(&filter), _cache(cache)
+   {
+      compile();
+   }
+
+   compiled_tree_filter_t::compiled_tree_filter_t(const tree_filter_ptr_t& filter, const leaf_match_cache_ptr_t& cache)
+   : _kept_source(filter), _source(filter.get()), _cache(cache)
+   {
+      compile();
+   }
+
+   void compiled_tree_filter_t::compile()
+   {
+      _program.clear();
+      _accumulators.clear();
+      _fused_groups.clear();
+      _fused_regex_groups.clear();
+
+      vector<const tree_filter_t*> named_in_progress;
+      compile(_source, 0, named_in_progress);
+      _fused_filters.clear();
+      _fused_regex_filters.clear();
+   }
+
+   compiled_tree_filter_t::instruction_t& compiled_tree_filter_t::add(op_t op)
+   {
+      _program.emplace_back().op = op;
+      return _program.back();
+   }
+
+   void compiled_tree_filter_t::compile(tree_filter_t* filter, size_t depth, vector<const tree_filter_t*>& named_in_progress)
+   {
+      // Missing filters keep all nodes, like a delegate filter without a sub-filter.
+      if (!filter)
+      {
+         add(op_t::accept);
+         return;
+      }
+
+      if (_cache && leaf_match_cache_t::is_cacheable(*filter))
+      {
+         add(op_t::cached_match).filter = filter;
+      }
+      else if (const auto fused = _fused_filters.find(filter); fused != _fused_filters.end())
+      {
+         instruction_t& instruction = add(op_t::fused_contains);
+         instruction.index = fused->second.first;
+         instruction.pattern = fused->second.second;
+      }
+      else if (const auto fused = _fused_regex_filters.find(filter); fused != _fused_regex_filters.end())
+      {
+         instruction_t& instruction = add(op_t::fused_regex);
+         instruction.index = fused->second.first;
+         instruction.pattern = fused->second.second;
+      }
+      else if (auto named = dynamic_cast<named_tree_filter_t*>(filter))
+      {
+         // A named filter that refers to itself cannot be inlined.
+         if (find(named_in_progress.begin(), named_in_progress.end(), named) != named_in_progress.end())
+         {
+            add(op_t::call).filter = filter;
+            return;
+         }
+
+         named_in_progress.push_back(named);
+         compile(named->filter.get(), depth, named_in_progress);
+         named_in_progress.pop_back();
+      }
+      else if (dynamic_cast<accept_tree_filter_t*>(filter))
+      {
+         add(op_t::accept);
+      }
+      else if (auto stop = dynamic_cast<stop_tree_filter_t*>(filter))
+      {
+         add(op_t::stop).flag = stop->keep;
+      }
+      else if (auto contains = dynamic_cast<contains_tree_filter_t*>(filter))
+      {
+         add(op_t::contains).searcher = &contains->searcher();
+      }
+      else if (auto regex = dynamic_cast<regex_tree_filter_t*>(filter))
+      {
+         add(op_t::regex).regex = &regex->regex;
+      }
+      else if (auto address = dynamic_cast<text_address_tree_filter_t*>(filter))
+      {
+         add(op_t::text_address).address = address->exact_address;
+      }
+      else if (auto range = dynamic_cast<level_range_tree_filter_t*>(filter))
+      {
+         instruction_t& instruction = add(op_t::level_range);
+         instruction.min_level = range->min_level;
+         instruction.max_level = range->max_level;
+      }
+      else if (auto not_filter = dynamic_cast<not_tree_filter_t*>(filter))
+      {
+         compile(not_filter->sub_filter.get(), depth, named_in_progress);
+         add(op_t::invert);
+      }
+      else if (auto stop_when_kept = dynamic_cast<stop_when_kept_tree_filter_t*>(filter))
+      {
+         compile(stop_when_kept->sub_filter.get(), depth, named_in_progress);
+         add(op_t::stop_when_kept);
+      }
+      else if (auto until = dynamic_cast<until_tree_filter_t*>(filter))
+      {
+         compile(until->sub_filter.get(), depth, named_in_progress);
+         add(op_t::until);
+      }
+      else if (auto remove = dynamic_cast<remove_children_tree_filter_t*>(filter))
+      {
+         compile(remove->sub_filter.get(), depth, named_in_progress);
+         add(op_t::remove_children).flag = remove->include_self;
+      }
+      else if (auto or_filter = dynamic_cast<or_tree_filter_t*>(filter))
+      {
+         compile_combine(*or_filter, true, depth, named_in_progress);
+      }
+      else if (auto and_filter = dynamic_cast<and_tree_filter_t*>(filter))
+      {
+         compile_combine(*and_filter, false, depth, named_in_progress);
+      }
+      else
+      {
+         // Filters with state or looking at other nodes.
+         add(op_t::call).filter = filter;
+      }
+   }
+
+   void compiled_tree_filter_t::compile_combine(const combine_tree_filter_t& combine, bool is_or, size_t depth, vector<const tree_filter_t*>& named_in_progress)
+   {
+      // Each nesting depth of combining filters has its own accumulator.
+      if (_accumulators.size() <= depth)
+         _accumulators.resize(depth + 1);
+
+      // Gather the texts and regexes of the sub-filters that can be searched together.
+      vector<wstring> texts;
+      vector<const tree_filter_t*> text_filters;
+      vector<wstring> regexes;
+      vector<const tree_filter_t*> regex_filters;
+      for (const auto& filter : combine.filters)
+      {
+         wstring text;
+         bool is_regex = false;
+         const tree_filter_t* text_filter = find_text_filter(filter.get(), text, is_regex);
+         if (!text_filter || _fused_filters.count(text_filter) || _fused_regex_filters.count(text_filter))
+            continue;
+         if (find(text_filters.begin(), text_filters.end(), text_filter) != text_filters.end())
+            continue;
+         if (find(regex_filters.begin(), regex_filters.end(), text_filter) != regex_filters.end())
+            continue;
+
+         if (is_regex)
+         {
+            regex_filters.emplace_back(text_filter);
+            regexes.emplace_back(move(text));
+         }
+         else
+         {
+            text_filters.emplace_back(text_filter);
+            texts.emplace_back(move(text));
+         }
+      }
+
+      // Leaves read from the cache are searched together by the cache
+      // when their matches are not cached yet. See leaf_match_cache_t.
+      if (_cache)
+      {
+         texts.clear();
+         regexes.clear();
+      }
+
+      if (texts.size() >= min_fused_texts)
+      {
+         const uint32_t group = uint32_t(_fused_groups.size());
+         _fused_groups.emplace_back().searcher = multi_substring_searcher_t(texts);
+         for (size_t index = 0; index < text_filters.size(); ++index)
+            _fused_filters[text_filters[index]] = make_pair(group, uint32_t(index));
+      }
+
+      if (regexes.size() >= min_fused_regexes)
+      {
+         // Invalid regexes match nothing in their own filter, so they are not fused.
+         try
+         {
+            linear_regex_set_t regex_set(regexes);
+            const uint32_t group = uint32_t(_fused_regex_groups.size());
+            _fused_regex_groups.emplace_back().regexes = move(regex_set);
+            for (size_t index = 0; index < regex_filters.size(); ++index)
+               _fused_regex_filters[regex_filters[index]] = make_pair(group, uint32_t(index));
+         }
+         catch (const regex_error&)
+         {
+         }
+      }
+
+      add(is_or ? op_t::begin_any : op_t::begin_all).index = uint32_t(depth);
+
+      const auto order = _orders.find(&combine);
+
+      vector<size_t> steps;
+      for (size_t position = 0; position < combine.filters.size(); ++position)
+      {
+         const auto& filter = combine.filters[order != _orders.end() ? order->second[position] : position];
+         if (!filter)
+            continue;
+
+         compile(filter.get(), depth + 1, named_in_progress);
+         steps.emplace_back(_program.size());
+         add(is_or ? op_t::any_step : op_t::all_step).index = uint32_t(depth);
+      }
+
+      const size_t end = _program.size();
+      add(op_t::end_combine).index = uint32_t(depth);
+
+      for (const size_t step : steps)
+         _program[step].target = uint32_t(end);
+   }
+
+   bool compiled_tree_filter_t::plan(const text_tree_t& tree)
+   {
+      auto previous_orders = move(_orders);
+      _orders.clear();
+
+      // Sample nodes spread over the whole tree.
+      vector<const node*> samples;
+      const size_t count = tree.size();
+      const size_t step = max<size_t>(1, count / planning_samples);
+      for (size_t index = 0; index < count && samples.size() < planning_samples; index += step)
+         samples.emplace_back(&tree.node(index));
+
+      if (!samples.empty())
+      {
+         vector<const tree_filter_t*> named_in_progress;
+         plan(_source, tree, samples, named_in_progress);
+      }
+
+      return _orders != previous_orders;
+   }
+
+   void compiled_tree_filter_t::plan(const tree_filter_t* filter, const text_tree_t& tree, const vector<const node*>& samples, vector<const tree_filter_t*>& named_in_progress)
+   {
+      // Only go through the filters that are compiled, the others are called as-is.
+      if (auto named = dynamic_cast<const named_tree_filter_t*>(filter))
+      {
+         if (find(named_in_progress.begin(), named_in_progress.end(), named) != named_in_progress.end())
+            return;
+
+         named_in_progress.emplace_back(named);
+         plan(named->filter.get(), tree, samples, named_in_progress);
+         named_in_progress.pop_back();
+         return;
+      }
+
+      if (dynamic_cast<const not_tree_filter_t*>(filter)
+       || dynamic_cast<const stop_when_kept_tree_filter_t*>(filter)
+       || dynamic_cast<const until_tree_filter_t*>(filter)
+       || dynamic_cast<const remove_children_tree_filter_t*>(filter))
+      {
+         plan(static_cast<const delegate_tree_filter_t*>(filter)->sub_filter.get(), tree, samples, named_in_progress);
+         return;
+      }
+
+      auto combine = dynamic_cast<const combine_tree_filter_t*>(filter);
+      if (!combine)
+         return;
+
+      for (const auto& child : combine->filters)
+         plan(child.get(), tree, samples, named_in_progress);
+
+      const size_t child_count = combine->filters.size();
+      if (child_count < 2)
+         return;
+
+      for (const auto& child : combine->filters)
+         if (!is_reorderable(child.get(), named_in_progress))
+            return;
+
+      // An or is decided as soon as a sub-filter keeps the node, an and as soon
+      // as one drops it. Evaluating first the sub-filters with the lowest cost
+      // per decision minimizes the expected cost.
+      const bool is_or = dynamic_cast<const or_tree_filter_t*>(filter) != nullptr;
+      vector<double> cost_per_decision(child_count, 0.);
+      for (size_t index = 0; index < child_count; ++index)
+      {
+         tree_filter_t* child = combine->filters[index].get();
+         if (!child)
+            continue;
+
+         size_t kept = 0;
+         for (const node* sample : samples)
+            if (child->is_kept(tree, *sample, sample->depth).keep)
+               ++kept;
+
+         const size_t decided = is_or ? kept : samples.size() - kept;
+         const double decision_rate = max<double>(double(decided), 0.5) / double(samples.size());
+         cost_per_decision[index] = estimate_cost(child, _cache, named_in_progress) / decision_rate;
+      }
+
+      vector<size_t> order(child_count);
+      for (size_t index = 0; index < child_count; ++index)
+         order[index] = index;
+      stable_sort(order.begin(), order.end(), [&cost_per_decision](size_t lhs, size_t rhs)
+      {
+         return cost_per_decision[lhs] < cost_per_decision[rhs];
+      });
+
+      if (!is_sorted(order.begin(), order.end()))
+         _orders[combine] = move(order);
+   }
+
+   result compiled_tree_filter_t::is_kept(const text_tree_t& tree, const node& a_node, size_t level)
+   {
+      if (_pruner.can_skip(tree, a_node))
+         return drop_and_skip;
+
+      result current = keep;
+
+      const instruction_t* const program = _program.data();
+      const size_t count = _program.size();
+      result* const accumulators = _accumulators.data();
+
+      for (size_t pc = 0; pc < count; ++pc)
+      {
+         const instruction_t& instruction = program[pc];
+         switch (instruction.op)
+         {
+            case op_t::accept:
+               current = keep;
+               break;
+            case op_t::stop:
+               current = instruction.flag ? stop_and_keep : stop_and_drop;
+               break;
+            case op_t::contains:
+               current = instruction.searcher->is_in(a_node.text()) ? keep : drop;
+               break;
+            case op_t::fused_contains:
+            {
+               fused_group_t& group = _fused_groups[instruction.index];
+               if (group.searched_node != &a_node || group.searched_index != a_node.index)
+               {
+                  group.searcher.find_all(a_node.text(), group.found);
+                  group.searched_node = &a_node;
+                  group.searched_index = a_node.index;
+               }
+               current = group.found[instruction.pattern] ? keep : drop;
+               break;
+            }
+            case op_t::fused_regex:
+            {
+               fused_regex_group_t& group = _fused_regex_groups[instruction.index];
+               if (group.searched_node != &a_node || group.searched_index != a_node.index)
+               {
+                  group.regexes.find_all(a_node.text(), group.found);
+                  group.searched_node = &a_node;
+                  group.searched_index = a_node.index;
+               }
+               current = group.found[instruction.pattern] ? keep : drop;
+               break;
+            }
+            case op_t::regex:
+               current = instruction.regex->search(a_node.text()) ? keep : drop;
+               break;
+            case op_t::cached_match:
+               current = leaf_match_cache_t::is_in(*instruction.matches, a_node.index) ? keep : drop;
+               break;
+            case op_t::text_address:
+               current = (instruction.address == a_node.text_ptr) ? keep : drop;
+               break;
+            case op_t::level_range:
+               current = (level < instruction.min_level) ? drop : (level <= instruction.max_level) ? keep : drop_and_skip;
+               break;
+            case op_t::call:
+               current = instruction.filter->is_kept(tree, a_node, level);
+               break;
+            case op_t::invert:
+               current.keep = !current.keep;
+               break;
+            case op_t::stop_when_kept:
+               if (current.keep)
+                  current = current | stop_and_keep;
+               break;
+            case op_t::until:
+               current = current.keep ? stop_and_drop : drop;
+               break;
+            case op_t::remove_children:
+               current = !current.keep ? keep : instruction.flag ? drop_and_skip : keep_and_skip;
+               break;
+            case op_t::begin_any:
+               accumulators[instruction.index] = drop;
+               break;
+            case op_t::any_step:
+               accumulators[instruction.index] = accumulators[instruction.index] | current;
+               if (accumulators[instruction.index].keep)
+                  pc = instruction.target - 1;
+               break;
+            case op_t::begin_all:
+               accumulators[instruction.index] = keep;
+               break;
+            case op_t::all_step:
+               accumulators[instruction.index] = accumulators[instruction.index] & current;
+               if (!accumulators[instruction.index].keep)
+                  pc = instruction.target - 1;
+               break;
+            case op_t::end_combine:
+               current = accumulators[instruction.index];
+               break;
+         }
+      }
+
+      return current;
+   }
+
+   void compiled_tree_filter_t::begin_filtering(const text_tree_t& tree)
+   {
+      for (auto& group : _fused_groups)
+         group.searched_node = nullptr;
+      for (auto& group : _fused_regex_groups)
+         group.searched_node = nullptr;
+
+      if (_source)
+         _source->begin_filtering(tree);
+
+      // The sub-filters are measured once ready to filter the tree.
+      if (plan(tree))
+         compile();
+
+      _pruner = _source ? subtree_pruner_t(*_source, tree) : subtree_pruner_t();
+
+      // The matches of all the leaves not yet cached are found together.
+      vector<tree_filter_t*> cached_filters;
+      for (const auto& instruction : _program)
+         if (instruction.op == op_t::cached_match)
+            cached_filters.emplace_back(instruction.filter);
+
+      _cached_matches.clear();
+      if (!cached_filters.empty())
+         _cached_matches = _cache->get_matches(tree, cached_filters);
+      for (size_t index = 0, cached = 0; index < _program.size(); ++index)
+         if (_program[index].op == op_t::cached_match)
+            _program[index].matches = _cached_matches[cached++].get();
+   }
+
+   wstring compiled_tree_filter_t::get_name() const
+   {
+      return _source ? _source->get_name() : wstring();
+   }
+
+   wstring compiled_tree_filter_t::get_short_name() const
+   {
+      return _source ? _source->get_short_name() : wstring();
+   }
+
+   wstring compiled_tree_filter_t::get_description() const
+   {
+      return _source ? _source->get_description() : wstring();
+   }
+
+   tree_filter_ptr_t compiled_tree_filter_t::clone() const
+   {
+      return make_shared<compiled_tree_filter_t>(_source ? _source->clone() : tree_filter_ptr_t(), _cache);
+   }
+}
@@ -3,6 +3,7 @@
 #include "dak/tree_reader/tree_filter_maker.h"
 #include "dak/utility/text.h"
 #include "dak/tree_reader/simple_tree_writer.h"
+#include "dak/tree_reader/text_tree_snapshot.h"
 
 #include <sstream>
 #include <fstream>
@@ -40,10 +41,58 @@ namespace dak::tree_reader
 
    tree_commands_ptr_t global_commands_t::load_tree(const filesystem::path& filename)
    {
-      auto new_tree = make_shared<text_tree_t>(load_simple_text_tree(filename, options.read_options));
+      auto new_tree = make_shared<text_tree_t>();
+      if (!load_text_tree_snapshot(get_text_tree_snapshot_path(filename), filename, options.read_options, *new_tree))
+         *new_tree = load_simple_text_tree(filename, options.read_options);
+
+      return add_loaded_tree(new_tree, filename);
+   }
+
+   tree_commands_ptr_t global_commands_t::load_tree(const filesystem::path& filename, lazy_text_tree_ptr_t& lazy_tree)
+   {
+      lazy_tree.reset();
+
+      auto new_tree = make_shared<text_tree_t>();
+      if (!load_text_tree_snapshot(get_text_tree_snapshot_path(filename), filename, options.read_options, *new_tree))
+      {
+         if (!can_load_tree(filename))
+         {
+            lazy_tree = load_lazy_text_tree(filename, options.read_options);
+            return {};
+         }
+
+         *new_tree = load_simple_text_tree(filename, options.read_options);
+      }
+
+      return add_loaded_tree(new_tree, filename);
+   }
+
+   bool global_commands_t::can_load_tree(const filesystem::path& filename) const
+   {
+      error_code error;
+      const uintmax_t file_size = filesystem::file_size(filename, error);
+      if (error)
+         return true;
+
+      if (options.max_loaded_file_megabytes > 0 && file_size > uintmax_t(options.max_loaded_file_megabytes) << 20)
+         return false;
+
+      // note: a loaded tree takes about a wide character per byte of the file for
+      //       its text, plus its nodes, which is about two bytes per byte of the file
+      //       for lines of a few dozen characters.
+      const uint64_t available = get_available_memory();
+      if (available == 0)
+         return true;
+
+      return file_size < available / (sizeof(wchar_t) + 2);
+   }
+
+   tree_commands_ptr_t global_commands_t::add_loaded_tree(const text_tree_ptr_t& new_tree, const filesystem::path& filename)
+   {
       if (new_tree && new_tree->roots.size() > 0)
       {
          auto treeCmd = make_shared<tree_commands_t>(new_tree, filename, _known_filters, _undo_redo);
+         treeCmd->set_original_tree_read_options(options.read_options);
          _trees.emplace_back(treeCmd);
          return treeCmd;
       }
@@ -53,6 +102,16 @@ namespace dak::tree_reader
       }
    }
 
+   bool global_commands_t::save_tree_snapshot(const tree_commands_ptr_t& tree)
+   {
+      // The snapshot records the options the tree was read with, which may differ from the current ones.
+      if (!tree || !tree->get_original_tree() || !tree->get_original_tree_read_options())
+         return false;
+
+      const filesystem::path filename = tree->get_original_tree_filename();
+      return save_text_tree_snapshot(get_text_tree_snapshot_path(filename), *tree->get_original_tree(), filename, *tree->get_original_tree_read_options());
+   }
+
    /////////////////////////////////////////////////////////////////////////
    //
    // Named filters management.
@@ -101,7 +160,8 @@ namespace dak::tree_reader
       << L"output-indent: "   << quoted(options.output_line_indent) << L"\n"
       << L"input-filter: "    << quoted(options.read_options.input_filter) << L"\n"
       << L"input-indent: "    << quoted(options.read_options.input_indent) << L"\n"
-      << L"tab-size: "        << options.read_options.tab_size << L"\n";
+      << L"tab-size: "        << options.read_options.tab_size << L"\n"
+      << L"max-loaded-file-mb: " << options.max_loaded_file_megabytes << L"\n";
    }
 
    void global_commands_t::load_options(const filesystem::path& filename)
@@ -141,6 +201,11 @@ namespace dak::tree_reader
             stream >> options.read_options.tab_size;
 
          }
+         else if (item == L"max-loaded-file-mb:")
+         {
+            stream >> options.max_loaded_file_megabytes;
+
+         }
       }
    }
 
@@ -162,13 +227,38 @@ namespace dak::tree_reader
       if (!tree)
          return {};
 
-      auto new_ctx = make_shared<tree_commands_t>(tree->get_filtered_tree(), tree->get_filtered_tree_filename(), _known_filters, _undo_redo);
+      // note: the tree is always copied, so that the trees are not shared. The filtered tree
+      //       of a followed tree grows in place and the new tree may be filtered or indexed
+      //       by other threads. The copy has its own nodes, so it stays valid when the original
+      //       is removed or grows.
+      text_tree_ptr_t filtered = tree->get_filtered_tree();
+      if (filtered)
+         filtered = make_shared<text_tree_t>(*filtered);
+
+      auto new_ctx = make_shared<tree_commands_t>(filtered, tree->get_filtered_tree_filename(), _known_filters, _undo_redo);
 
       _trees.emplace_back(new_ctx);
 
       return new_ctx;
    }
 
+   bool global_commands_t::follow_tree(const tree_commands_ptr_t& tree)
+   {
+      if (!tree)
+         return false;
+
+      // The appended lines are read like the tree was loaded, so their depths match.
+      return tree->follow_tree_file(tree->get_original_tree_read_options().value_or(options.read_options));
+   }
+
+   size_t global_commands_t::update_followed_trees()
+   {
+      size_t added = 0;
+      for (auto& tree : _trees)
+         added += tree->update_followed_tree();
+      return added;
+   }
+
    void global_commands_t::clear_undo_stack()
    {
       _undo_redo->clear();
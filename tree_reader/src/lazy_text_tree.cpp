@@ -0,0 +1,169 @@
+#include "dak/tree_reader/lazy_text_tree.h"
+
+#include <algorithm>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+   using node_id = lazy_text_tree_t::node_id_t;
+   constexpr node_id no_node = lazy_text_tree_t::no_node;
+
+   node_id lazy_text_tree_t::first_child(node_id node) const
+   {
+      if (node == no_node)
+         return size() > 0 ? 0 : no_node;
+
+      const size_t child = size_t(node) + 1;
+      return child < size() && parents[child] == node ? node_id(child) : no_node;
+   }
+
+   vector<node_id> lazy_text_tree_t::get_children(node_id node) const
+   {
+      vector<node_id> children;
+      for (node_id child = first_child(node); child != no_node; child = next_siblings[child])
+         children.emplace_back(child);
+      return children;
+   }
+
+   void lazy_text_tree_t::decode_page(size_t page, text_line_batch_t& lines) const
+   {
+      lines.clear();
+      if (page >= page_offsets.size())
+         return;
+
+      const mapped_file_t& file = source_file->file;
+
+      mapped_text_holder_reader_t reader;
+      reader.holder = source_file;
+      reader.keep_read_text = false;
+      reader.tab_size = read_options.tab_size;
+      reader.pos_in_file = file.data() + page_offsets[page];
+      reader.file_end = file.data() + (page + 1 < page_offsets.size() ? page_offsets[page + 1] : file.size());
+
+      // note: the depths given by the reader are relative to the first line of the page,
+      //       the depths of the index are used instead.
+      size_t index = page * lines_per_page;
+      const size_t page_end = min(size(), index + lines_per_page);
+      read_simple_text_lines(reader, [this, &lines, &index, page_end](wstring_view text, size_t)
+      {
+         lines.add_line(text, depths[index]);
+         return ++index < page_end;
+      }, read_options);
+   }
+
+   wstring lazy_text_tree_t::text(node_id node) const
+   {
+      if (node >= size())
+         return wstring();
+
+      const size_t page = node / lines_per_page;
+
+      lock_guard lock(_cache_mutex);
+
+      auto pos = _cached_pages.find(page);
+      if (pos != _cached_pages.end())
+      {
+         _recent_pages.splice(_recent_pages.begin(), _recent_pages, pos->second.recent_pos);
+      }
+      else
+      {
+         // Reuse the memory of the least recently used page when the cache is full.
+         text_line_batch_t lines;
+         if (_cached_pages.size() >= max<size_t>(max_cached_pages, 1))
+         {
+            auto oldest = _cached_pages.find(_recent_pages.back());
+            lines = move(oldest->second.lines);
+            _cached_pages.erase(oldest);
+            _recent_pages.pop_back();
+         }
+
+         decode_page(page, lines);
+         _recent_pages.emplace_front(page);
+         pos = _cached_pages.emplace(page, cached_page_t{ move(lines), _recent_pages.begin() }).first;
+      }
+
+      const text_line_batch_t& lines = pos->second.lines;
+      const size_t index = node % lines_per_page;
+      if (index >= lines.size())
+         return wstring();
+
+      return wstring(lines.text(lines.lines[index]));
+   }
+
+   void lazy_text_tree_t::read_lines(const read_line_function_t& func) const
+   {
+      constexpr size_t read_ahead_pages = 4;
+
+      const mapped_file_t& file = source_file->file;
+      auto page_start = [this, &file](size_t page) { return page < page_offsets.size() ? size_t(page_offsets[page]) : file.size(); };
+
+      if (!page_offsets.empty())
+         file.will_need(page_offsets[0], page_start(read_ahead_pages) - page_offsets[0]);
+
+      text_line_batch_t lines;
+      for (size_t page = 0; page < page_offsets.size(); ++page)
+      {
+         // Keep the system reading the pages ahead of the one being decoded.
+         const size_t ahead = page + read_ahead_pages;
+         if (ahead < page_offsets.size())
+            file.will_need(page_start(ahead), page_start(ahead + 1) - page_start(ahead));
+
+         decode_page(page, lines);
+         for (const auto& line : lines.lines)
+            if (!func(lines.text(line), line.depth))
+               return;
+      }
+   }
+
+   lazy_text_tree_ptr_t load_lazy_text_tree(const filesystem::path& path, const load_simple_text_tree_options_t& options)
+   {
+      mapped_text_holder_reader_t reader;
+      reader.keep_read_text = false;
+      reader.tab_size = options.tab_size;
+      if (!reader.open(path))
+         return nullptr;
+
+      auto tree = make_shared<lazy_text_tree_t>();
+      const char* file_start = reader.holder->file.data();
+
+      // The node of each level of the current branch.
+      vector<node_id> branch;
+      bool too_many_lines = false;
+
+      read_simple_text_lines(reader, [&tree, &reader, file_start, &branch, &too_many_lines](wstring_view, size_t depth)
+      {
+         const size_t index = tree->size();
+         if (index >= no_node)
+         {
+            too_many_lines = true;
+            return false;
+         }
+
+         if (index % lazy_text_tree_t::lines_per_page == 0)
+            tree->page_offsets.emplace_back(reader.line_in_file - file_start);
+
+         // The node of the same level in the branch, if any, is the previous sibling.
+         uint32_t row = 0;
+         if (depth < branch.size())
+         {
+            tree->next_siblings[branch[depth]] = node_id(index);
+            row = tree->rows[branch[depth]] + 1;
+         }
+
+         branch.resize(depth);
+         tree->parents.emplace_back(depth > 0 ? branch.back() : no_node);
+         tree->depths.emplace_back(uint32_t(depth));
+         tree->next_siblings.emplace_back(no_node);
+         tree->rows.emplace_back(row);
+         branch.emplace_back(node_id(index));
+         return true;
+      }, options);
+
+      if (too_many_lines)
+         return nullptr;
+
+      tree->source_file = reader.holder;
+      tree->read_options = options;
+      return tree;
+   }
+}
@@ -0,0 +1,267 @@
+#include "dak/tree_reader/leaf_match_cache.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/multi_substring_searcher.h"
+#include "dak/tree_reader/linear_regex.h"
+
+#include <algorithm>
+#include <future>
+#include <regex>
+#include <thread>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+
+   namespace
+   {
+      // The kind and text identifying a leaf, empty if not cacheable.
+      wstring key_of(const tree_filter_t& filter)
+      {
+         if (auto contains = dynamic_cast<const contains_tree_filter_t*>(&filter))
+            return L"contains\n" + contains->contained;
+
+         if (auto regex = dynamic_cast<const regex_tree_filter_t*>(&filter))
+            return L"regex\n" + regex->regex_text;
+
+         return wstring();
+      }
+
+      // The text that all nodes kept by the leaf contain, empty if unknown.
+      wstring indexed_text_of(const tree_filter_t& filter)
+      {
+         if (auto contains = dynamic_cast<const contains_tree_filter_t*>(&filter))
+            return contains->contained;
+
+         if (auto regex = dynamic_cast<const regex_tree_filter_t*>(&filter))
+            return regex->regex.required_text();
+
+         return wstring();
+      }
+   }
+
+   bool leaf_match_cache_t::is_cacheable(const tree_filter_t& filter)
+   {
+      return !key_of(filter).empty();
+   }
+
+   shared_ptr<const leaf_match_cache_t::matches_t> leaf_match_cache_t::get_matches(const text_tree_t& tree, tree_filter_t& filter)
+   {
+      return get_matches(tree, vector<tree_filter_t*>(1, &filter)).front();
+   }
+
+   vector<shared_ptr<const leaf_match_cache_t::matches_t>> leaf_match_cache_t::get_matches(const text_tree_t& tree, const vector<tree_filter_t*>& filters)
+   {
+      vector<shared_ptr<const matches_t>> matches(filters.size());
+
+      lock_guard lock(_mutex);
+
+      if (_tree != &tree || _tree_size != tree.size())
+      {
+         _entries.clear();
+         _tree = &tree;
+         _tree_size = tree.size();
+      }
+
+      ++_use_count;
+
+      // Find the cached matches and the distinct leaves that are not cached.
+      vector<wstring> missing_keys;
+      vector<tree_filter_t*> missing_filters;
+      vector<size_t> missing_indexes(filters.size(), size_t(-1));
+      for (size_t index = 0; index < filters.size(); ++index)
+      {
+         const wstring key = key_of(*filters[index]);
+
+         auto pos = find_if(_entries.begin(), _entries.end(), [&key](const entry_t& entry) { return entry.key == key; });
+         if (pos != _entries.end())
+         {
+            pos->last_use = _use_count;
+            matches[index] = pos->matches;
+            continue;
+         }
+
+         auto missing = find(missing_keys.begin(), missing_keys.end(), key);
+         missing_indexes[index] = missing - missing_keys.begin();
+         if (missing == missing_keys.end())
+         {
+            missing_keys.emplace_back(key);
+            missing_filters.emplace_back(filters[index]);
+         }
+      }
+
+      if (missing_filters.empty())
+         return matches;
+
+      const auto evaluated = evaluate(tree, missing_filters);
+      for (size_t index = 0; index < filters.size(); ++index)
+         if (missing_indexes[index] != size_t(-1))
+            matches[index] = evaluated[missing_indexes[index]];
+
+      // Keep all the leaves of the filter, dropping the least recently used others.
+      _capacity = max(max_cached_leaves, filters.size());
+      for (size_t index = 0; index < missing_keys.size(); ++index)
+         _entries.push_back(entry_t{ missing_keys[index], evaluated[index], _use_count });
+
+      while (_entries.size() > _capacity)
+      {
+         auto oldest = min_element(_entries.begin(), _entries.end(), [](const entry_t& lhs, const entry_t& rhs) { return lhs.last_use < rhs.last_use; });
+         _entries.erase(oldest);
+      }
+
+      return matches;
+   }
+
+   vector<shared_ptr<leaf_match_cache_t::matches_t>> leaf_match_cache_t::evaluate(const text_tree_t& tree, const vector<tree_filter_t*>& filters) const
+   {
+      vector<shared_ptr<matches_t>> matches;
+      for (size_t index = 0; index < filters.size(); ++index)
+         matches.emplace_back(make_shared<matches_t>((tree.size() + 63) / 64, 0));
+
+      // The leaf filters must be prepared for the tree before being evaluated.
+      for (tree_filter_t* filter : filters)
+         filter->begin_filtering(tree);
+
+      // With the trigram index, each leaf is only evaluated on its few candidates.
+      // The others are searched together over all nodes: the contains filters with
+      // one multi-substring search and the regexes with one regex set.
+      vector<wstring> texts;
+      vector<size_t> text_leaves;
+      vector<wstring> regexes;
+      vector<size_t> regex_leaves;
+      vector<size_t> other_leaves;
+
+      vector<size_t> candidates;
+      for (size_t leaf = 0; leaf < filters.size(); ++leaf)
+      {
+         tree_filter_t& filter = *filters[leaf];
+         if (_index && _index->is_of(tree) && _index->find_candidates(indexed_text_of(filter), candidates))
+         {
+            for (const size_t index : candidates)
+            {
+               const auto& node = tree.node(index);
+               if (filter.is_kept(tree, node, node.depth).keep)
+                  (*matches[leaf])[index / 64] |= uint64_t(1) << (index % 64);
+            }
+         }
+         else if (auto contains = dynamic_cast<const contains_tree_filter_t*>(&filter))
+         {
+            texts.emplace_back(contains->contained);
+            text_leaves.emplace_back(leaf);
+         }
+         else if (auto regex = dynamic_cast<const regex_tree_filter_t*>(&filter))
+         {
+            regexes.emplace_back(regex->regex_text);
+            regex_leaves.emplace_back(leaf);
+         }
+         else
+         {
+            other_leaves.emplace_back(leaf);
+         }
+      }
+
+      // A single text or regex is searched by its own filter.
+      if (text_leaves.size() < 2)
+      {
+         other_leaves.insert(other_leaves.end(), text_leaves.begin(), text_leaves.end());
+         text_leaves.clear();
+         texts.clear();
+      }
+
+      if (regex_leaves.size() < 2)
+      {
+         other_leaves.insert(other_leaves.end(), regex_leaves.begin(), regex_leaves.end());
+         regex_leaves.clear();
+         regexes.clear();
+      }
+
+      const multi_substring_searcher_t searcher(texts);
+
+      // Invalid regexes match nothing in their own filter, so they are evaluated alone.
+      linear_regex_set_t regex_set;
+      try
+      {
+         regex_set = linear_regex_set_t(regexes);
+      }
+      catch (const regex_error&)
+      {
+         other_leaves.insert(other_leaves.end(), regex_leaves.begin(), regex_leaves.end());
+         regex_leaves.clear();
+         regexes.clear();
+      }
+
+      if (text_leaves.empty() && regex_leaves.empty() && other_leaves.empty())
+         return matches;
+
+      // Each thread scans a range of nodes, covering whole words of the bitmaps.
+      auto scan = [&](size_t begin, size_t end)
+      {
+         linear_regex_set_t thread_regex_set = regex_set;
+         vector<tree_filter_ptr_t> thread_filters;
+         for (const size_t leaf : other_leaves)
+         {
+            thread_filters.emplace_back(filters[leaf]->clone());
+            thread_filters.back()->begin_filtering(tree);
+         }
+
+         vector<bool> found;
+         for (size_t index = begin; index < end; ++index)
+         {
+            const auto& node = tree.node(index);
+            const uint64_t bit = uint64_t(1) << (index % 64);
+
+            if (!text_leaves.empty())
+            {
+               searcher.find_all(node.text(), found);
+               for (size_t pattern = 0; pattern < text_leaves.size(); ++pattern)
+                  if (found[pattern])
+                     (*matches[text_leaves[pattern]])[index / 64] |= bit;
+            }
+
+            if (!regex_leaves.empty())
+            {
+               thread_regex_set.find_all(node.text(), found);
+               for (size_t pattern = 0; pattern < regex_leaves.size(); ++pattern)
+                  if (found[pattern])
+                     (*matches[regex_leaves[pattern]])[index / 64] |= bit;
+            }
+
+            for (size_t other = 0; other < other_leaves.size(); ++other)
+               if (thread_filters[other]->is_kept(tree, node, node.depth).keep)
+                  (*matches[other_leaves[other]])[index / 64] |= bit;
+         }
+      };
+
+      const size_t count = tree.size();
+      const size_t thread_count = (count >= min_parallel_nodes) ? max<size_t>(1, thread::hardware_concurrency()) : 1;
+      const size_t range = ((count + thread_count - 1) / thread_count + 63) / 64 * 64;
+
+      vector<future<void>> threads;
+      for (size_t begin = range; begin < count; begin += range)
+         threads.emplace_back(async(launch::async, scan, begin, min(count, begin + range)));
+      scan(0, min(count, range));
+      for (auto& thread : threads)
+         thread.get();
+
+      return matches;
+   }
+
+   void leaf_match_cache_t::set_index(text_trigram_index_ptr_t index)
+   {
+      lock_guard lock(_mutex);
+      _index = move(index);
+   }
+
+   size_t leaf_match_cache_t::size() const
+   {
+      lock_guard lock(_mutex);
+      return _entries.size();
+   }
+
+   void leaf_match_cache_t::clear()
+   {
+      lock_guard lock(_mutex);
+      _entries.clear();
+      _tree = nullptr;
+      _tree_size = 0;
+   }
+}
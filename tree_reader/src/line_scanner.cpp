@@ -0,0 +1,273 @@
+#include "dak/tree_reader/line_scanner.h"
+
+#include <bit>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+   #define DAK_TREE_READER_X86
+   #include <immintrin.h>
+   #ifdef _MSC_VER
+      #include <intrin.h>
+      #define DAK_SSE2_FUNCTION
+      #define DAK_AVX2_FUNCTION
+   #else
+      #define DAK_SSE2_FUNCTION __attribute__((target("sse2")))
+      #define DAK_AVX2_FUNCTION __attribute__((target("avx2")))
+   #endif
+#endif
+
+namespace dak::tree_reader
+{
+   using namespace std;
+
+   void scanned_lines_t::clear()
+   {
+      offsets.clear();
+      lengths.clear();
+      indents.clear();
+      text_indexes.clear();
+      scanned_end = 0;
+   }
+
+   namespace
+   {
+      template <class CHAR>
+      bool is_line_end(CHAR c)
+      {
+         return c == CHAR('\n') || c == CHAR('\r');
+      }
+
+      template <class CHAR>
+      bool is_indentation(CHAR c)
+      {
+         return c == CHAR(' ') || c == CHAR('\t');
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // Scalar kernels, also used for the tail of the vectorized kernels.
+
+      struct scalar_kernel_t
+      {
+         template <class CHAR>
+         static const CHAR* find_line_end(const CHAR* pos, const CHAR* end)
+         {
+            while (pos < end && !is_line_end(*pos))
+               ++pos;
+            return pos;
+         }
+
+         template <class CHAR>
+         static const CHAR* skip_indentation(const CHAR* pos, const CHAR* end, size_t& tab_count)
+         {
+            while (pos < end && is_indentation(*pos))
+            {
+               if (*pos == CHAR('\t'))
+                  ++tab_count;
+               ++pos;
+            }
+            return pos;
+         }
+      };
+
+   #ifdef DAK_TREE_READER_X86
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // SSE2 kernels, processing 16 bytes at a time.
+      //
+      // Comparison masks have one bit per byte, so bit counts are divided
+      // by the size of the characters.
+
+      struct sse2_kernel_t
+      {
+         template <class CHAR>
+         DAK_SSE2_FUNCTION static __m128i equal(__m128i block, CHAR c)
+         {
+            if constexpr (sizeof(CHAR) == 1)
+               return _mm_cmpeq_epi8(block, _mm_set1_epi8(char(c)));
+            else if constexpr (sizeof(CHAR) == 2)
+               return _mm_cmpeq_epi16(block, _mm_set1_epi16(short(c)));
+            else
+               return _mm_cmpeq_epi32(block, _mm_set1_epi32(int(c)));
+         }
+
+         template <class CHAR>
+         DAK_SSE2_FUNCTION static const CHAR* find_line_end(const CHAR* pos, const CHAR* end)
+         {
+            constexpr size_t block_count = 16 / sizeof(CHAR);
+            while (size_t(end - pos) >= block_count)
+            {
+               const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+               const uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_or_si128(equal(block, CHAR('\n')), equal(block, CHAR('\r')))));
+               if (mask)
+                  return pos + countr_zero(mask) / sizeof(CHAR);
+               pos += block_count;
+            }
+            return scalar_kernel_t::find_line_end(pos, end);
+         }
+
+         template <class CHAR>
+         DAK_SSE2_FUNCTION static const CHAR* skip_indentation(const CHAR* pos, const CHAR* end, size_t& tab_count)
+         {
+            constexpr size_t block_count = 16 / sizeof(CHAR);
+            while (size_t(end - pos) >= block_count)
+            {
+               const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+               const __m128i tabs = equal(block, CHAR('\t'));
+               const uint32_t tab_mask = uint32_t(_mm_movemask_epi8(tabs));
+               const uint32_t indent_mask = uint32_t(_mm_movemask_epi8(_mm_or_si128(tabs, equal(block, CHAR(' ')))));
+               if (indent_mask != 0xFFFFu)
+               {
+                  const int indent_bytes = countr_one(indent_mask);
+                  tab_count += popcount(tab_mask & ((1u << indent_bytes) - 1)) / sizeof(CHAR);
+                  return pos + indent_bytes / sizeof(CHAR);
+               }
+               tab_count += popcount(tab_mask) / sizeof(CHAR);
+               pos += block_count;
+            }
+            return scalar_kernel_t::skip_indentation(pos, end, tab_count);
+         }
+      };
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // AVX2 kernels, processing 32 bytes at a time.
+
+      struct avx2_kernel_t
+      {
+         template <class CHAR>
+         DAK_AVX2_FUNCTION static __m256i equal(__m256i block, CHAR c)
+         {
+            if constexpr (sizeof(CHAR) == 1)
+               return _mm256_cmpeq_epi8(block, _mm256_set1_epi8(char(c)));
+            else if constexpr (sizeof(CHAR) == 2)
+               return _mm256_cmpeq_epi16(block, _mm256_set1_epi16(short(c)));
+            else
+               return _mm256_cmpeq_epi32(block, _mm256_set1_epi32(int(c)));
+         }
+
+         template <class CHAR>
+         DAK_AVX2_FUNCTION static const CHAR* find_line_end(const CHAR* pos, const CHAR* end)
+         {
+            constexpr size_t block_count = 32 / sizeof(CHAR);
+            while (size_t(end - pos) >= block_count)
+            {
+               const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+               const uint32_t mask = uint32_t(_mm256_movemask_epi8(_mm256_or_si256(equal(block, CHAR('\n')), equal(block, CHAR('\r')))));
+               if (mask)
+                  return pos + countr_zero(mask) / sizeof(CHAR);
+               pos += block_count;
+            }
+            return sse2_kernel_t::find_line_end(pos, end);
+         }
+
+         template <class CHAR>
+         DAK_AVX2_FUNCTION static const CHAR* skip_indentation(const CHAR* pos, const CHAR* end, size_t& tab_count)
+         {
+            constexpr size_t block_count = 32 / sizeof(CHAR);
+            while (size_t(end - pos) >= block_count)
+            {
+               const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos));
+               const __m256i tabs = equal(block, CHAR('\t'));
+               const uint32_t tab_mask = uint32_t(_mm256_movemask_epi8(tabs));
+               const uint32_t indent_mask = uint32_t(_mm256_movemask_epi8(_mm256_or_si256(tabs, equal(block, CHAR(' ')))));
+               if (indent_mask != 0xFFFFFFFFu)
+               {
+                  const int indent_bytes = countr_one(indent_mask);
+                  tab_count += popcount(tab_mask & ((1u << indent_bytes) - 1)) / sizeof(CHAR);
+                  return pos + indent_bytes / sizeof(CHAR);
+               }
+               tab_count += popcount(tab_mask) / sizeof(CHAR);
+               pos += block_count;
+            }
+            return sse2_kernel_t::skip_indentation(pos, end, tab_count);
+         }
+      };
+
+      bool has_avx2()
+      {
+      #ifdef _MSC_VER
+         int info[4];
+         __cpuid(info, 0);
+         if (info[0] < 7)
+            return false;
+
+         // note: the OS must also save the AVX registers.
+         __cpuid(info, 1);
+         const bool has_os_xsave = (info[2] & (1 << 27)) != 0;
+         if (!has_os_xsave || (_xgetbv(0) & 6) != 6)
+            return false;
+
+         __cpuidex(info, 7, 0);
+         return (info[1] & (1 << 5)) != 0;
+      #else
+         return __builtin_cpu_supports("avx2");
+      #endif
+      }
+
+      const bool use_avx2 = has_avx2();
+
+   #endif
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // Scan all lines of the buffer with the given kernels.
+
+      template <class KERNEL, class CHAR>
+      void scan_lines_with(const CHAR* buffer, size_t size, bool at_end, size_t tab_size, scanned_lines_t& lines)
+      {
+         lines.clear();
+
+         const CHAR* pos = buffer;
+         const CHAR* end = buffer + size;
+         while (pos < end)
+         {
+            if (is_line_end(*pos))
+            {
+               ++pos;
+               lines.scanned_end = pos - buffer;
+               continue;
+            }
+
+            size_t tab_count = 0;
+            const CHAR* text = KERNEL::skip_indentation(pos, end, tab_count);
+            const CHAR* line_end = KERNEL::find_line_end(text, end);
+            if (line_end >= end && !at_end)
+               break;
+
+            const size_t text_index = text - pos;
+            lines.offsets.emplace_back(pos - buffer);
+            lines.lengths.emplace_back(line_end - pos);
+            lines.text_indexes.emplace_back(text_index);
+            lines.indents.emplace_back(text_index + tab_count * (tab_size - 1));
+
+            pos = line_end;
+            lines.scanned_end = pos - buffer;
+         }
+      }
+
+      template <class CHAR>
+      void scan_lines_dispatch(const CHAR* buffer, size_t size, bool at_end, size_t tab_size, scanned_lines_t& lines)
+      {
+      #ifdef DAK_TREE_READER_X86
+         if (use_avx2)
+            return scan_lines_with<avx2_kernel_t>(buffer, size, at_end, tab_size, lines);
+         else
+            return scan_lines_with<sse2_kernel_t>(buffer, size, at_end, tab_size, lines);
+      #else
+         return scan_lines_with<scalar_kernel_t>(buffer, size, at_end, tab_size, lines);
+      #endif
+      }
+   }
+
+   void scan_lines(const char* buffer, size_t size, bool at_end, size_t tab_size, scanned_lines_t& lines)
+   {
+      scan_lines_dispatch(buffer, size, at_end, tab_size, lines);
+   }
+
+   void scan_lines(const wchar_t* buffer, size_t size, bool at_end, size_t tab_size, scanned_lines_t& lines)
+   {
+      scan_lines_dispatch(buffer, size, at_end, tab_size, lines);
+   }
+}
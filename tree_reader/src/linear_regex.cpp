@@ -0,0 +1,1376 @@
+#include "dak/tree_reader/linear_regex.h"
+#include "dak/tree_reader/substring_searcher.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <regex>
+#include <type_traits>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+
+   namespace
+   {
+      // Limits protecting against patterns that would take too much memory.
+      constexpr size_t max_nesting = 256;
+      constexpr size_t max_instructions = 100000;
+      constexpr uint32_t max_repeat = 1000;
+      constexpr size_t max_dfa_states = 4096;
+
+      constexpr uint32_t infinite_repeat = UINT32_MAX;
+      constexpr uint32_t unknown_state = UINT32_MAX;
+
+      typedef vector<pair<uint32_t, uint32_t>> ranges_t;
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // The automaton instructions.
+      //
+      // The character and set instructions consume a character, the others do not.
+      // Split continues at both targets, preferring the first.
+
+      enum class op_t : uint8_t
+      {
+         character,           // x: the character.
+         set,                 // x: the index of the set of characters.
+         split,               // x: the preferred target, y: the other target.
+         jump,                // x: the target.
+         assert_begin,
+         assert_end,
+         word_boundary,
+         not_word_boundary,
+         match,               // x: the index of the pattern.
+      };
+
+      struct instruction_t
+      {
+         op_t op = op_t::match;
+         uint32_t x = 0;
+         uint32_t y = 0;
+      };
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // Sets of characters, as sorted non-overlapping ranges.
+
+      void normalize(ranges_t& ranges, uint32_t max_char)
+      {
+         sort(ranges.begin(), ranges.end());
+
+         ranges_t merged;
+         for (auto [low, high] : ranges)
+         {
+            if (low > max_char)
+               continue;
+            high = min(high, max_char);
+            if (!merged.empty() && low <= merged.back().second + 1)
+               merged.back().second = max(merged.back().second, high);
+            else
+               merged.emplace_back(low, high);
+         }
+
+         ranges = move(merged);
+      }
+
+      ranges_t complement(const ranges_t& ranges, uint32_t max_char)
+      {
+         ranges_t result;
+         uint32_t next = 0;
+         for (const auto& [low, high] : ranges)
+         {
+            if (low > next)
+               result.emplace_back(next, low - 1);
+            next = high + 1;
+         }
+         if (next <= max_char && (ranges.empty() || ranges.back().second < max_char))
+            result.emplace_back(next, max_char);
+         return result;
+      }
+
+      ranges_t digit_ranges() { return { { '0', '9' } }; }
+      ranges_t word_ranges()  { return { { '0', '9' }, { 'A', 'Z' }, { '_', '_' }, { 'a', 'z' } }; }
+      ranges_t space_ranges() { return { { '\t', '\r' }, { ' ', ' ' } }; }
+
+      // The ranges of a character class named in a bracket expression, like [:alpha:],
+      // for ASCII characters. Returns false if the class is unknown.
+      bool add_named_class(const vector<uint32_t>& name_chars, ranges_t& ranges)
+      {
+         const string name(name_chars.begin(), name_chars.end());
+         ranges_t added;
+         if (name == "alnum")       added = { { '0', '9' }, { 'A', 'Z' }, { 'a', 'z' } };
+         else if (name == "alpha")  added = { { 'A', 'Z' }, { 'a', 'z' } };
+         else if (name == "blank")  added = { { '\t', '\t' }, { ' ', ' ' } };
+         else if (name == "cntrl")  added = { { 0, 0x1F }, { 0x7F, 0x7F } };
+         else if (name == "digit" || name == "d") added = digit_ranges();
+         else if (name == "graph")  added = { { 0x21, 0x7E } };
+         else if (name == "lower")  added = { { 'a', 'z' } };
+         else if (name == "print")  added = { { 0x20, 0x7E } };
+         else if (name == "punct")  added = { { 0x21, 0x2F }, { 0x3A, 0x40 }, { 0x5B, 0x60 }, { 0x7B, 0x7E } };
+         else if (name == "space" || name == "s") added = space_ranges();
+         else if (name == "upper")  added = { { 'A', 'Z' } };
+         else if (name == "xdigit") added = { { '0', '9' }, { 'A', 'F' }, { 'a', 'f' } };
+         else if (name == "w")      added = word_ranges();
+         else return false;
+
+         ranges.insert(ranges.end(), added.begin(), added.end());
+         return true;
+      }
+
+      bool is_word(uint32_t c)
+      {
+         return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || c == '_' || (c >= 'a' && c <= 'z');
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // The parsed pattern.
+
+      struct ast_node_t
+      {
+         enum class kind_t : uint8_t { empty, character, set, assertion, concat, alternate, repeat };
+
+         kind_t kind = kind_t::empty;
+         uint32_t value = 0;     // The character, set index or assertion instruction.
+         uint32_t min = 0;       // The repeat counts.
+         uint32_t max = 0;
+         bool greedy = true;
+         vector<uint32_t> children;
+      };
+
+      using kind_t = ast_node_t::kind_t;
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // Parse a pattern using the ECMAScript syntax.
+      //
+      // The parser recurses on groups, up to the maximum nesting.
+
+      struct regex_parser_t
+      {
+         regex_parser_t(const vector<uint32_t>& pattern, uint32_t max_char, vector<ranges_t>& sets)
+         : _pattern(pattern), _max_char(max_char), _sets(sets)
+         {
+         }
+
+         uint32_t parse()
+         {
+            const uint32_t root = parse_alternate(0);
+            if (!at_end())
+               throw regex_error(regex_constants::error_paren);
+            return root;
+         }
+
+         vector<ast_node_t> nodes;
+
+      private:
+         bool at_end() const { return _pos >= _pattern.size(); }
+         uint32_t peek() const { return _pattern[_pos]; }
+
+         uint32_t add_node(kind_t kind, uint32_t value = 0)
+         {
+            ast_node_t& node = nodes.emplace_back();
+            node.kind = kind;
+            node.value = value;
+            return uint32_t(nodes.size() - 1);
+         }
+
+         uint32_t add_set(ranges_t ranges)
+         {
+            normalize(ranges, _max_char);
+            _sets.emplace_back(move(ranges));
+            return add_node(kind_t::set, uint32_t(_sets.size() - 1));
+         }
+
+         uint32_t parse_alternate(size_t depth)
+         {
+            if (depth > max_nesting)
+               throw regex_error(regex_constants::error_complexity);
+
+            vector<uint32_t> choices(1, parse_concat(depth));
+            while (!at_end() && peek() == '|')
+            {
+               ++_pos;
+               choices.emplace_back(parse_concat(depth));
+            }
+
+            if (choices.size() == 1)
+               return choices[0];
+
+            const uint32_t node = add_node(kind_t::alternate);
+            nodes[node].children = move(choices);
+            return node;
+         }
+
+         uint32_t parse_concat(size_t depth)
+         {
+            vector<uint32_t> items;
+            while (!at_end() && peek() != '|' && peek() != ')')
+               items.emplace_back(parse_repeat(depth));
+
+            if (items.size() == 1)
+               return items[0];
+
+            const uint32_t node = add_node(kind_t::concat);
+            nodes[node].children = move(items);
+            return node;
+         }
+
+         uint32_t parse_repeat(size_t depth)
+         {
+            const uint32_t atom = parse_atom(depth);
+
+            uint32_t min = 0, max = 0;
+            if (!parse_quantifier(min, max))
+               return atom;
+
+            if (nodes[atom].kind == kind_t::assertion)
+               throw regex_error(regex_constants::error_badrepeat);
+
+            bool greedy = true;
+            if (!at_end() && peek() == '?')
+            {
+               greedy = false;
+               ++_pos;
+            }
+
+            const uint32_t node = add_node(kind_t::repeat);
+            nodes[node].min = min;
+            nodes[node].max = max;
+            nodes[node].greedy = greedy;
+            nodes[node].children.emplace_back(atom);
+
+            if (!at_end() && (peek() == '*' || peek() == '+' || peek() == '?' || peek() == '{'))
+               throw regex_error(regex_constants::error_badrepeat);
+
+            return node;
+         }
+
+         bool parse_number(uint32_t& number)
+         {
+            const size_t start = _pos;
+            number = 0;
+            while (!at_end() && peek() >= '0' && peek() <= '9')
+            {
+               number = min(number * 10 + (peek() - '0'), max_repeat + 1);
+               ++_pos;
+            }
+            return _pos > start;
+         }
+
+         bool parse_quantifier(uint32_t& min, uint32_t& max)
+         {
+            if (at_end())
+               return false;
+
+            switch (peek())
+            {
+               case '*': ++_pos; min = 0; max = infinite_repeat; return true;
+               case '+': ++_pos; min = 1; max = infinite_repeat; return true;
+               case '?': ++_pos; min = 0; max = 1;               return true;
+               case '{': break;
+               default:  return false;
+            }
+
+            ++_pos;
+            if (!parse_number(min))
+               throw regex_error(regex_constants::error_badbrace);
+
+            max = min;
+            if (!at_end() && peek() == ',')
+            {
+               ++_pos;
+               if (!parse_number(max))
+                  max = infinite_repeat;
+            }
+
+            if (at_end() || peek() != '}')
+               throw regex_error(regex_constants::error_brace);
+            ++_pos;
+
+            if (max < min)
+               throw regex_error(regex_constants::error_badbrace);
+            if (min > max_repeat || (max != infinite_repeat && max > max_repeat))
+               throw regex_error(regex_constants::error_complexity);
+
+            return true;
+         }
+
+         uint32_t parse_atom(size_t depth)
+         {
+            const uint32_t c = _pattern[_pos++];
+            switch (c)
+            {
+               case '(':
+               {
+                  // Only capturing and non-capturing groups are supported, not lookaheads.
+                  if (!at_end() && peek() == '?')
+                  {
+                     if (_pos + 1 < _pattern.size() && _pattern[_pos + 1] == ':')
+                        _pos += 2;
+                     else
+                        throw regex_error(regex_constants::error_paren);
+                  }
+
+                  const uint32_t node = parse_alternate(depth + 1);
+                  if (at_end() || peek() != ')')
+                     throw regex_error(regex_constants::error_paren);
+                  ++_pos;
+                  return node;
+               }
+               case '[':
+                  return parse_class();
+               case '.':
+               {
+                  ranges_t ranges = complement({ { '\n', '\n' }, { '\r', '\r' }, { 0x2028, 0x2029 } }, _max_char);
+                  return add_set(move(ranges));
+               }
+               case '^':
+                  return add_node(kind_t::assertion, uint32_t(op_t::assert_begin));
+               case '$':
+                  return add_node(kind_t::assertion, uint32_t(op_t::assert_end));
+               case '\\':
+                  return parse_escape();
+               case '*':
+               case '+':
+               case '?':
+                  throw regex_error(regex_constants::error_badrepeat);
+               case '{':
+                  throw regex_error(regex_constants::error_badbrace);
+               default:
+                  return add_node(kind_t::character, c);
+            }
+         }
+
+         // Add the ranges of a class escape, returns false if not a class escape.
+         bool add_class_escape(uint32_t c, ranges_t& ranges)
+         {
+            ranges_t added;
+            switch (c)
+            {
+               case 'd': case 'D': added = digit_ranges(); break;
+               case 'w': case 'W': added = word_ranges(); break;
+               case 's': case 'S': added = space_ranges(); break;
+               default: return false;
+            }
+
+            if (c == 'D' || c == 'W' || c == 'S')
+               added = complement(added, _max_char);
+
+            ranges.insert(ranges.end(), added.begin(), added.end());
+            return true;
+         }
+
+         uint32_t parse_hex(size_t count)
+         {
+            uint32_t value = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+               if (at_end())
+                  throw regex_error(regex_constants::error_escape);
+               const uint32_t c = _pattern[_pos++];
+               if (c >= '0' && c <= '9')
+                  value = value * 16 + (c - '0');
+               else if (c >= 'a' && c <= 'f')
+                  value = value * 16 + (c - 'a' + 10);
+               else if (c >= 'A' && c <= 'F')
+                  value = value * 16 + (c - 'A' + 10);
+               else
+                  throw regex_error(regex_constants::error_escape);
+            }
+            return value;
+         }
+
+         // Parse the character of an escape, after the backslash and the escaped character.
+         uint32_t parse_escaped_char(uint32_t c)
+         {
+            switch (c)
+            {
+               case 't': return '\t';
+               case 'n': return '\n';
+               case 'v': return '\v';
+               case 'f': return '\f';
+               case 'r': return '\r';
+               case '0': return 0;
+               case 'x': return parse_hex(2);
+               case 'u': return parse_hex(4);
+               case 'c':
+                  if (at_end() || !((peek() >= 'a' && peek() <= 'z') || (peek() >= 'A' && peek() <= 'Z')))
+                     throw regex_error(regex_constants::error_escape);
+                  return _pattern[_pos++] % 32;
+            }
+
+            if (c >= '1' && c <= '9')
+               throw regex_error(regex_constants::error_backref);
+
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))
+               throw regex_error(regex_constants::error_escape);
+
+            return c;
+         }
+
+         uint32_t parse_escape()
+         {
+            if (at_end())
+               throw regex_error(regex_constants::error_escape);
+
+            const uint32_t c = _pattern[_pos++];
+            if (c == 'b')
+               return add_node(kind_t::assertion, uint32_t(op_t::word_boundary));
+            if (c == 'B')
+               return add_node(kind_t::assertion, uint32_t(op_t::not_word_boundary));
+
+            ranges_t ranges;
+            if (add_class_escape(c, ranges))
+               return add_set(move(ranges));
+
+            return add_node(kind_t::character, parse_escaped_char(c));
+         }
+
+         // Parse a character of a class, returns false if it was a class escape
+         // or a named class.
+         bool parse_class_char(uint32_t& c, ranges_t& ranges)
+         {
+            c = _pattern[_pos++];
+            if (c == '[' && !at_end() && (peek() == ':' || peek() == '.' || peek() == '='))
+            {
+               parse_bracket_class(ranges);
+               return false;
+            }
+
+            if (c != '\\')
+               return true;
+
+            if (at_end())
+               throw regex_error(regex_constants::error_escape);
+
+            const uint32_t escaped = _pattern[_pos++];
+            if (add_class_escape(escaped, ranges))
+               return false;
+
+            c = (escaped == 'b') ? '\b' : (escaped == '-') ? '-' : parse_escaped_char(escaped);
+            return true;
+         }
+
+         // Parse a named class, like [:alpha:], after its opening bracket.
+         // Collating elements and equivalence classes, like [.a.] and [=a=], are not supported.
+         void parse_bracket_class(ranges_t& ranges)
+         {
+            const uint32_t kind = _pattern[_pos++];
+
+            size_t end = _pos;
+            while (end + 1 < _pattern.size() && !(_pattern[end] == kind && _pattern[end + 1] == ']'))
+               ++end;
+            if (end + 1 >= _pattern.size())
+               throw regex_error(regex_constants::error_brack);
+
+            const vector<uint32_t> name(_pattern.begin() + _pos, _pattern.begin() + end);
+            _pos = end + 2;
+
+            if (kind != ':')
+               throw regex_error(regex_constants::error_collate);
+            if (!add_named_class(name, ranges))
+               throw regex_error(regex_constants::error_ctype);
+         }
+
+         uint32_t parse_class()
+         {
+            bool negated = false;
+            if (!at_end() && peek() == '^')
+            {
+               negated = true;
+               ++_pos;
+            }
+
+            ranges_t ranges;
+            while (true)
+            {
+               if (at_end())
+                  throw regex_error(regex_constants::error_brack);
+
+               if (peek() == ']')
+               {
+                  ++_pos;
+                  break;
+               }
+
+               uint32_t low = 0;
+               if (!parse_class_char(low, ranges))
+                  continue;
+
+               if (_pos + 1 < _pattern.size() && peek() == '-' && _pattern[_pos + 1] != ']')
+               {
+                  ++_pos;
+                  uint32_t high = 0;
+                  if (!parse_class_char(high, ranges) || high < low)
+                     throw regex_error(regex_constants::error_range);
+                  ranges.emplace_back(low, high);
+               }
+               else
+               {
+                  ranges.emplace_back(low, low);
+               }
+            }
+
+            normalize(ranges, _max_char);
+            if (negated)
+               ranges = complement(ranges, _max_char);
+
+            return add_set(move(ranges));
+         }
+
+         const vector<uint32_t>& _pattern;
+         const uint32_t _max_char;
+         vector<ranges_t>& _sets;
+         size_t _pos = 0;
+      };
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // The compiled patterns, shared by copies of a regex.
+
+   struct regex_program_t
+   {
+      vector<instruction_t> instructions;
+      vector<ranges_t> sets;
+
+      // The first instruction of each pattern.
+      vector<uint32_t> starts;
+
+      bool has_word_assertions = false;
+
+      // Character classes: characters in the same class are matched
+      // by the same instructions. The first character of each class.
+      vector<uint32_t> class_starts;
+      vector<uint32_t> low_classes;
+
+      // For a single pattern: the literal prefix of all matches,
+      // a literal substring in all matches and if the pattern is a literal.
+      vector<uint32_t> prefix;
+      vector<uint32_t> required;
+      bool is_literal = false;
+
+      uint32_t class_of(uint32_t c) const
+      {
+         if (c < low_classes.size())
+            return low_classes[c];
+         return uint32_t(upper_bound(class_starts.begin(), class_starts.end(), c) - class_starts.begin() - 1);
+      }
+
+      bool consumes(const instruction_t& instruction, uint32_t c) const
+      {
+         if (instruction.op == op_t::character)
+            return instruction.x == c;
+
+         if (instruction.op == op_t::set)
+         {
+            const ranges_t& ranges = sets[instruction.x];
+            const auto pos = upper_bound(ranges.begin(), ranges.end(), make_pair(c, UINT32_MAX));
+            return pos != ranges.begin() && (pos - 1)->second >= c;
+         }
+
+         return false;
+      }
+   };
+
+   namespace
+   {
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // Compile the parsed pattern into instructions.
+      //
+      // The compiler recurses on the nested nodes, which the parser limited.
+
+      struct regex_compiler_t
+      {
+         regex_compiler_t(const vector<ast_node_t>& nodes, regex_program_t& program)
+         : _nodes(nodes), _instructions(program.instructions)
+         {
+         }
+
+         uint32_t emit(op_t op, uint32_t x = 0, uint32_t y = 0)
+         {
+            if (_instructions.size() >= max_instructions)
+               throw regex_error(regex_constants::error_complexity);
+            _instructions.push_back(instruction_t{ op, x, y });
+            return uint32_t(_instructions.size() - 1);
+         }
+
+         uint32_t here() const { return uint32_t(_instructions.size()); }
+
+         void compile(uint32_t index)
+         {
+            const ast_node_t& node = _nodes[index];
+            switch (node.kind)
+            {
+               case kind_t::empty:
+                  break;
+               case kind_t::character:
+                  emit(op_t::character, node.value);
+                  break;
+               case kind_t::set:
+                  emit(op_t::set, node.value);
+                  break;
+               case kind_t::assertion:
+                  emit(op_t(node.value));
+                  break;
+               case kind_t::concat:
+                  for (const uint32_t child : node.children)
+                     compile(child);
+                  break;
+               case kind_t::alternate:
+               {
+                  vector<uint32_t> jumps;
+                  for (size_t i = 0; i + 1 < node.children.size(); ++i)
+                  {
+                     const uint32_t split = emit(op_t::split, here() + 1);
+                     compile(node.children[i]);
+                     jumps.emplace_back(emit(op_t::jump));
+                     _instructions[split].y = here();
+                  }
+                  compile(node.children.back());
+                  for (const uint32_t jump : jumps)
+                     _instructions[jump].x = here();
+                  break;
+               }
+               case kind_t::repeat:
+               {
+                  const uint32_t child = node.children[0];
+                  for (uint32_t i = 0; i < node.min; ++i)
+                     compile(child);
+
+                  if (node.max == infinite_repeat)
+                  {
+                     const uint32_t split = emit(op_t::split);
+                     compile(child);
+                     emit(op_t::jump, split);
+                     set_split(split, split + 1, here(), node.greedy);
+                  }
+                  else
+                  {
+                     vector<uint32_t> splits;
+                     for (uint32_t i = node.min; i < node.max; ++i)
+                     {
+                        splits.emplace_back(emit(op_t::split));
+                        compile(child);
+                     }
+                     for (const uint32_t split : splits)
+                        set_split(split, split + 1, here(), node.greedy);
+                  }
+                  break;
+               }
+            }
+         }
+
+      private:
+         void set_split(uint32_t split, uint32_t body, uint32_t out, bool greedy)
+         {
+            _instructions[split].x = greedy ? body : out;
+            _instructions[split].y = greedy ? out : body;
+         }
+
+         const vector<ast_node_t>& _nodes;
+         vector<instruction_t>& _instructions;
+      };
+
+      // Gather the items of the top-level concatenation.
+      void flatten(const vector<ast_node_t>& nodes, uint32_t index, vector<uint32_t>& items)
+      {
+         if (nodes[index].kind != kind_t::concat)
+         {
+            items.emplace_back(index);
+            return;
+         }
+
+         for (const uint32_t child : nodes[index].children)
+            flatten(nodes, child, items);
+      }
+
+      // Find the literal prefix and the longest literal run of a pattern.
+      void find_literals(const vector<ast_node_t>& nodes, uint32_t root, regex_program_t& program)
+      {
+         vector<uint32_t> items;
+         flatten(nodes, root, items);
+
+         vector<uint32_t> run;
+         bool is_prefix = true;
+         program.is_literal = true;
+         for (const uint32_t item : items)
+         {
+            if (nodes[item].kind == kind_t::character)
+            {
+               run.emplace_back(nodes[item].value);
+               continue;
+            }
+
+            if (nodes[item].kind != kind_t::empty)
+               program.is_literal = false;
+
+            if (is_prefix)
+               program.prefix = run;
+            is_prefix = false;
+            if (run.size() > program.required.size())
+               program.required = run;
+            run.clear();
+         }
+
+         if (is_prefix)
+            program.prefix = run;
+         if (run.size() > program.required.size())
+            program.required = run;
+      }
+
+      // Compute the character classes of the program.
+      void find_classes(regex_program_t& program, uint32_t max_char)
+      {
+         vector<uint32_t> starts(1, 0);
+         for (const auto& instruction : program.instructions)
+         {
+            if (instruction.op == op_t::character)
+            {
+               starts.emplace_back(instruction.x);
+               starts.emplace_back(instruction.x + 1);
+            }
+            else if (instruction.op == op_t::set)
+            {
+               for (const auto& [low, high] : program.sets[instruction.x])
+               {
+                  starts.emplace_back(low);
+                  starts.emplace_back(high + 1);
+               }
+            }
+         }
+
+         sort(starts.begin(), starts.end());
+         starts.erase(unique(starts.begin(), starts.end()), starts.end());
+         program.class_starts = move(starts);
+
+         program.low_classes.resize(min<uint32_t>(256, max_char + 1));
+         for (uint32_t c = 0; c < program.low_classes.size(); ++c)
+            program.low_classes[c] = uint32_t(upper_bound(program.class_starts.begin(), program.class_starts.end(), c) - program.class_starts.begin() - 1);
+      }
+
+      template <class CHAR>
+      uint32_t max_char_of()
+      {
+         return uint32_t(min<uint64_t>(numeric_limits<make_unsigned_t<CHAR>>::max(), UINT32_MAX - 1));
+      }
+
+      template <class CHAR>
+      uint32_t char_value(CHAR c)
+      {
+         return uint32_t(make_unsigned_t<CHAR>(c));
+      }
+
+      template <class CHAR>
+      shared_ptr<const regex_program_t> compile_patterns(const vector<basic_string_view<CHAR>>& patterns)
+      {
+         auto program = make_shared<regex_program_t>();
+         const uint32_t max_char = max_char_of<CHAR>();
+
+         for (size_t index = 0; index < patterns.size(); ++index)
+         {
+            vector<uint32_t> pattern;
+            for (const CHAR c : patterns[index])
+               pattern.emplace_back(char_value(c));
+
+            regex_parser_t parser(pattern, max_char, program->sets);
+            const uint32_t root = parser.parse();
+
+            program->starts.emplace_back(uint32_t(program->instructions.size()));
+            regex_compiler_t compiler(parser.nodes, *program);
+            compiler.compile(root);
+            compiler.emit(op_t::match, uint32_t(index));
+
+            if (patterns.size() == 1)
+               find_literals(parser.nodes, root, *program);
+         }
+
+         for (const auto& instruction : program->instructions)
+            if (instruction.op == op_t::word_boundary || instruction.op == op_t::not_word_boundary)
+               program->has_word_assertions = true;
+
+         find_classes(*program, max_char);
+
+         return program;
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // The context of a position in the text for the assertions.
+
+      enum class end_t : uint8_t { no, yes, unknown };
+
+      struct position_context_t
+      {
+         bool at_begin = false;
+         end_t at_end = end_t::no;
+         bool previous_is_word = false;
+         bool next_is_word = false;
+      };
+
+      template <class CHAR>
+      position_context_t context_at(basic_string_view<CHAR> text, size_t pos)
+      {
+         position_context_t context;
+         context.at_begin = (pos == 0);
+         context.at_end = (pos >= text.size()) ? end_t::yes : end_t::no;
+         context.previous_is_word = pos > 0 && is_word(char_value(text[pos - 1]));
+         context.next_is_word = pos < text.size() && is_word(char_value(text[pos]));
+         return context;
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      //
+      // Follow the instructions that do not consume characters from an instruction,
+      // calling the function with the reached consuming and match instructions,
+      // in priority order.
+      //
+      // When the end of text is unknown, end assertions are also reported.
+      //
+      // Instructions already marked with the generation are skipped.
+      // Uses an explicit stack instead of recursion.
+
+      template <class FUNC>
+      void follow(const regex_program_t& program, uint32_t pc, const position_context_t& context,
+                  vector<uint32_t>& marks, uint32_t generation, vector<uint32_t>& stack, FUNC func)
+      {
+         stack.clear();
+         stack.emplace_back(pc);
+         while (!stack.empty())
+         {
+            pc = stack.back();
+            stack.pop_back();
+
+            if (marks[pc] == generation)
+               continue;
+            marks[pc] = generation;
+
+            const instruction_t& instruction = program.instructions[pc];
+            switch (instruction.op)
+            {
+               case op_t::jump:
+                  stack.emplace_back(instruction.x);
+                  break;
+               case op_t::split:
+                  stack.emplace_back(instruction.y);
+                  stack.emplace_back(instruction.x);
+                  break;
+               case op_t::assert_begin:
+                  if (context.at_begin)
+                     stack.emplace_back(pc + 1);
+                  break;
+               case op_t::assert_end:
+                  if (context.at_end == end_t::yes)
+                     stack.emplace_back(pc + 1);
+                  else if (context.at_end == end_t::unknown)
+                     func(pc);
+                  break;
+               case op_t::word_boundary:
+                  if (context.previous_is_word != context.next_is_word)
+                     stack.emplace_back(pc + 1);
+                  break;
+               case op_t::not_word_boundary:
+                  if (context.previous_is_word == context.next_is_word)
+                     stack.emplace_back(pc + 1);
+                  break;
+               default:
+                  func(pc);
+                  break;
+            }
+         }
+      }
+
+      struct thread_list_t
+      {
+         vector<uint32_t> pcs;
+         vector<size_t> starts;
+
+         void clear() { pcs.clear(); starts.clear(); }
+         bool empty() const { return pcs.empty(); }
+         void add(uint32_t pc, size_t start) { pcs.emplace_back(pc); starts.emplace_back(start); }
+      };
+
+      struct dfa_state_t
+      {
+         // The reached instructions, sorted.
+         vector<uint32_t> pcs;
+
+         // The patterns matched when reaching this state and at the end of the text.
+         vector<uint32_t> matches;
+         vector<uint32_t> end_matches;
+         bool end_matches_known = false;
+      };
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Matches the program on texts, keeping the lazily built DFA.
+
+   template <class CHAR>
+   struct regex_matcher_t
+   {
+      using string_view_t = basic_string_view<CHAR>;
+
+      regex_matcher_t(shared_ptr<const regex_program_t> program)
+      : _program(move(program))
+      {
+         auto to_string = [](const vector<uint32_t>& chars)
+         {
+            basic_string<CHAR> text;
+            for (const uint32_t c : chars)
+               text += CHAR(c);
+            return text;
+         };
+
+         _prefix = basic_substring_searcher_t<CHAR>(to_string(_program->prefix));
+         _required = basic_substring_searcher_t<CHAR>(to_string(_program->required));
+         _marks.assign(_program->instructions.size(), 0);
+      }
+
+      regex_matcher_t(const regex_matcher_t& other)
+      : regex_matcher_t(other._program)
+      {
+      }
+
+      size_t pattern_count() const { return _program->starts.size(); }
+
+      const basic_string<CHAR>& required_text() const { return _required.needle(); }
+
+      // Find the first match with the priorities of the pattern, simulating the automaton.
+      // Only for a single pattern.
+      bool find(string_view_t text, size_t from, size_t& match_start, size_t& match_end, bool continuous, bool not_empty)
+      {
+         if (from > text.size())
+            return false;
+
+         if (!_required.is_in(text.substr(from)))
+            return false;
+
+         const regex_program_t& program = *_program;
+         const size_t size = text.size();
+         bool matched = false;
+
+         _current.clear();
+         uint32_t generation = next_generation();
+
+         for (size_t pos = from; ; ++pos)
+         {
+            if (!matched && (!continuous || pos == from))
+            {
+               // Without threads, skip to the next position with the literal prefix.
+               if (_current.empty() && !continuous && !_program->prefix.empty())
+               {
+                  const size_t skip = _prefix.find(text.substr(pos));
+                  if (skip == string_view_t::npos)
+                     break;
+                  if (skip > 0)
+                  {
+                     pos += skip;
+                     generation = next_generation();
+                  }
+               }
+
+               follow(program, program.starts[0], context_at(text, pos), _marks, generation, _stack,
+                      [this, pos](uint32_t pc) { _current.add(pc, pos); });
+            }
+
+            // Without threads, only new starts can still match.
+            if (_current.empty() && (matched || continuous || pos >= size))
+               break;
+
+            _next.clear();
+            generation = next_generation();
+            const position_context_t next_context = context_at(text, pos + 1);
+
+            for (size_t i = 0; i < _current.pcs.size(); ++i)
+            {
+               const uint32_t pc = _current.pcs[i];
+               const size_t start = _current.starts[i];
+               const instruction_t& instruction = program.instructions[pc];
+
+               if (instruction.op == op_t::match)
+               {
+                  if (not_empty && start == pos)
+                     continue;
+
+                  // The threads after this one have lower priorities.
+                  matched = true;
+                  match_start = start;
+                  match_end = pos;
+                  break;
+               }
+
+               if (pos < size && program.consumes(instruction, char_value(text[pos])))
+                  follow(program, pc + 1, next_context, _marks, generation, _stack,
+                         [this, start](uint32_t pc) { _next.add(pc, start); });
+            }
+
+            if (pos >= size)
+               break;
+
+            swap(_current, _next);
+         }
+
+         return matched;
+      }
+
+      // Find which patterns match in the text, stopping once the given number of patterns are found.
+      void find_all(string_view_t text, vector<bool>& found, size_t wanted)
+      {
+         found.assign(pattern_count(), false);
+
+         if (_program->is_literal)
+         {
+            found[0] = _required.is_in(text);
+            return;
+         }
+
+         if (pattern_count() == 1 && !_required.is_in(text))
+            return;
+
+         if (_program->has_word_assertions || text.empty() || !dfa_find_all(text, found, wanted))
+            nfa_find_all(text, found, wanted);
+      }
+
+   private:
+      uint32_t next_generation()
+      {
+         if (++_generation == 0)
+         {
+            fill(_marks.begin(), _marks.end(), 0);
+            _generation = 1;
+         }
+         return _generation;
+      }
+
+      // Mark the found patterns, returns the number of newly found patterns.
+      static size_t mark_found(const vector<uint32_t>& matches, vector<bool>& found)
+      {
+         size_t count = 0;
+         for (const uint32_t pattern : matches)
+         {
+            if (!found[pattern])
+            {
+               found[pattern] = true;
+               ++count;
+            }
+         }
+         return count;
+      }
+
+      // Simulate the automaton, all patterns at once, without priorities.
+      void nfa_find_all(string_view_t text, vector<bool>& found, size_t wanted)
+      {
+         const regex_program_t& program = *_program;
+         const size_t size = text.size();
+         size_t found_count = count(found.begin(), found.end(), true);
+
+         _current.clear();
+         uint32_t generation = next_generation();
+
+         for (size_t pos = 0; ; ++pos)
+         {
+            const position_context_t context = context_at(text, pos);
+            for (const uint32_t start : program.starts)
+               follow(program, start, context, _marks, generation, _stack, [this](uint32_t pc) { _current.add(pc, 0); });
+
+            _next.clear();
+            generation = next_generation();
+            const position_context_t next_context = context_at(text, pos + 1);
+
+            for (const uint32_t pc : _current.pcs)
+            {
+               const instruction_t& instruction = program.instructions[pc];
+               if (instruction.op == op_t::match)
+               {
+                  if (!found[instruction.x])
+                  {
+                     found[instruction.x] = true;
+                     if (++found_count >= wanted)
+                        return;
+                  }
+                  continue;
+               }
+
+               if (pos < size && program.consumes(instruction, char_value(text[pos])))
+                  follow(program, pc + 1, next_context, _marks, generation, _stack, [this](uint32_t pc) { _next.add(pc, 0); });
+            }
+
+            if (pos >= size)
+               break;
+
+            swap(_current, _next);
+         }
+      }
+
+      // Run the lazily built DFA. Returns false if the DFA grew too large,
+      // in which case the DFA is cleared and the found patterns are incomplete.
+      bool dfa_find_all(string_view_t text, vector<bool>& found, size_t wanted)
+      {
+         const size_t class_count = _program->class_starts.size();
+
+         if (_start_state == unknown_state)
+         {
+            position_context_t context;
+            context.at_begin = true;
+            context.at_end = end_t::unknown;
+            _start_state = add_state(context, nullptr, 0);
+            if (_start_state == unknown_state)
+               return false;
+         }
+
+         size_t found_count = mark_found(_states[_start_state].matches, found);
+         if (found_count >= wanted)
+            return true;
+
+         uint32_t state = _start_state;
+         for (const CHAR c : text)
+         {
+            const uint32_t char_class = _program->class_of(char_value(c));
+            uint32_t next = _transitions[state * class_count + char_class];
+            if (next == unknown_state)
+            {
+               position_context_t context;
+               context.at_end = end_t::unknown;
+               next = add_state(context, &_states[state].pcs, _program->class_starts[char_class]);
+               if (next == unknown_state)
+                  return false;
+               _transitions[state * class_count + char_class] = next;
+            }
+            state = next;
+
+            if (!_states[state].matches.empty())
+            {
+               found_count += mark_found(_states[state].matches, found);
+               if (found_count >= wanted)
+                  return true;
+            }
+         }
+
+         mark_found(end_matches(state), found);
+         return true;
+      }
+
+      // Add the state reached from the given instructions when consuming the character,
+      // also restarting all patterns. Without previous instructions, only start the patterns.
+      uint32_t add_state(const position_context_t& context, const vector<uint32_t>* previous, uint32_t c)
+      {
+         const regex_program_t& program = *_program;
+
+         vector<uint32_t> pcs;
+         const uint32_t generation = next_generation();
+         auto add = [&pcs](uint32_t pc) { pcs.emplace_back(pc); };
+
+         if (previous)
+            for (const uint32_t pc : *previous)
+               if (program.consumes(program.instructions[pc], c))
+                  follow(program, pc + 1, context, _marks, generation, _stack, add);
+
+         for (const uint32_t start : program.starts)
+            follow(program, start, context, _marks, generation, _stack, add);
+
+         sort(pcs.begin(), pcs.end());
+
+         if (const auto pos = _state_ids.find(pcs); pos != _state_ids.end())
+            return pos->second;
+
+         if (_states.size() >= max_dfa_states)
+         {
+            clear_dfa();
+            return unknown_state;
+         }
+
+         dfa_state_t& state = _states.emplace_back();
+         state.pcs = pcs;
+         for (const uint32_t pc : pcs)
+            if (program.instructions[pc].op == op_t::match)
+               state.matches.emplace_back(program.instructions[pc].x);
+
+         const uint32_t id = uint32_t(_states.size() - 1);
+         _state_ids[move(pcs)] = id;
+         _transitions.resize(_transitions.size() + program.class_starts.size(), unknown_state);
+         return id;
+      }
+
+      // The patterns matched when the text ends in the state.
+      const vector<uint32_t>& end_matches(uint32_t id)
+      {
+         dfa_state_t& state = _states[id];
+         if (!state.end_matches_known)
+         {
+            position_context_t context;
+            context.at_end = end_t::yes;
+
+            const uint32_t generation = next_generation();
+            for (const uint32_t pc : state.pcs)
+            {
+               if (_program->instructions[pc].op != op_t::assert_end)
+                  continue;
+
+               follow(*_program, pc + 1, context, _marks, generation, _stack, [this, &state](uint32_t pc)
+               {
+                  if (_program->instructions[pc].op == op_t::match)
+                     state.end_matches.emplace_back(_program->instructions[pc].x);
+               });
+            }
+
+            state.end_matches_known = true;
+         }
+
+         return state.end_matches;
+      }
+
+      void clear_dfa()
+      {
+         _states.clear();
+         _state_ids.clear();
+         _transitions.clear();
+         _start_state = unknown_state;
+      }
+
+      shared_ptr<const regex_program_t> _program;
+      basic_substring_searcher_t<CHAR> _prefix;
+      basic_substring_searcher_t<CHAR> _required;
+
+      // Scratch data to follow instructions.
+      vector<uint32_t> _marks;
+      uint32_t _generation = 0;
+      vector<uint32_t> _stack;
+      thread_list_t _current;
+      thread_list_t _next;
+
+      // The lazily built DFA.
+      vector<dfa_state_t> _states;
+      map<vector<uint32_t>, uint32_t> _state_ids;
+      vector<uint32_t> _transitions;
+      uint32_t _start_state = unknown_state;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Regex.
+
+   template <class CHAR>
+   basic_linear_regex_t<CHAR>::basic_linear_regex_t() = default;
+
+   template <class CHAR>
+   basic_linear_regex_t<CHAR>::basic_linear_regex_t(string_view_t pattern)
+   : _matcher(make_unique<regex_matcher_t<CHAR>>(compile_patterns<CHAR>({ pattern })))
+   {
+   }
+
+   template <class CHAR>
+   basic_linear_regex_t<CHAR>::basic_linear_regex_t(const basic_linear_regex_t& other)
+   : _matcher(other._matcher ? make_unique<regex_matcher_t<CHAR>>(*other._matcher) : nullptr)
+   {
+   }
+
+   template <class CHAR>
+   basic_linear_regex_t<CHAR>::basic_linear_regex_t(basic_linear_regex_t&& other) = default;
+
+   template <class CHAR>
+   basic_linear_regex_t<CHAR>::~basic_linear_regex_t() = default;
+
+   template <class CHAR>
+   basic_linear_regex_t<CHAR>& basic_linear_regex_t<CHAR>::operator=(const basic_linear_regex_t& other)
+   {
+      if (this != &other)
+         _matcher = other._matcher ? make_unique<regex_matcher_t<CHAR>>(*other._matcher) : nullptr;
+      return *this;
+   }
+
+   template <class CHAR>
+   basic_linear_regex_t<CHAR>& basic_linear_regex_t<CHAR>::operator=(basic_linear_regex_t&& other) = default;
+
+   template <class CHAR>
+   bool basic_linear_regex_t<CHAR>::search(string_view_t text)
+   {
+      if (!_matcher)
+         return false;
+
+      vector<bool> found;
+      _matcher->find_all(text, found, 1);
+      return found[0];
+   }
+
+   template <class CHAR>
+   bool basic_linear_regex_t<CHAR>::find(string_view_t text, size_t from, size_t& match_start, size_t& match_end, bool continuous, bool not_empty)
+   {
+      if (!_matcher)
+         return false;
+
+      return _matcher->find(text, from, match_start, match_end, continuous, not_empty);
+   }
+
+   template <class CHAR>
+   basic_string<CHAR> basic_linear_regex_t<CHAR>::required_text() const
+   {
+      if (!_matcher)
+         return {};
+
+      return _matcher->required_text();
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Regex set.
+
+   template <class CHAR>
+   basic_linear_regex_set_t<CHAR>::basic_linear_regex_set_t() = default;
+
+   template <class CHAR>
+   basic_linear_regex_set_t<CHAR>::basic_linear_regex_set_t(const vector<basic_string<CHAR>>& patterns)
+   {
+      vector<basic_string_view<CHAR>> views(patterns.begin(), patterns.end());
+      _matcher = make_unique<regex_matcher_t<CHAR>>(compile_patterns<CHAR>(views));
+   }
+
+   template <class CHAR>
+   basic_linear_regex_set_t<CHAR>::basic_linear_regex_set_t(const basic_linear_regex_set_t& other)
+   : _matcher(other._matcher ? make_unique<regex_matcher_t<CHAR>>(*other._matcher) : nullptr)
+   {
+   }
+
+   template <class CHAR>
+   basic_linear_regex_set_t<CHAR>::basic_linear_regex_set_t(basic_linear_regex_set_t&& other) = default;
+
+   template <class CHAR>
+   basic_linear_regex_set_t<CHAR>::~basic_linear_regex_set_t() = default;
+
+   template <class CHAR>
+   basic_linear_regex_set_t<CHAR>& basic_linear_regex_set_t<CHAR>::operator=(const basic_linear_regex_set_t& other)
+   {
+      if (this != &other)
+         _matcher = other._matcher ? make_unique<regex_matcher_t<CHAR>>(*other._matcher) : nullptr;
+      return *this;
+   }
+
+   template <class CHAR>
+   basic_linear_regex_set_t<CHAR>& basic_linear_regex_set_t<CHAR>::operator=(basic_linear_regex_set_t&& other) = default;
+
+   template <class CHAR>
+   size_t basic_linear_regex_set_t<CHAR>::size() const
+   {
+      return _matcher ? _matcher->pattern_count() : 0;
+   }
+
+   template <class CHAR>
+   void basic_linear_regex_set_t<CHAR>::find_all(string_view_t text, vector<bool>& found)
+   {
+      if (!_matcher)
+      {
+         found.clear();
+         return;
+      }
+
+      _matcher->find_all(text, found, _matcher->pattern_count());
+   }
+
+   template struct basic_linear_regex_t<char>;
+   template struct basic_linear_regex_t<wchar_t>;
+   template struct basic_linear_regex_set_t<char>;
+   template struct basic_linear_regex_set_t<wchar_t>;
+}
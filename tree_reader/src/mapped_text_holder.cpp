@@ -0,0 +1,466 @@
+#include "dak/tree_reader/mapped_text_holder.h"
+
+#ifdef _WIN32
+   #define NOMINMAX
+   #define WIN32_LEAN_AND_MEAN
+   #include <windows.h>
+#else
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+
+   /////////////////////////////////////////////////////////////////////////
+   //
+   // Memory-mapped file.
+
+   mapped_file_t::~mapped_file_t()
+   {
+      close();
+   }
+
+#ifdef _WIN32
+
+   bool mapped_file_t::open(const filesystem::path& path, access_t access)
+   {
+      close();
+
+      const bool copy_on_write = (access == access_t::copy_on_write);
+
+      HANDLE file = ::CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+      if (file == INVALID_HANDLE_VALUE)
+         return false;
+      _file = file;
+
+      LARGE_INTEGER size;
+      if (!::GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+      {
+         close();
+         return false;
+      }
+
+      HANDLE mapping = ::CreateFileMappingW(file, nullptr, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+      if (!mapping)
+      {
+         close();
+         return false;
+      }
+      _mapping = mapping;
+
+      void* data = ::MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+      if (!data)
+      {
+         close();
+         return false;
+      }
+
+      _data = static_cast<char*>(data);
+      _size = size_t(size.QuadPart);
+      return true;
+   }
+
+   void mapped_file_t::close()
+   {
+      if (_data)
+         ::UnmapViewOfFile(_data);
+      if (_mapping)
+         ::CloseHandle(_mapping);
+      if (_file)
+         ::CloseHandle(_file);
+
+      _data = nullptr;
+      _size = 0;
+      _mapping = nullptr;
+      _file = nullptr;
+   }
+
+   void mapped_file_t::will_need(size_t offset, size_t size) const
+   {
+      if (!_data || offset >= _size)
+         return;
+
+      WIN32_MEMORY_RANGE_ENTRY range = { _data + offset, min(size, _size - offset) };
+      ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+   }
+
+   uint64_t get_available_memory()
+   {
+      MEMORYSTATUSEX status = { sizeof(status) };
+      if (!::GlobalMemoryStatusEx(&status))
+         return 0;
+
+      return status.ullAvailPhys;
+   }
+
+#else
+
+   bool mapped_file_t::open(const filesystem::path& path, access_t access)
+   {
+      close();
+
+      const bool copy_on_write = (access == access_t::copy_on_write);
+
+      const int file = ::open(path.c_str(), O_RDONLY);
+      if (file < 0)
+         return false;
+
+      struct stat info;
+      if (::fstat(file, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0)
+      {
+         ::close(file);
+         return false;
+      }
+
+      void* data = ::mmap(nullptr, size_t(info.st_size), copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, file, 0);
+
+      // note: the mapping stays valid after the file is closed.
+      ::close(file);
+
+      if (data == MAP_FAILED)
+         return false;
+
+      ::madvise(data, size_t(info.st_size), MADV_SEQUENTIAL);
+
+      _data = static_cast<char*>(data);
+      _size = size_t(info.st_size);
+      return true;
+   }
+
+   void mapped_file_t::close()
+   {
+      if (_data)
+         ::munmap(_data, _size);
+
+      _data = nullptr;
+      _size = 0;
+   }
+
+   void mapped_file_t::will_need(size_t offset, size_t size) const
+   {
+      if (!_data || offset >= _size)
+         return;
+
+      // note: the advice must start on a page boundary.
+      static const size_t page_size = size_t(::sysconf(_SC_PAGESIZE));
+      const size_t start = offset - offset % page_size;
+      const size_t end = min(offset + size, _size);
+      ::madvise(_data + start, end - start, MADV_WILLNEED);
+   }
+
+   uint64_t get_available_memory()
+   {
+      const long pages = ::sysconf(_SC_AVPHYS_PAGES);
+      const long page_size = ::sysconf(_SC_PAGESIZE);
+      if (pages <= 0 || page_size <= 0)
+         return 0;
+
+      return uint64_t(pages) * uint64_t(page_size);
+   }
+
+#endif
+
+   /////////////////////////////////////////////////////////////////////////
+   //
+   // UTF-8 decoding.
+
+   namespace
+   {
+      // Decode one multi-byte UTF-8 character and return the position after it.
+      // An invalid sequence decodes its first byte as-is.
+      const char* decode_utf8(const char* pos, const char* end, char32_t& c)
+      {
+         const unsigned char first = static_cast<unsigned char>(*pos);
+
+         size_t extra = 0;
+         char32_t decoded = 0;
+         char32_t minimum = 0;
+         if ((first & 0xE0) == 0xC0)
+         {
+            extra = 1;
+            decoded = first & 0x1F;
+            minimum = 0x80;
+         }
+         else if ((first & 0xF0) == 0xE0)
+         {
+            extra = 2;
+            decoded = first & 0x0F;
+            minimum = 0x800;
+         }
+         else if ((first & 0xF8) == 0xF0)
+         {
+            extra = 3;
+            decoded = first & 0x07;
+            minimum = 0x10000;
+         }
+
+         if (extra == 0 || size_t(end - pos) <= extra)
+         {
+            c = first;
+            return pos + 1;
+         }
+
+         for (size_t i = 1; i <= extra; ++i)
+         {
+            const unsigned char next = static_cast<unsigned char>(pos[i]);
+            if ((next & 0xC0) != 0x80)
+            {
+               c = first;
+               return pos + 1;
+            }
+            decoded = (decoded << 6) | (next & 0x3F);
+         }
+
+         if (decoded < minimum || decoded > 0x10FFFF || (decoded >= 0xD800 && decoded <= 0xDFFF))
+         {
+            c = first;
+            return pos + 1;
+         }
+
+         c = decoded;
+         return pos + 1 + extra;
+      }
+
+      wchar_t* put_wide_char(wchar_t* text, char32_t c)
+      {
+         if constexpr (sizeof(wchar_t) == 2)
+         {
+            if (c >= 0x10000)
+            {
+               c -= 0x10000;
+               *text++ = wchar_t(0xD800 + (c >> 10));
+               *text++ = wchar_t(0xDC00 + (c & 0x3FF));
+               return text;
+            }
+         }
+
+         *text++ = wchar_t(c);
+         return text;
+      }
+
+      // Scan the next window of the file when all its scanned lines were read.
+      // The window grows when a line is longer than it.
+      // Returns false when there are no more lines.
+      template <class READER>
+      bool scan_next_lines(READER& reader)
+      {
+         while (reader.next_line >= reader.lines.size())
+         {
+            const size_t left = reader.file_end - reader.pos_in_file;
+            if (left <= 0)
+               return false;
+
+            const size_t size = min(reader.window_size, left);
+            scan_lines(reader.pos_in_file, size, size == left, reader.tab_size, reader.lines);
+            if (reader.lines.scanned_end <= 0)
+               reader.window_size *= 2;
+
+            reader.window = reader.pos_in_file;
+            reader.pos_in_file += reader.lines.scanned_end;
+            reader.next_line = 0;
+         }
+
+         return true;
+      }
+
+      // Find the end of up to count chunks of about equal size.
+      // Each chunk ends right after a new-line, except the last one.
+      template <class CHAR>
+      vector<CHAR*> find_chunk_ends(CHAR* begin, CHAR* end, size_t count)
+      {
+         vector<CHAR*> chunk_ends;
+
+         const size_t chunk_size = size_t(end - begin) / max<size_t>(count, 1);
+         CHAR* chunk_begin = begin;
+         while (chunk_ends.size() + 1 < count && size_t(end - chunk_begin) > chunk_size)
+         {
+            CHAR* new_line = static_cast<CHAR*>(memchr(chunk_begin + chunk_size, '\n', end - chunk_begin - chunk_size));
+            if (!new_line || new_line + 1 >= end)
+               break;
+            chunk_begin = new_line + 1;
+            chunk_ends.emplace_back(chunk_begin);
+         }
+         chunk_ends.emplace_back(end);
+
+         return chunk_ends;
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////
+   //
+   // Memory-mapped text reader.
+
+   bool mapped_text_holder_reader_t::open(const filesystem::path& path)
+   {
+      if (!holder->file.open(path))
+         return false;
+
+      pos_in_file = holder->file.data();
+      file_end = pos_in_file + holder->file.size();
+
+      // Skip the UTF-8 byte-order mark.
+      if (file_end - pos_in_file >= 3 && pos_in_file[0] == '\xEF' && pos_in_file[1] == '\xBB' && pos_in_file[2] == '\xBF')
+         pos_in_file += 3;
+
+      // note: a UTF-8 sequence never decodes into more wide characters than it has bytes.
+      //       Each line terminator replaces a new-line, plus one for a last line without
+      //       a new-line and one for the final empty read.
+      if (keep_read_text)
+      {
+         holder->text.reset(new wchar_t[holder->file.size() + 2]);
+         pos_in_text = holder->text.get();
+      }
+
+      return true;
+   }
+
+   pair<wchar_t*, size_t> mapped_text_holder_reader_t::read_line()
+   {
+      const bool has_line = scan_next_lines(*this);
+
+      // Decode over the previous line when the text is not kept.
+      if (!keep_read_text)
+      {
+         const size_t needed = (has_line ? lines.lengths[next_line] : 0) + 1;
+         if (line_text.size() < needed)
+            line_text.resize(needed);
+         pos_in_text = line_text.data();
+      }
+
+      if (!has_line)
+      {
+         *pos_in_text = 0;
+         return make_pair(pos_in_text, 0);
+      }
+
+      line_in_file = window + lines.offsets[next_line];
+      const char* line_end = line_in_file + lines.lengths[next_line];
+      indent = lines.indents[next_line];
+      text_index = lines.text_indexes[next_line];
+      ++next_line;
+
+      // The indentation is made of single-byte spaces and tabs.
+      const char* pos = line_in_file;
+      if (!decode_indentation)
+      {
+         pos += text_index;
+         text_index = 0;
+      }
+
+      wchar_t* line = pos_in_text;
+      while (pos < line_end)
+      {
+         if (static_cast<unsigned char>(*pos) < 0x80)
+         {
+            *pos_in_text++ = wchar_t(*pos++);
+         }
+         else
+         {
+            char32_t c;
+            pos = decode_utf8(pos, line_end, c);
+            pos_in_text = put_wide_char(pos_in_text, c);
+         }
+      }
+
+      const size_t count = pos_in_text - line;
+      *pos_in_text++ = 0;
+
+      return make_pair(line, count);
+   }
+
+   vector<mapped_text_holder_reader_t> mapped_text_holder_reader_t::split(size_t count)
+   {
+      vector<mapped_text_holder_reader_t> chunks;
+
+      const vector<const char*> chunk_ends = find_chunk_ends(pos_in_file, file_end, count);
+
+      // note: each chunk decodes into its own part of the text, which needs
+      //       room for the terminators of its partial last line and final empty read.
+      const size_t text_size = holder->file.size() + 2 * chunk_ends.size();
+      holder->text.reset(new wchar_t[text_size]);
+
+      const char* chunk_begin = pos_in_file;
+      for (const char* chunk_end : chunk_ends)
+      {
+         mapped_text_holder_reader_t chunk;
+         chunk.holder = holder;
+         chunk.tab_size = tab_size;
+         chunk.decode_indentation = decode_indentation;
+         chunk.pos_in_file = chunk_begin;
+         chunk.file_end = chunk_end;
+         chunk.pos_in_text = holder->text.get() + (chunk_begin - pos_in_file) + 2 * chunks.size();
+         chunks.emplace_back(move(chunk));
+         chunk_begin = chunk_end;
+      }
+
+      return chunks;
+   }
+
+   /////////////////////////////////////////////////////////////////////////
+   //
+   // Memory-mapped UTF-8 text reader.
+
+   bool mapped_utf8_text_holder_reader_t::open(const filesystem::path& path)
+   {
+      if (!holder->file.open(path, mapped_file_t::access_t::copy_on_write))
+         return false;
+
+      pos_in_file = holder->file.data();
+      file_end = pos_in_file + holder->file.size();
+
+      // Skip the UTF-8 byte-order mark.
+      if (file_end - pos_in_file >= 3 && pos_in_file[0] == '\xEF' && pos_in_file[1] == '\xBB' && pos_in_file[2] == '\xBF')
+         pos_in_file += 3;
+
+      return true;
+   }
+
+   pair<char*, size_t> mapped_utf8_text_holder_reader_t::read_line()
+   {
+      if (!scan_next_lines(*this))
+         return make_pair(file_end, 0);
+
+      char* line = window + lines.offsets[next_line];
+      const size_t count = lines.lengths[next_line];
+      indent = lines.indents[next_line];
+      text_index = lines.text_indexes[next_line];
+      ++next_line;
+
+      if (line + count < file_end)
+      {
+         line[count] = 0;
+         return make_pair(line, count);
+      }
+
+      holder->last_line.assign(line, count);
+      return make_pair(holder->last_line.data(), count);
+   }
+
+   vector<mapped_utf8_text_holder_reader_t> mapped_utf8_text_holder_reader_t::split(size_t count)
+   {
+      vector<mapped_utf8_text_holder_reader_t> chunks;
+
+      // note: only the last chunk can reach the end of the file without a new-line,
+      //       so only it can use the last line of the holder.
+      char* chunk_begin = pos_in_file;
+      for (char* chunk_end : find_chunk_ends(pos_in_file, file_end, count))
+      {
+         mapped_utf8_text_holder_reader_t chunk;
+         chunk.holder = holder;
+         chunk.tab_size = tab_size;
+         chunk.pos_in_file = chunk_begin;
+         chunk.file_end = chunk_end;
+         chunks.emplace_back(move(chunk));
+         chunk_begin = chunk_end;
+      }
+
+      return chunks;
+   }
+}
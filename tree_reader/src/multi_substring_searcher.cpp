@@ -0,0 +1,149 @@
+#include "dak/tree_reader/multi_substring_searcher.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+
+   namespace
+   {
+      constexpr uint32_t no_state = UINT32_MAX;
+   }
+
+   multi_substring_searcher_t::multi_substring_searcher_t(const vector<wstring>& needles)
+   : _needle_count(needles.size())
+   {
+      // Give a class to each character used in the needles.
+      _low_classes.assign(256, 0);
+      vector<wchar_t> high_chars;
+      for (const auto& needle : needles)
+      {
+         for (const wchar_t c : needle)
+         {
+            if (size_t(c) < 256)
+            {
+               if (!_low_classes[size_t(c)])
+                  _low_classes[size_t(c)] = _class_count++;
+            }
+            else
+            {
+               high_chars.emplace_back(c);
+            }
+         }
+      }
+
+      sort(high_chars.begin(), high_chars.end());
+      high_chars.erase(unique(high_chars.begin(), high_chars.end()), high_chars.end());
+      for (const wchar_t c : high_chars)
+         _high_classes.emplace_back(c, _class_count++);
+
+      // Build the trie of the needles, the root being state zero.
+      const size_t width = _class_count;
+      _transitions.assign(width, no_state);
+      vector<vector<uint32_t>> outputs(1);
+
+      for (size_t index = 0; index < needles.size(); ++index)
+      {
+         const auto& needle = needles[index];
+         if (needle.empty())
+         {
+            _empty_needles.emplace_back(uint32_t(index));
+            continue;
+         }
+
+         uint32_t state = 0;
+         for (const wchar_t c : needle)
+         {
+            uint32_t& next = _transitions[state * width + class_of(c)];
+            if (next == no_state)
+            {
+               next = uint32_t(outputs.size());
+               outputs.emplace_back();
+               _transitions.resize(_transitions.size() + width, no_state);
+            }
+            state = _transitions[state * width + class_of(c)];
+         }
+         outputs[state].emplace_back(uint32_t(index));
+      }
+
+      // Turn the trie into an automaton in breadth-first order: missing transitions
+      // follow the failure link and each state also reports the needles of its failure state.
+      //
+      // The characters that are in no needle go back to the root.
+      vector<uint32_t> failures(outputs.size(), 0);
+      deque<uint32_t> to_visit;
+      for (size_t c = 0; c < width; ++c)
+      {
+         uint32_t& next = _transitions[c];
+         if (next == no_state)
+            next = 0;
+         else
+            to_visit.emplace_back(next);
+      }
+
+      while (!to_visit.empty())
+      {
+         const uint32_t state = to_visit.front();
+         to_visit.pop_front();
+
+         const uint32_t failure = failures[state];
+         outputs[state].insert(outputs[state].end(), outputs[failure].begin(), outputs[failure].end());
+
+         for (size_t c = 0; c < width; ++c)
+         {
+            uint32_t& next = _transitions[state * width + c];
+            const uint32_t failure_next = _transitions[failure * width + c];
+            if (next == no_state)
+            {
+               next = failure_next;
+            }
+            else
+            {
+               failures[next] = failure_next;
+               to_visit.emplace_back(next);
+            }
+         }
+      }
+
+      _output_starts.reserve(outputs.size() + 1);
+      for (const auto& output : outputs)
+      {
+         _output_starts.emplace_back(uint32_t(_outputs.size()));
+         _outputs.insert(_outputs.end(), output.begin(), output.end());
+      }
+      _output_starts.emplace_back(uint32_t(_outputs.size()));
+   }
+
+   uint32_t multi_substring_searcher_t::class_of(wchar_t c) const
+   {
+      if (size_t(c) < 256)
+         return _low_classes[size_t(c)];
+
+      const auto pos = lower_bound(_high_classes.begin(), _high_classes.end(), make_pair(c, uint32_t(0)));
+      return (pos != _high_classes.end() && pos->first == c) ? pos->second : 0;
+   }
+
+   void multi_substring_searcher_t::find_all(wstring_view text, vector<bool>& found) const
+   {
+      found.assign(_needle_count, false);
+      for (const uint32_t index : _empty_needles)
+         found[index] = true;
+
+      if (_transitions.empty())
+         return;
+
+      const size_t width = _class_count;
+      const uint32_t* const transitions = _transitions.data();
+      const uint32_t* const output_starts = _output_starts.data();
+
+      uint32_t state = 0;
+      for (const wchar_t c : text)
+      {
+         state = transitions[state * width + class_of(c)];
+         for (uint32_t output = output_starts[state]; output < output_starts[state + 1]; ++output)
+            found[_outputs[output]] = true;
+      }
+   }
+}
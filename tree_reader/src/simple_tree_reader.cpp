@@ -1,123 +1,399 @@
 #include "dak/tree_reader/simple_tree_reader.h"
 #include "dak/tree_reader/buffers_text_holder.h"
+#include "dak/tree_reader/mapped_text_holder.h"
+#include "dak/tree_reader/linear_regex.h"
+#include "dak/utility/text.h"
 
 #include <fstream>
 #include <sstream>
 #include <algorithm>
-#include <list>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <type_traits>
 
 namespace dak::tree_reader
 {
    using namespace std;
    using namespace std::filesystem;
-   using node = text_tree_t::node_t;
 
-   struct buffers_text_holder_with_filtered_lines : buffers_text_holder_t
+   static size_t span_of(const wchar_t* line, const wchar_t* chars) { return wcsspn(line, chars); }
+   static size_t span_of(const char* line, const char* chars) { return strspn(line, chars); }
+
+   template <class CHAR>
+   static std::pair<size_t, size_t> getIndent(const CHAR* line, size_t count, const basic_string<CHAR>& input_indent, const load_simple_text_tree_options_t& options)
    {
-      list<wstring> filtered_lines;
+      const size_t text_index = span_of(line, input_indent.c_str());
+      size_t indent = text_index;
+      for (size_t i = 0; i < text_index; ++i)
+         if (line[i] == CHAR('\t'))
+            indent += options.tab_size - 1;
+      return make_pair(indent, text_index);
+   }
+
+   // The options converted to the type of text being read.
+
+   static const wstring& convert_option(const wstring& text, wchar_t) { return text; }
+   static string convert_option(const wstring& text, char) { return utility::to_utf8(text); }
+
+   // The lines read from the input, with their indentation and length.
+
+   template <class CHAR>
+   struct read_lines_t
+   {
+      vector<size_t> indents;
+      vector<CHAR*> lines;
+      vector<size_t> lengths;
+      vector<uint64_t> hashes;
    };
 
-   text_tree_t load_simple_text_tree(const path& path, const load_simple_text_tree_options_t& options)
+   // Verify if the indentation characters are exactly spaces and tabs.
+
+   static bool is_space_and_tab_indent(const wstring& input_indent)
    {
-      wifstream stream(path);
-      return load_simple_text_tree(stream, options);
+      return input_indent == L" \t" || input_indent == L"\t ";
    }
 
-   static std::pair<size_t, size_t> getIndent(const wchar_t* line, size_t count, const load_simple_text_tree_options_t& options)
+   // Clean-up a line in-place with the input filter, keeping the concatenation
+   // of all its matches. Returns false if nothing matched, so the line must be skipped.
+   //
+   // The line is modified in-place since the captured text can never be longer than the line.
+
+   template <class CHAR>
+   static bool filter_input_line(basic_linear_regex_t<CHAR>& input_filter, CHAR* line, size_t& count, basic_string<CHAR>& cleaned_line)
    {
-      const size_t text_index = wcsspn(line, options.input_indent.c_str());
-      size_t indent = text_index;
-      for (size_t i = 0; i < text_index; ++i)
-         if (line[i] == L'\t')
-            indent += options.tab_size - 1;
-      return make_pair(indent, text_index);
-}
+      // Concatenate all matches, stepping over empty matches like regex_iterator.
+      const basic_string_view<CHAR> text(line, count);
+      size_t match_start = 0, match_end = 0;
+      if (!input_filter.find(text, 0, match_start, match_end))
+         return false;
 
-   text_tree_t load_simple_text_tree(wistream& stream, const load_simple_text_tree_options_t& options)
+      cleaned_line.clear();
+      while (true)
+      {
+         cleaned_line.append(text.substr(match_start, match_end - match_start));
+
+         if (match_start != match_end)
+         {
+            if (!input_filter.find(text, match_end, match_start, match_end))
+               break;
+         }
+         else
+         {
+            const size_t pos = match_end;
+            if (pos >= count)
+               break;
+            if (!input_filter.find(text, pos, match_start, match_end, true, true))
+               if (!input_filter.find(text, pos + 1, match_start, match_end))
+                  break;
+         }
+      }
+
+      const size_t cleaned_count = cleaned_line.size();
+      if (cleaned_count < count)
+      {
+         copy(cleaned_line.begin(), cleaned_line.end(), line);
+         line[cleaned_count] = 0;
+         count = cleaned_count;
+      }
+
+      return true;
+   }
+
+   // Read all lines using the given line reader.
+   //
+   // The reader must return writable, null-terminated lines.
+   // Lines are cleaned-up in-place by the input filter since
+   // the captured text can never be longer than the line.
+   //
+   // The indentation measured by the reader while scanning is used
+   // when the indentation is made of spaces and tabs and the lines
+   // are not modified by the input filter.
+
+   template <class CHAR, class READER, class READ_LINE>
+   static read_lines_t<CHAR> read_lines(READER& reader, READ_LINE read_line, const load_simple_text_tree_options_t& options)
    {
-      buffers_text_holder_reader_t reader;
+      const basic_string<CHAR> input_indent = convert_option(options.input_indent, CHAR());
+      const bool use_scanned_indent = options.input_filter.empty() && is_space_and_tab_indent(options.input_indent);
 
-      // Reset the text holder for this private version that can hold extra filtered lines.
-      shared_ptr<buffers_text_holder_with_filtered_lines> holder;
-      wregex input_filter;
+      basic_linear_regex_t<CHAR> input_filter;
       const bool input_filter_used = !options.input_filter.empty();
       if (input_filter_used)
+         input_filter = basic_linear_regex_t<CHAR>(convert_option(options.input_filter, CHAR()));
+
+      read_lines_t<CHAR> read;
+      basic_string<CHAR> cleaned_line;
+      while (true)
       {
-         input_filter = wregex(options.input_filter);
-         reader.holder = holder = make_shared<buffers_text_holder_with_filtered_lines>();
+         auto result = read_line();
+         CHAR* line = result.first;
+         size_t count = result.second;
+         if (count <= 0)
+            break;
+
+         if (input_filter_used && !filter_input_line(input_filter, line, count, cleaned_line))
+            continue;
+
+         const auto [indent, text_index] = use_scanned_indent
+                                         ? make_pair(reader.indent, reader.text_index)
+                                         : getIndent(line, count, input_indent, options);
+
+         read.lines.emplace_back(line + text_index);
+         read.indents.emplace_back(indent);
+         read.lengths.emplace_back(count - text_index);
+
+         // Hash while reading, since chunks are read in parallel.
+         read.hashes.emplace_back(hash_text(basic_string_view<CHAR>(line + text_index, count - text_index)));
       }
 
-      vector<size_t> indents;
-      vector<wchar_t*> lines;
+      return read;
+   }
+
+   // Build the tree from consecutive groups of lines, using their indentation.
+
+   template <class TREE>
+   static TREE build_tree(const vector<read_lines_t<typename TREE::char_t>>& all_read, const shared_ptr<text_holder_t>& holder)
+   {
+      using node = typename TREE::node_t;
+
+      TREE tree;
+
+      tree.source_text_lines = holder;
+
+      vector<size_t> previous_indents;
+      vector<node *> previous_nodes;
+
+      for (const auto& read : all_read)
       {
-         while (true)
+         for (size_t i = 0; i < read.indents.size(); ++i)
          {
-            auto result = reader.read_line(stream);
-            wchar_t* line = result.first;
-            size_t count = result.second;
-            if (count <= 0)
-               break;
+            const size_t new_indent = read.indents[i];
 
-            if (input_filter_used)
+            if (previous_nodes.empty())
             {
-               auto pos = wcregex_iterator(line, line + count, input_filter);
-               auto end = wcregex_iterator();
-               if (pos == end)
-                  continue;
-
-               wstring cleaned_line;
-               for (; pos != end; ++pos)
-                  cleaned_line += pos->str();
-
-               const size_t cleaned_count = cleaned_line.size();
-               if (cleaned_count < count)
-               {
-                  holder->filtered_lines.emplace_back(move(cleaned_line));
-                  line = holder->filtered_lines.back().data();
-                  count = cleaned_count;
-               }
+               previous_indents.emplace_back(new_indent);
+               previous_nodes.emplace_back(nullptr);
             }
 
-            const auto [indent, text_index] = getIndent(line, count, options);
+            size_t previous_indent = previous_indents.back();
+            while (new_indent < previous_indent)
+            {
+               previous_indents.pop_back();
+               previous_nodes.pop_back();
+               previous_indent = previous_indents.back();
+            }
 
-            lines.emplace_back(line + text_index);
-            indents.emplace_back(indent);
+            const auto new_text = read.lines[i];
+            node* addUnder = (new_indent > previous_indent) ? previous_nodes.back()
+                           : previous_nodes.back() ? previous_nodes.back()->parent : nullptr;
+            node * newnode = tree.add_child(addUnder, new_text, read.lengths[i], read.hashes[i]);
+            previous_indents.emplace_back(new_indent);
+            previous_nodes.emplace_back(newnode);
          }
       }
 
-      text_tree_t tree;
+      return tree;
+   }
+
+   // Read the lines of a memory-mapped file and build the tree.
+   //
+   // Large files are split in chunks of lines that are read in parallel,
+   // then the tree is built from all the lines in order.
 
-      tree.source_text_lines = reader.holder;
+   template <class TREE, class READER>
+   static TREE load_mapped_text_tree(READER& reader, const load_simple_text_tree_options_t& options, size_t max_chunk_count = max(1u, thread::hardware_concurrency()))
+   {
+      using CHAR = typename TREE::char_t;
 
-      if (indents.empty())
-         return tree;
+      constexpr size_t min_chunk_size = 4 * 1024 * 1024;
+      max_chunk_count = max<size_t>(1, max_chunk_count);
+      const size_t chunk_count = clamp<size_t>(reader.holder->file.size() / min_chunk_size, 1, max_chunk_count);
 
-      vector<size_t> previous_indents;
-      vector<node *> previous_nodes;
+      reader.tab_size = options.tab_size;
 
-      previous_indents.emplace_back(indents[0]);
-      previous_nodes.emplace_back(nullptr);
+      // The indentation measured while scanning is not decoded when it is used,
+      // since it is not part of the text of the nodes.
+      if constexpr (is_same_v<READER, mapped_text_holder_reader_t>)
+         reader.decode_indentation = !(options.input_filter.empty() && is_space_and_tab_indent(options.input_indent));
 
-      for (size_t i = 0; i < indents.size(); ++i)
-      {
-         const size_t new_indent = indents[i];
+      vector<READER> chunks = reader.split(chunk_count);
 
-         size_t previous_indent = previous_indents.back();
-         while (new_indent < previous_indent)
+      vector<future<read_lines_t<CHAR>>> futures;
+      for (auto& chunk : chunks)
+      {
+         futures.emplace_back(async(launch::async, [&chunk, &options]()
          {
-            previous_indents.pop_back();
-            previous_nodes.pop_back();
-            previous_indent = previous_indents.back();
-         }
+            return read_lines<CHAR>(chunk, [&chunk]() { return chunk.read_line(); }, options);
+         }));
+      }
+
+      vector<read_lines_t<CHAR>> all_read;
+      for (auto& fut : futures)
+         all_read.emplace_back(fut.get());
+
+      return build_tree<TREE>(all_read, reader.holder);
+   }
+
+   text_tree_t load_simple_text_tree(const path& path, const load_simple_text_tree_options_t& options)
+   {
+      return load_simple_text_tree(path, options, max(1u, thread::hardware_concurrency()));
+   }
+
+   text_tree_t load_simple_text_tree(const path& path, const load_simple_text_tree_options_t& options, size_t max_chunk_count)
+   {
+      mapped_text_holder_reader_t reader;
+      if (reader.open(path))
+         return load_mapped_text_tree<text_tree_t>(reader, options, max_chunk_count);
+
+      wifstream stream(path);
+      return load_simple_text_tree(stream, options);
+   }
+
+   text_tree_t load_simple_text_tree(wistream& stream, const load_simple_text_tree_options_t& options)
+   {
+      buffers_text_holder_reader_t reader;
+      reader.tab_size = options.tab_size;
+      auto read = read_lines<wchar_t>(reader, [&reader, &stream]() { return reader.read_line(stream); }, options);
+      return build_tree<text_tree_t>({ move(read) }, reader.holder);
+   }
+
+   // Read the lines one at a time, giving each line and its depth to the function.
+   //
+   // The depths follow the same rules as build_tree, but only the indentation
+   // of the current branch is kept, each line replacing its previous sibling.
+   // The first entry is the indentation of the first line, like in build_tree.
+   //
+   // The branch is given by the caller, so that reading can continue later.
+
+   template <class READER, class READ_LINE>
+   static void read_lines_one_at_a_time(READER& reader, READ_LINE read_line, const read_line_function_t& func, const load_simple_text_tree_options_t& options, vector<size_t>& branch_indents)
+   {
+      const bool use_scanned_indent = options.input_filter.empty() && is_space_and_tab_indent(options.input_indent);
+
+      linear_regex_t input_filter;
+      const bool input_filter_used = !options.input_filter.empty();
+      if (input_filter_used)
+         input_filter = linear_regex_t(options.input_filter);
+
+      wstring cleaned_line;
+      while (true)
+      {
+         auto result = read_line();
+         wchar_t* line = result.first;
+         size_t count = result.second;
+         if (count <= 0)
+            break;
+
+         if (input_filter_used && !filter_input_line(input_filter, line, count, cleaned_line))
+            continue;
+
+         const auto [indent, text_index] = use_scanned_indent
+                                         ? make_pair(reader.indent, reader.text_index)
+                                         : getIndent(line, count, options.input_indent, options);
+
+         if (branch_indents.empty())
+            branch_indents.emplace_back(indent);
+
+         while (branch_indents.size() > 1 && indent < branch_indents.back())
+            branch_indents.pop_back();
 
-         const wchar_t* new_text = lines[i];
-         node* addUnder = (new_indent > previous_indent) ? previous_nodes.back()
-                        : previous_nodes.back() ? previous_nodes.back()->parent : nullptr;
-         node * newnode = tree.add_child(addUnder, new_text);
-         previous_indents.emplace_back(new_indent);
-         previous_nodes.emplace_back(newnode);
+         if (branch_indents.size() == 1 || indent > branch_indents.back())
+            branch_indents.emplace_back(indent);
+
+         if (!func(wstring_view(line + text_index, count - text_index), branch_indents.size() - 2))
+            break;
       }
+   }
 
-      return tree;
+   void read_simple_text_lines(const path& path, const read_line_function_t& func, const load_simple_text_tree_options_t& options)
+   {
+      mapped_text_holder_reader_t reader;
+      reader.keep_read_text = false;
+      reader.tab_size = options.tab_size;
+      if (reader.open(path))
+         return read_simple_text_lines(reader, func, options);
+
+      wifstream stream(path);
+      read_simple_text_lines(stream, func, options);
+   }
+
+   void read_simple_text_lines(mapped_text_holder_reader_t& reader, const read_line_function_t& func, const load_simple_text_tree_options_t& options)
+   {
+      vector<size_t> branch_indents;
+      read_lines_one_at_a_time(reader, [&reader]() { return reader.read_line(); }, func, options, branch_indents);
+   }
+
+   void read_simple_text_lines(wistream& stream, const read_line_function_t& func, const load_simple_text_tree_options_t& options)
+   {
+      buffers_text_holder_reader_t reader;
+      reader.keep_read_buffers = false;
+      reader.tab_size = options.tab_size;
+      vector<size_t> branch_indents;
+      read_lines_one_at_a_time(reader, [&reader, &stream]() { return reader.read_line(stream); }, func, options, branch_indents);
+   }
+
+   bool appended_text_lines_reader_t::read_lines(const path& path, const read_line_function_t& func, const load_simple_text_tree_options_t& options)
+   {
+      // Only read up to the size seen now, the file may still grow while being read.
+      error_code error;
+      const uint64_t file_size = filesystem::file_size(path, error);
+      if (error || file_size < file_position)
+         return false;
+
+      if (file_size == file_position)
+         return true;
+
+      ifstream stream(path, ios::binary);
+      if (!stream || !stream.seekg(streamoff(file_position)))
+         return false;
+
+      constexpr size_t block_size = 1024 * 1024;
+
+      string buffer;
+      uint64_t left = file_size - file_position;
+      bool keep_reading = true;
+      while (left > 0 && keep_reading)
+      {
+         const size_t kept = buffer.size();
+         buffer.resize(kept + size_t(min<uint64_t>(left, block_size)));
+         stream.read(buffer.data() + kept, buffer.size() - kept);
+         const size_t count = size_t(stream.gcount());
+         buffer.resize(kept + count);
+         if (count <= 0)
+            break;
+         left -= count;
+
+         // Only complete lines are read, a partial last line is kept
+         // until the next block or the next read.
+         const size_t line_end = buffer.rfind('\n');
+         if (line_end == string::npos)
+            continue;
+
+         // Skip the UTF-8 byte-order mark.
+         const size_t start = (file_position == 0 && buffer.compare(0, 3, "\xEF\xBB\xBF") == 0) ? 3 : 0;
+
+         mapped_text_holder_reader_t reader;
+         reader.keep_read_text = false;
+         reader.tab_size = options.tab_size;
+         reader.pos_in_file = buffer.data() + start;
+         reader.file_end = buffer.data() + line_end + 1;
+
+         auto read_line = [&func, &keep_reading](wstring_view text, size_t depth) { return keep_reading = func(text, depth); };
+         read_lines_one_at_a_time(reader, [&reader]() { return reader.read_line(); }, read_line, options, branch_indents);
+
+         file_position += line_end + 1;
+         buffer.erase(0, line_end + 1);
+      }
+
+      return true;
+   }
+
+   utf8_text_tree_t load_utf8_text_tree(const path& path, const load_simple_text_tree_options_t& options)
+   {
+      mapped_utf8_text_holder_reader_t reader;
+      if (!reader.open(path))
+         return utf8_text_tree_t();
+
+      return load_mapped_text_tree<utf8_text_tree_t>(reader, options);
    }
 }
@@ -14,7 +14,7 @@ namespace dak::tree_reader
          for (size_t indent = 0; indent < level; ++indent)
             stream << indentation;
 
-         stream << node.text_ptr << L"\n";
+         stream << node.text() << L"\n";
 
          return tree_visitor_t::result_t();
       });
@@ -26,6 +26,25 @@ namespace dak::tree_reader
       return print_tree(stream, tree);
    }
 
+   ostream& print_tree(ostream& stream, const utf8_text_tree_t& tree, const string& indentation)
+   {
+      visit_in_order(tree, [&stream, &indentation](const utf8_text_tree_t& tree, const utf8_text_tree_t::node_t& node, size_t level)
+      {
+         for (size_t indent = 0; indent < level; ++indent)
+            stream << indentation;
+
+         stream << node.text() << "\n";
+
+         return tree_visitor_t::result_t();
+      });
+      return stream;
+   }
+
+   ostream& operator<<(ostream& stream, const utf8_text_tree_t& tree)
+   {
+      return print_tree(stream, tree);
+   }
+
    void save_simple_text_tree(const std::filesystem::path& path, const text_tree_t& tree, const std::wstring& indentation)
    {
       wofstream stream(path);
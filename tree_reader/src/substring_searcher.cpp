@@ -0,0 +1,169 @@
+#include "dak/tree_reader/substring_searcher.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+   #define DAK_TREE_READER_X86
+   #include <immintrin.h>
+   #ifdef _MSC_VER
+      #define DAK_SSE2_FUNCTION
+   #else
+      #define DAK_SSE2_FUNCTION __attribute__((target("sse2")))
+   #endif
+#endif
+
+namespace dak::tree_reader
+{
+   using namespace std;
+
+   namespace
+   {
+      // Needles longer than this use the Horspool skips.
+      constexpr size_t max_first_last_length = 32;
+
+      template <class CHAR>
+      bool is_same_text(const CHAR* lhs, const CHAR* rhs, size_t count)
+      {
+         return memcmp(lhs, rhs, count * sizeof(CHAR)) == 0;
+      }
+
+   #ifdef DAK_TREE_READER_X86
+
+      template <class CHAR>
+      DAK_SSE2_FUNCTION __m128i equal(__m128i block, CHAR c)
+      {
+         if constexpr (sizeof(CHAR) == 1)
+            return _mm_cmpeq_epi8(block, _mm_set1_epi8(char(c)));
+         else if constexpr (sizeof(CHAR) == 2)
+            return _mm_cmpeq_epi16(block, _mm_set1_epi16(short(c)));
+         else
+            return _mm_cmpeq_epi32(block, _mm_set1_epi32(int(c)));
+      }
+
+      // Compare the first and last characters of the needle with a block
+      // of positions at once, then verify the middle of the candidates.
+      //
+      // Returns the position of the needle or the first position not
+      // verified, which the caller must search without SIMD.
+
+      template <class CHAR>
+      DAK_SSE2_FUNCTION size_t find_first_last(const CHAR* text, size_t size, const CHAR* needle, size_t needle_size, bool& found)
+      {
+         constexpr size_t block_count = 16 / sizeof(CHAR);
+         constexpr uint32_t char_mask = (1u << sizeof(CHAR)) - 1;
+
+         const size_t last = needle_size - 1;
+         size_t pos = 0;
+         while (pos + last + block_count <= size)
+         {
+            const __m128i firsts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos));
+            const __m128i lasts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + pos + last));
+            uint32_t mask = uint32_t(_mm_movemask_epi8(_mm_and_si128(equal(firsts, needle[0]), equal(lasts, needle[last]))));
+            while (mask)
+            {
+               const size_t byte_index = countr_zero(mask);
+               const size_t candidate = pos + byte_index / sizeof(CHAR);
+               if (is_same_text(text + candidate + 1, needle + 1, needle_size - 2))
+               {
+                  found = true;
+                  return candidate;
+               }
+               mask &= ~(char_mask << byte_index);
+            }
+            pos += block_count;
+         }
+
+         found = false;
+         return pos;
+      }
+
+   #endif
+   }
+
+   template <class CHAR>
+   basic_substring_searcher_t<CHAR>::basic_substring_searcher_t(string_view_t needle)
+   : _needle(needle)
+   {
+      if (needle.empty())
+      {
+         _method = method_t::empty;
+      }
+      else if (needle.size() == 1)
+      {
+         _method = method_t::single;
+      }
+      else if (needle.size() <= max_first_last_length)
+      {
+         _method = method_t::first_last;
+      }
+      else
+      {
+         _method = method_t::horspool;
+
+         // Characters sharing the same low byte share the same skip,
+         // so the smallest skip is kept.
+         const size_t last = needle.size() - 1;
+         _skips.assign(256, uint32_t(needle.size()));
+         for (size_t i = 0; i < last; ++i)
+         {
+            uint32_t& skip = _skips[uint8_t(needle[i])];
+            skip = min(skip, uint32_t(last - i));
+         }
+      }
+   }
+
+   template <class CHAR>
+   size_t basic_substring_searcher_t<CHAR>::find(string_view_t text) const
+   {
+      const size_t needle_size = _needle.size();
+      if (text.size() < needle_size)
+         return string_view_t::npos;
+
+      switch (_method)
+      {
+         case method_t::empty:
+            return 0;
+
+         case method_t::single:
+         {
+            const CHAR* found = char_traits<CHAR>::find(text.data(), text.size(), _needle[0]);
+            return found ? size_t(found - text.data()) : string_view_t::npos;
+         }
+
+         case method_t::first_last:
+         {
+            size_t pos = 0;
+         #ifdef DAK_TREE_READER_X86
+            bool found = false;
+            pos = find_first_last(text.data(), text.size(), _needle.data(), needle_size, found);
+            if (found)
+               return pos;
+         #endif
+            return text.find(_needle, pos);
+         }
+
+         case method_t::horspool:
+         {
+            const CHAR* data = text.data();
+            const CHAR* needle = _needle.data();
+            const size_t last = needle_size - 1;
+            const CHAR last_char = needle[last];
+            for (size_t pos = 0; pos + needle_size <= text.size(); )
+            {
+               const CHAR c = data[pos + last];
+               if (c == last_char && is_same_text(data + pos, needle, last))
+                  return pos;
+               pos += _skips[uint8_t(c)];
+            }
+            return string_view_t::npos;
+         }
+      }
+
+      return string_view_t::npos;
+   }
+
+   template struct basic_substring_searcher_t<char>;
+   template struct basic_substring_searcher_t<wchar_t>;
+}
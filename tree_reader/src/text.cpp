@@ -38,6 +38,52 @@ namespace dak::utility
       return result;
    }
 
+   string to_utf8(const wstring& text)
+   {
+      string result;
+      result.reserve(text.size());
+
+      for (size_t i = 0; i < text.size(); ++i)
+      {
+         char32_t c = char32_t(text[i]);
+
+         // Combine UTF-16 surrogate pairs.
+         if constexpr (sizeof(wchar_t) == 2)
+         {
+            if (c >= 0xD800 && c <= 0xDBFF && i + 1 < text.size() && text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF)
+            {
+               c = 0x10000 + ((c - 0xD800) << 10) + (char32_t(text[i + 1]) - 0xDC00);
+               ++i;
+            }
+         }
+
+         if (c < 0x80)
+         {
+            result += char(c);
+         }
+         else if (c < 0x800)
+         {
+            result += char(0xC0 | (c >> 6));
+            result += char(0x80 | (c & 0x3F));
+         }
+         else if (c < 0x10000)
+         {
+            result += char(0xE0 | (c >> 12));
+            result += char(0x80 | ((c >> 6) & 0x3F));
+            result += char(0x80 | (c & 0x3F));
+         }
+         else
+         {
+            result += char(0xF0 | (c >> 18));
+            result += char(0x80 | ((c >> 12) & 0x3F));
+            result += char(0x80 | ((c >> 6) & 0x3F));
+            result += char(0x80 | (c & 0x3F));
+         }
+      }
+
+      return result;
+   }
+
    void with_no_exceptions(const std::function<void()>& func)
    {
       try
@@ -0,0 +1,162 @@
+#include "dak/tree_reader/text_hash.h"
+
+#include <cstring>
+#include <cwchar>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+namespace dak::tree_reader
+{
+   using namespace std;
+
+   namespace
+   {
+      constexpr uint64_t secret[4] = { 0xa0761d6478bd642full, 0xe7037ed1a0b428dbull, 0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull };
+
+      // Multiply into 128 bits, returning the low bits in a and the high bits in b.
+      void multiply(uint64_t& a, uint64_t& b)
+      {
+#if defined(__SIZEOF_INT128__)
+         const unsigned __int128 product = (unsigned __int128)a * b;
+         a = uint64_t(product);
+         b = uint64_t(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+         a = _umul128(a, b, &b);
+#else
+         const uint64_t a_high = a >> 32, a_low = uint32_t(a);
+         const uint64_t b_high = b >> 32, b_low = uint32_t(b);
+         const uint64_t high_high = a_high * b_high, high_low = a_high * b_low;
+         const uint64_t low_high = a_low * b_high, low_low = a_low * b_low;
+         const uint64_t middle = (low_low >> 32) + uint32_t(high_low) + uint32_t(low_high);
+         a = (middle << 32) | uint32_t(low_low);
+         b = high_high + (high_low >> 32) + (low_high >> 32) + (middle >> 32);
+#endif
+      }
+
+      uint64_t mix(uint64_t a, uint64_t b)
+      {
+         multiply(a, b);
+         return a ^ b;
+      }
+
+      uint64_t read_8(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+      uint64_t read_4(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+      uint64_t read_3(const uint8_t* p, size_t k) { return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1]; }
+
+      uint64_t hash_bytes(const void* key, size_t length)
+      {
+         const uint8_t* p = static_cast<const uint8_t*>(key);
+         uint64_t seed = mix(secret[0], secret[1]);
+         uint64_t a = 0, b = 0;
+
+         if (length <= 16)
+         {
+            if (length >= 4)
+            {
+               a = (read_4(p) << 32) | read_4(p + ((length >> 3) << 2));
+               b = (read_4(p + length - 4) << 32) | read_4(p + length - 4 - ((length >> 3) << 2));
+            }
+            else if (length > 0)
+            {
+               a = read_3(p, length);
+            }
+         }
+         else
+         {
+            size_t i = length;
+            if (i > 48)
+            {
+               uint64_t seed_1 = seed, seed_2 = seed;
+               do
+               {
+                  seed   = mix(read_8(p)      ^ secret[1], read_8(p + 8)  ^ seed);
+                  seed_1 = mix(read_8(p + 16) ^ secret[2], read_8(p + 24) ^ seed_1);
+                  seed_2 = mix(read_8(p + 32) ^ secret[3], read_8(p + 40) ^ seed_2);
+                  p += 48;
+                  i -= 48;
+               }
+               while (i > 48);
+               seed ^= seed_1 ^ seed_2;
+            }
+
+            while (i > 16)
+            {
+               seed = mix(read_8(p) ^ secret[1], read_8(p + 8) ^ seed);
+               i -= 16;
+               p += 16;
+            }
+
+            a = read_8(p + i - 16);
+            b = read_8(p + i - 8);
+         }
+
+         a ^= secret[1];
+         b ^= seed;
+         multiply(a, b);
+         return mix(a ^ secret[0] ^ length, b ^ secret[1]);
+      }
+   }
+
+   uint64_t hash_text(wstring_view text)
+   {
+      return hash_bytes(text.data(), text.size() * sizeof(wchar_t));
+   }
+
+   uint64_t hash_text(string_view text)
+   {
+      return hash_bytes(text.data(), text.size());
+   }
+
+   bool text_hash_set_t::insert(wstring_view text, uint64_t hash)
+   {
+      // Keep at most half the slots used.
+      if ((_entries.size() + 1) * 2 > _slots.size())
+         grow();
+
+      const size_t mask = _slots.size() - 1;
+      const uint32_t hash_check = uint32_t(hash >> 32);
+      for (size_t index = size_t(hash) & mask; ; index = (index + 1) & mask)
+      {
+         slot_t& slot = _slots[index];
+         if (!slot.text)
+         {
+            _entries.push_back(entry_t{ text, hash });
+            slot.text = uint32_t(_entries.size());
+            slot.hash = hash_check;
+            return true;
+         }
+
+         if (slot.hash != hash_check)
+            continue;
+
+         const wstring_view other = _entries[slot.text - 1].text;
+         if (other.size() == text.size() && wmemcmp(other.data(), text.data(), text.size()) == 0)
+            return false;
+      }
+   }
+
+   void text_hash_set_t::grow()
+   {
+      const size_t new_size = _slots.empty() ? 64 : _slots.size() * 2;
+      _slots.assign(new_size, slot_t());
+
+      const size_t mask = new_size - 1;
+      for (size_t entry = 0; entry < _entries.size(); ++entry)
+      {
+         const uint64_t hash = _entries[entry].hash;
+         size_t index = size_t(hash) & mask;
+         while (_slots[index].text)
+            index = (index + 1) & mask;
+         _slots[index].text = uint32_t(entry + 1);
+         _slots[index].hash = uint32_t(hash >> 32);
+      }
+   }
+
+   void text_hash_set_t::clear()
+   {
+      _slots.clear();
+      _entries.clear();
+   }
+}
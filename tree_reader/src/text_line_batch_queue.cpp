@@ -0,0 +1,84 @@
+#include "dak/tree_reader/text_line_batch_queue.h"
+
+#include <algorithm>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+
+   void text_line_batch_t::add_line(wstring_view text, size_t depth)
+   {
+      lines.push_back({ texts.size(), text.size(), depth });
+      texts.append(text);
+   }
+
+   void text_line_batch_t::clear()
+   {
+      texts.clear();
+      lines.clear();
+   }
+
+   text_line_batch_queue_t::text_line_batch_queue_t(size_t capacity)
+      : _batches(max<size_t>(capacity, 1))
+   {
+   }
+
+   bool text_line_batch_queue_t::push(text_line_batch_t& batch)
+   {
+      // Only the producer changes the pushed count.
+      const size_t pushed = _pushed.load(memory_order_relaxed) & ~done_flag;
+
+      while (true)
+      {
+         const size_t popped = _popped.load(memory_order_acquire);
+         if (popped & done_flag)
+            return false;
+         if (pushed - popped < _batches.size())
+            break;
+         _popped.wait(popped, memory_order_acquire);
+      }
+
+      swap(_batches[pushed % _batches.size()], batch);
+      batch.clear();
+
+      _pushed.store(pushed + 1, memory_order_release);
+      _pushed.notify_one();
+
+      return true;
+   }
+
+   bool text_line_batch_queue_t::pop(text_line_batch_t& batch)
+   {
+      // Only the consumer changes the popped count.
+      const size_t popped = _popped.load(memory_order_relaxed) & ~done_flag;
+
+      while (true)
+      {
+         const size_t pushed = _pushed.load(memory_order_acquire);
+         if ((pushed & ~done_flag) != popped)
+            break;
+         if (pushed & done_flag)
+            return false;
+         _pushed.wait(pushed, memory_order_acquire);
+      }
+
+      swap(_batches[popped % _batches.size()], batch);
+
+      _popped.store(popped + 1, memory_order_release);
+      _popped.notify_one();
+
+      return true;
+   }
+
+   void text_line_batch_queue_t::close()
+   {
+      _pushed.fetch_or(done_flag, memory_order_release);
+      _pushed.notify_one();
+   }
+
+   void text_line_batch_queue_t::cancel()
+   {
+      _popped.fetch_or(done_flag, memory_order_release);
+      _popped.notify_one();
+   }
+}
@@ -0,0 +1,251 @@
+#include "dak/tree_reader/text_subtree_sketch.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/tree_filter_helpers.h"
+#include "dak/tree_reader/named_filters.h"
+
+#include <algorithm>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+   using sketch_t = text_subtree_sketches_t::sketch_t;
+
+   namespace
+   {
+      constexpr size_t trigram_length = 3;
+      constexpr size_t sketch_bits = text_subtree_sketches_t::sketch_words * 64;
+
+      // Add the trigrams of a text to a sketch, one bit per trigram.
+      void add_to_sketch(wstring_view text, sketch_t& sketch)
+      {
+         if (text.size() < trigram_length)
+            return;
+
+         constexpr uint64_t mask = 0x1FFFFF;
+         for (size_t pos = 0; pos + trigram_length <= text.size(); ++pos)
+         {
+            const uint64_t key = ((uint64_t(text[pos]) & mask) << 42) | ((uint64_t(text[pos + 1]) & mask) << 21) | (uint64_t(text[pos + 2]) & mask);
+            const size_t bit = size_t((key * 0x9E3779B97F4A7C15ull) >> 56) % sketch_bits;
+            sketch[bit / 64] |= uint64_t(1) << (bit % 64);
+         }
+      }
+
+      void merge_sketch(const sketch_t& from, sketch_t& into)
+      {
+         for (size_t word = 0; word < from.size(); ++word)
+            into[word] |= from[word];
+      }
+
+      bool is_empty_sketch(const sketch_t& sketch)
+      {
+         return all_of(sketch.begin(), sketch.end(), [](uint64_t word) { return word == 0; });
+      }
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Sketches.
+
+   text_subtree_sketches_t::text_subtree_sketches_t(const text_tree_t& tree, const atomic<bool>* abort)
+   {
+      const size_t size = tree.size();
+
+      _sketch_indexes.assign(size, no_sketch);
+      for (size_t index = 0; index < size; ++index)
+      {
+         if (tree.node(index).children.empty())
+            continue;
+
+         _sketch_indexes[index] = uint32_t(_sketches.size());
+         _sketches.emplace_back();
+      }
+
+      // Children are always added after their parent, so going through
+      // the nodes in reverse completes a sketch before merging it into
+      // the sketch of the parent.
+      for (size_t index = size; index > 0; --index)
+      {
+         if (abort && *abort)
+         {
+            _sketch_indexes.clear();
+            _sketches.clear();
+            return;
+         }
+
+         const auto& node = tree.node(index - 1);
+         const uint32_t parent_sketch = node.parent ? _sketch_indexes[node.parent->index] : no_sketch;
+         const uint32_t node_sketch = _sketch_indexes[index - 1];
+         if (node_sketch != no_sketch)
+         {
+            add_to_sketch(node.text(), _sketches[node_sketch]);
+            if (parent_sketch != no_sketch)
+               merge_sketch(_sketches[node_sketch], _sketches[parent_sketch]);
+         }
+         else if (parent_sketch != no_sketch)
+         {
+            add_to_sketch(node.text(), _sketches[parent_sketch]);
+         }
+      }
+
+      _sketches.shrink_to_fit();
+
+      _tree = &tree;
+      _tree_size = size;
+   }
+
+   sketch_t text_subtree_sketches_t::sketch_text(wstring_view text)
+   {
+      sketch_t sketch = {};
+      add_to_sketch(text, sketch);
+      return sketch;
+   }
+
+   bool text_subtree_sketches_t::may_contain(const text_tree_t::node_t& node, const sketch_t& text) const
+   {
+      if (node.index >= _sketch_indexes.size())
+         return true;
+
+      const uint32_t node_sketch = _sketch_indexes[node.index];
+      if (node_sketch == no_sketch)
+         return true;
+
+      const sketch_t& sketch = _sketches[node_sketch];
+      for (size_t word = 0; word < sketch.size(); ++word)
+         if ((sketch[word] & text[word]) != text[word])
+            return false;
+
+      return true;
+   }
+
+   async_subtree_sketches_t build_subtree_sketches_async(const text_tree_ptr_t& tree)
+   {
+      if (!tree)
+         return {};
+
+      auto abort = make_shared<atomic<bool>>(false);
+      auto fut = async(launch::async, [tree, abort]() -> text_subtree_sketches_ptr_t
+      {
+         return make_shared<text_subtree_sketches_t>(*tree, abort.get());
+      });
+
+      return make_pair(move(fut), abort);
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Sub-tree pruning.
+
+   subtree_pruner_t::subtree_pruner_t(const tree_filter_t& filter, const text_tree_t& tree)
+   {
+      if (!tree.subtree_sketches || !tree.subtree_sketches->is_of(tree))
+         return;
+
+      if (!is_stateless_filter(filter))
+         return;
+
+      vector<const tree_filter_t*> named_in_progress;
+      add_term(&filter, named_in_progress);
+      if (_terms[0].kind == term_kind_t::any_node)
+      {
+         _terms.clear();
+         return;
+      }
+
+      _sketches = tree.subtree_sketches;
+   }
+
+   uint32_t subtree_pruner_t::add_term(const tree_filter_t* filter, vector<const tree_filter_t*>& named_in_progress)
+   {
+      const uint32_t index = uint32_t(_terms.size());
+      _terms.emplace_back();
+
+      if (auto named = dynamic_cast<const named_tree_filter_t*>(filter))
+      {
+         if (!named->filter || find(named_in_progress.begin(), named_in_progress.end(), named) != named_in_progress.end())
+            return index;
+
+         named_in_progress.emplace_back(named);
+         const uint32_t sub_term = add_term(named->filter.get(), named_in_progress);
+         named_in_progress.pop_back();
+
+         if (_terms[sub_term].kind != term_kind_t::any_node)
+         {
+            _terms[index].kind = term_kind_t::all;
+            _terms[index].sub_terms.emplace_back(sub_term);
+         }
+         return index;
+      }
+
+      wstring text;
+      if (auto contains = dynamic_cast<const contains_tree_filter_t*>(filter))
+         text = contains->contained;
+      else if (auto regex = dynamic_cast<const regex_tree_filter_t*>(filter))
+         text = regex->regex.required_text();
+
+      if (!text.empty())
+      {
+         const sketch_t sketch = text_subtree_sketches_t::sketch_text(text);
+         if (!is_empty_sketch(sketch))
+         {
+            _terms[index].kind = term_kind_t::text;
+            _terms[index].sketch = sketch;
+         }
+         return index;
+      }
+
+      const bool is_all = dynamic_cast<const and_tree_filter_t*>(filter) != nullptr;
+      const bool is_any = dynamic_cast<const or_tree_filter_t*>(filter) != nullptr;
+      if (!is_all && !is_any)
+         return index;
+
+      vector<uint32_t> sub_terms;
+      for (const auto& child : static_cast<const combine_tree_filter_t*>(filter)->filters)
+      {
+         if (!child)
+            continue;
+
+         const uint32_t sub_term = add_term(child.get(), named_in_progress);
+         const bool may_keep_all = (_terms[sub_term].kind == term_kind_t::any_node);
+
+         // An and is as selective as any of its children,
+         // while an or may keep any node if one of its children may.
+         if (is_any && may_keep_all)
+            return index;
+
+         if (!may_keep_all)
+            sub_terms.emplace_back(sub_term);
+      }
+
+      if (!sub_terms.empty())
+      {
+         _terms[index].kind = is_all ? term_kind_t::all : term_kind_t::any;
+         _terms[index].sub_terms = move(sub_terms);
+      }
+
+      return index;
+   }
+
+   bool subtree_pruner_t::may_keep(uint32_t term, const text_tree_t::node_t& node) const
+   {
+      const term_t& current = _terms[term];
+      switch (current.kind)
+      {
+         case term_kind_t::any_node:
+            return true;
+         case term_kind_t::text:
+            return _sketches->may_contain(node, current.sketch);
+         case term_kind_t::all:
+            for (const uint32_t sub_term : current.sub_terms)
+               if (!may_keep(sub_term, node))
+                  return false;
+            return true;
+         case term_kind_t::any:
+            for (const uint32_t sub_term : current.sub_terms)
+               if (may_keep(sub_term, node))
+                  return true;
+            return false;
+      }
+
+      return true;
+   }
+}
@@ -4,16 +4,52 @@ namespace dak::tree_reader
 {
    using namespace std;
 
-   void text_tree_t::reset()
+   template <class CHAR>
+   basic_text_tree_t<CHAR>::basic_text_tree_t(const basic_text_tree_t& other)
+   : source_text_lines(other.source_text_lines)
+   {
+      // Each node comes after its parent and its earlier siblings,
+      // so adding them in order gives the same tree.
+      for (size_t index = 0; index < other.size(); ++index)
+      {
+         const node_t& a_node = other.node(index);
+         add_child(a_node.parent ? &_nodes[a_node.parent->index] : nullptr, a_node.text_ptr, a_node.text_length, a_node.text_hash);
+      }
+   }
+
+   template <class CHAR>
+   basic_text_tree_t<CHAR>& basic_text_tree_t<CHAR>::operator=(const basic_text_tree_t& other)
+   {
+      if (this != &other)
+         *this = basic_text_tree_t(other);
+      return *this;
+   }
+
+   template <class CHAR>
+   void basic_text_tree_t<CHAR>::reset()
    {
       roots.clear();
       _nodes.clear();
    }
 
-   text_tree_t::node_t* text_tree_t::add_child(node_t* undernode, const wchar_t* text)
+   template <class CHAR>
+   typename basic_text_tree_t<CHAR>::node_t* basic_text_tree_t<CHAR>::add_child(node_t* undernode, const CHAR* text)
+   {
+      return add_child(undernode, text, char_traits<CHAR>::length(text));
+   }
+
+   template <class CHAR>
+   typename basic_text_tree_t<CHAR>::node_t* basic_text_tree_t<CHAR>::add_child(node_t* undernode, const CHAR* text, size_t length)
    {
-      _nodes.emplace_back(text, undernode);
+      return add_child(undernode, text, length, hash_text(basic_string_view<CHAR>(text, length)));
+   }
+
+   template <class CHAR>
+   typename basic_text_tree_t<CHAR>::node_t* basic_text_tree_t<CHAR>::add_child(node_t* undernode, const CHAR* text, size_t length, uint64_t hash)
+   {
+      _nodes.emplace_back(text, length, hash, undernode);
       node_t* newnode = &_nodes.back();
+      newnode->index = _nodes.size() - 1;
       if (!undernode)
       {
          newnode->index_in_parent = roots.size();
@@ -27,7 +63,20 @@ namespace dak::tree_reader
       return newnode;
    }
 
-   size_t text_tree_t::count_siblings(const node_t* node) const
+   template <class CHAR>
+   void basic_text_tree_t<CHAR>::remove_last_node()
+   {
+      if (_nodes.empty())
+         return;
+
+      node_t& last = _nodes.back();
+      std::vector<node_t*>& siblings = last.parent ? last.parent->children : roots;
+      siblings.pop_back();
+      _nodes.pop_back();
+   }
+
+   template <class CHAR>
+   size_t basic_text_tree_t<CHAR>::count_siblings(const node_t* node) const
    {
       if (!node)
          return 0;
@@ -35,7 +84,8 @@ namespace dak::tree_reader
       return count_children(node->parent);
    }
 
-   size_t text_tree_t::count_children(const node_t* node) const
+   template <class CHAR>
+   size_t basic_text_tree_t<CHAR>::count_children(const node_t* node) const
    {
       if (!node)
          return roots.size();
@@ -43,19 +93,15 @@ namespace dak::tree_reader
       return node->children.size();
    }
 
-   size_t text_tree_t::count_ancestors(const node_t* node) const
+   template <class CHAR>
+   size_t basic_text_tree_t<CHAR>::count_ancestors(const node_t* node) const
    {
       if (!node)
          return 0;
 
-      size_t count = 0;
-
-      while (node->parent)
-      {
-         count += 1;
-         node = node->parent;
-      }
-
-      return count;
+      return node->depth;
    }
+
+   template struct basic_text_tree_t<wchar_t>;
+   template struct basic_text_tree_t<char>;
 }
@@ -0,0 +1,208 @@
+#include "dak/tree_reader/text_tree_follower.h"
+#include "dak/tree_reader/buffers_text_holder.h"
+
+#ifdef __linux__
+   #include <sys/inotify.h>
+   #include <poll.h>
+   #include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <thread>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+   using node = text_tree_t::node_t;
+
+   namespace
+   {
+      // Holds the text of the appended lines, one buffer per update,
+      // and the text the tree was loaded with.
+      struct followed_text_holder_t : buffers_text_holder_t
+      {
+         shared_ptr<text_holder_t> loaded_text;
+      };
+   }
+
+   text_tree_follower_t::text_tree_follower_t(const filesystem::path& path, const text_tree_ptr_t& tree, const load_simple_text_tree_options_t& options)
+      : _path(path), _tree(tree), _options(options)
+   {
+   #ifdef __linux__
+      _notify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (_notify >= 0 && ::inotify_add_watch(_notify, path.c_str(), IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF) < 0)
+      {
+         ::close(_notify);
+         _notify = -1;
+      }
+   #endif
+
+      has_file_info_changed();
+
+      // Skip the lines already in the tree, keeping the indentation of their branch,
+      // then add the lines appended since the tree was loaded.
+      size_t skipped = 0;
+      const size_t tree_size = _tree ? _tree->size() : 0;
+      const node* last_node = tree_size > 0 ? &_tree->node(tree_size - 1) : nullptr;
+      bool last_line_changed = false;
+
+      text_line_batch_t appended;
+      _truncated = !_reader.read_lines(_path, [&skipped, tree_size, last_node, &last_line_changed, &appended](wstring_view text, size_t depth)
+      {
+         if (skipped < tree_size)
+         {
+            ++skipped;
+            if (skipped == tree_size && text != last_node->text())
+            {
+               last_line_changed = true;
+               appended.add_line(text, depth);
+            }
+         }
+         else
+         {
+            appended.add_line(text, depth);
+         }
+         return true;
+      }, _options);
+
+      // The tree may have been loaded while its last line was being written.
+      // Only complete lines are read, so that line is replaced once it is complete,
+      // which it may already be.
+      if (_tree && !_truncated)
+      {
+         error_code size_error;
+         const uintmax_t file_size = filesystem::file_size(_path, size_error);
+         if (last_line_changed)
+            _tree->remove_last_node();
+         else if (skipped + 1 == tree_size && !size_error && file_size > _reader.file_position)
+            _last_line_incomplete = true;
+      }
+
+      set_branch_to_last_node();
+      add_lines(appended);
+   }
+
+   text_tree_follower_t::~text_tree_follower_t()
+   {
+   #ifdef __linux__
+      if (_notify >= 0)
+         ::close(_notify);
+   #endif
+   }
+
+   bool text_tree_follower_t::has_file_info_changed()
+   {
+      error_code size_error, time_error;
+      const uintmax_t size = filesystem::file_size(_path, size_error);
+      const auto time = filesystem::last_write_time(_path, time_error);
+      if (size_error || time_error)
+         return false;
+
+      const bool changed = (size != _file_size || time != _file_time);
+      _file_size = size;
+      _file_time = time;
+      return changed;
+   }
+
+   bool text_tree_follower_t::wait_for_change(chrono::milliseconds timeout)
+   {
+   #ifdef __linux__
+      if (_notify >= 0)
+      {
+         pollfd notified = { _notify, POLLIN, 0 };
+         if (::poll(&notified, 1, int(timeout.count())) <= 0)
+            return false;
+
+         // Drop the events, only knowing that the file changed matters.
+         char events[4096];
+         while (::read(_notify, events, sizeof(events)) > 0)
+            ;
+         return true;
+      }
+   #endif
+
+      const auto end = chrono::steady_clock::now() + timeout;
+      while (!has_file_info_changed())
+      {
+         const auto now = chrono::steady_clock::now();
+         if (now >= end)
+            return false;
+         this_thread::sleep_for(min<chrono::steady_clock::duration>(poll_interval, end - now));
+      }
+      return true;
+   }
+
+   size_t text_tree_follower_t::append_new_lines()
+   {
+      if (!_tree || _truncated)
+         return 0;
+
+      text_line_batch_t appended;
+      _truncated = !_reader.read_lines(_path, [&appended](wstring_view text, size_t depth)
+      {
+         appended.add_line(text, depth);
+         return true;
+      }, _options);
+
+      // The first complete line is the incomplete last line of the tree.
+      if (_last_line_incomplete && !appended.empty())
+      {
+         _tree->remove_last_node();
+         set_branch_to_last_node();
+         _last_line_incomplete = false;
+         _last_node_replaced = true;
+      }
+
+      return add_lines(appended);
+   }
+
+   bool text_tree_follower_t::was_last_node_replaced()
+   {
+      const bool replaced = _last_node_replaced;
+      _last_node_replaced = false;
+      return replaced;
+   }
+
+   void text_tree_follower_t::set_branch_to_last_node()
+   {
+      _branch.clear();
+      if (_tree)
+         for (node* a_node = _tree->roots.empty() ? nullptr : _tree->roots.back(); a_node; a_node = a_node->children.empty() ? nullptr : a_node->children.back())
+            _branch.emplace_back(a_node);
+   }
+
+   size_t text_tree_follower_t::add_lines(const text_line_batch_t& appended)
+   {
+      if (!_tree || appended.empty())
+         return 0;
+
+      // Keep the text of the appended lines in a single buffer, null-terminated.
+      auto holder = dynamic_pointer_cast<followed_text_holder_t>(_tree->source_text_lines);
+      if (!holder)
+      {
+         holder = make_shared<followed_text_holder_t>();
+         holder->loaded_text = _tree->source_text_lines;
+         _tree->source_text_lines = holder;
+      }
+
+      auto buffer = make_shared<buffers_text_holder_t::buffer>(appended.texts.size() + appended.size());
+      holder->text_buffers.emplace_back(buffer);
+
+      wchar_t* text = buffer->data();
+      for (const auto& line : appended.lines)
+      {
+         const wstring_view line_text = appended.text(line);
+         copy(line_text.begin(), line_text.end(), text);
+         text[line_text.size()] = 0;
+
+         // note: the depth can only be deeper than the branch if the file was modified.
+         const size_t depth = min(line.depth, _branch.size());
+         _branch.resize(depth);
+         _branch.emplace_back(_tree->add_child(depth > 0 ? _branch.back() : nullptr, text, line_text.size()));
+
+         text += line_text.size() + 1;
+      }
+
+      return appended.size();
+   }
+}
@@ -0,0 +1,249 @@
+#include "dak/tree_reader/text_tree_snapshot.h"
+#include "dak/tree_reader/mapped_text_holder.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+   using node = text_tree_t::node_t;
+
+   namespace
+   {
+      constexpr char snapshot_magic[8] = { 'D', 'A', 'K', 'T', 'R', 'E', 'E', 'S' };
+      constexpr uint32_t snapshot_version = 2;
+      constexpr uint32_t no_node = UINT32_MAX;
+
+      struct snapshot_header_t
+      {
+         char magic[8];
+         uint32_t version;
+
+         // The size of the characters, since wide characters differ between platforms.
+         uint32_t char_size;
+
+         uint64_t source_size;
+         int64_t source_time;
+         uint64_t options_hash;
+
+         uint64_t node_count;
+         uint64_t text_count;
+
+         uint32_t has_hashes;
+         uint32_t reserved;
+      };
+
+      // The position of each array in the snapshot, each aligned on 8 bytes.
+      struct snapshot_layout_t
+      {
+         size_t parents;
+         size_t text_offsets;
+         size_t text_lengths;
+         size_t text_hashes;
+         size_t texts;
+         size_t size;
+
+         snapshot_layout_t(uint64_t node_count, uint64_t text_count, bool has_hashes)
+         {
+            size_t pos = sizeof(snapshot_header_t);
+            parents        = place(pos, node_count * sizeof(uint32_t));
+            text_offsets   = place(pos, node_count * sizeof(uint64_t));
+            text_lengths   = place(pos, node_count * sizeof(uint32_t));
+            text_hashes    = place(pos, has_hashes ? node_count * sizeof(uint64_t) : 0);
+            texts          = place(pos, text_count * sizeof(wchar_t));
+            size = pos;
+         }
+
+      private:
+         static size_t place(size_t& pos, size_t size)
+         {
+            const size_t start = pos;
+            pos = (pos + size + 7) & ~size_t(7);
+            return start;
+         }
+      };
+
+      // Identify the reading options, since they change the loaded tree.
+      uint64_t hash_options(const load_simple_text_tree_options_t& options)
+      {
+         const wstring text = to_wstring(options.tab_size) + L'\n' + options.input_indent + L'\n' + options.input_filter;
+         return hash_text(text);
+      }
+
+      bool get_source_info(const filesystem::path& source_path, uint64_t& size, int64_t& time)
+      {
+         error_code error;
+         size = filesystem::file_size(source_path, error);
+         if (error)
+            return false;
+
+         const auto write_time = filesystem::last_write_time(source_path, error);
+         if (error)
+            return false;
+
+         time = write_time.time_since_epoch().count();
+         return true;
+      }
+
+      template <class T>
+      void write_array(ofstream& stream, size_t& pos, size_t array_pos, const vector<T>& values)
+      {
+         static const char padding[8] = {};
+         stream.write(padding, array_pos - pos);
+         stream.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+         pos = array_pos + values.size() * sizeof(T);
+      }
+
+      template <class T>
+      const T* array_at(const mapped_file_t& file, size_t array_pos)
+      {
+         return reinterpret_cast<const T*>(file.data() + array_pos);
+      }
+
+      // Holds the mapped snapshot, which contains the texts of the nodes.
+      struct snapshot_text_holder_t : text_holder_t
+      {
+         mapped_file_t file;
+      };
+   }
+
+   filesystem::path get_text_tree_snapshot_path(const filesystem::path& source_path)
+   {
+      filesystem::path snapshot_path = source_path;
+      snapshot_path += L".tree-snapshot";
+      return snapshot_path;
+   }
+
+   bool save_text_tree_snapshot(const filesystem::path& snapshot_path, const text_tree_t& tree,
+                                const filesystem::path& source_path, const load_simple_text_tree_options_t& options,
+                                bool with_hashes)
+   {
+      snapshot_header_t header = {};
+      memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+      header.version = snapshot_version;
+      header.char_size = sizeof(wchar_t);
+      header.options_hash = hash_options(options);
+      header.node_count = tree.size();
+      header.has_hashes = with_hashes ? 1 : 0;
+
+      if (!get_source_info(source_path, header.source_size, header.source_time))
+         return false;
+
+      // Node ids are 32-bit, like in the lazy tree.
+      const size_t node_count = tree.size();
+      if (node_count >= no_node)
+         return false;
+
+      vector<uint32_t> parents(node_count), text_lengths(node_count);
+      vector<uint64_t> text_offsets(node_count), text_hashes(with_hashes ? node_count : 0);
+      vector<wchar_t> texts;
+
+      // The nodes are saved in the order they were added, so each node comes after its parent.
+      for (size_t index = 0; index < node_count; ++index)
+      {
+         const node& a_node = tree.node(index);
+
+         parents[index] = a_node.parent ? uint32_t(a_node.parent->index) : no_node;
+         text_offsets[index] = texts.size();
+         text_lengths[index] = uint32_t(a_node.text_length);
+         if (with_hashes)
+            text_hashes[index] = a_node.text_hash;
+
+         texts.insert(texts.end(), a_node.text().begin(), a_node.text().end());
+         texts.emplace_back(0);
+      }
+
+      header.text_count = texts.size();
+      const snapshot_layout_t layout(header.node_count, header.text_count, with_hashes);
+
+      ofstream stream(snapshot_path, ios::binary | ios::trunc);
+      if (!stream)
+         return false;
+
+      stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      size_t pos = sizeof(header);
+      write_array(stream, pos, layout.parents, parents);
+      write_array(stream, pos, layout.text_offsets, text_offsets);
+      write_array(stream, pos, layout.text_lengths, text_lengths);
+      write_array(stream, pos, layout.text_hashes, text_hashes);
+      write_array(stream, pos, layout.texts, texts);
+      write_array(stream, pos, layout.size, vector<char>());
+
+      return bool(stream);
+   }
+
+   bool load_text_tree_snapshot(const filesystem::path& snapshot_path, const filesystem::path& source_path,
+                                const load_simple_text_tree_options_t& options, text_tree_t& tree)
+   {
+      auto holder = make_shared<snapshot_text_holder_t>();
+      mapped_file_t& file = holder->file;
+      if (!file.open(snapshot_path) || file.size() < sizeof(snapshot_header_t))
+         return false;
+
+      snapshot_header_t header;
+      memcpy(&header, file.data(), sizeof(header));
+      if (memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0
+         || header.version != snapshot_version
+         || header.char_size != sizeof(wchar_t)
+         || header.options_hash != hash_options(options)
+         || header.node_count >= no_node)
+         return false;
+
+      uint64_t source_size = 0;
+      int64_t source_time = 0;
+      if (!get_source_info(source_path, source_size, source_time)
+         || source_size != header.source_size
+         || source_time != header.source_time)
+         return false;
+
+      if (header.text_count > file.size())
+         return false;
+
+      const snapshot_layout_t layout(header.node_count, header.text_count, header.has_hashes != 0);
+      if (layout.size != file.size())
+         return false;
+
+      const uint32_t* parents = array_at<uint32_t>(file, layout.parents);
+      const uint64_t* text_offsets = array_at<uint64_t>(file, layout.text_offsets);
+      const uint32_t* text_lengths = array_at<uint32_t>(file, layout.text_lengths);
+      const uint64_t* text_hashes = header.has_hashes ? array_at<uint64_t>(file, layout.text_hashes) : nullptr;
+      const wchar_t* texts = array_at<wchar_t>(file, layout.texts);
+
+      // Verify the parents and texts, so a corrupted snapshot cannot make an invalid tree,
+      // and count the children, so each node reserves its children once.
+      vector<uint32_t> child_counts(header.node_count);
+      size_t root_count = 0;
+      for (size_t index = 0; index < child_counts.size(); ++index)
+      {
+         const uint32_t parent = parents[index];
+         if (parent != no_node && parent >= index)
+            return false;
+         if (text_offsets[index] >= header.text_count || text_lengths[index] >= header.text_count - text_offsets[index])
+            return false;
+
+         if (parent == no_node)
+            ++root_count;
+         else
+            ++child_counts[parent];
+      }
+
+      text_tree_t loaded;
+      loaded.roots.reserve(root_count);
+      vector<node*> nodes(header.node_count);
+      for (size_t index = 0; index < nodes.size(); ++index)
+      {
+         const uint32_t parent = parents[index];
+         const wchar_t* text = texts + text_offsets[index];
+         node* parent_node = parent == no_node ? nullptr : nodes[parent];
+         nodes[index] = text_hashes
+                      ? loaded.add_child(parent_node, text, text_lengths[index], text_hashes[index])
+                      : loaded.add_child(parent_node, text, text_lengths[index]);
+         nodes[index]->children.reserve(child_counts[index]);
+      }
+
+      loaded.source_text_lines = move(holder);
+      tree = move(loaded);
+      return true;
+   }
+}
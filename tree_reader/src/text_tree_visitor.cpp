@@ -5,8 +5,6 @@ namespace dak::tree_reader
    using namespace std;
    using result = tree_visitor_t::result_t;
    using node = text_tree_t::node_t;
-   using Iter = vector<node *>::const_iterator;
-   using IterPair = pair<Iter, Iter>;
    constexpr result continue_visit{ false, false };
    constexpr result stop_visit{ true, false };
 
@@ -41,8 +39,15 @@ namespace dak::tree_reader
       return delegate_tree_visitor::visit(tree, node, level);
    }
 
-   void visit_in_order(const text_tree_t& tree, const node* a_node, bool siblings, tree_visitor_t& visitor)
+   // The visiting algorithm, shared by the wide and UTF-8 trees.
+
+   template <class TREE, class VISITOR>
+   static void visit_nodes_in_order(const TREE& tree, const typename TREE::node_t* a_node, bool siblings, VISITOR& visitor)
    {
+      using node = typename TREE::node_t;
+      using Iter = typename vector<node *>::const_iterator;
+      using IterPair = pair<Iter, Iter>;
+
       IterPair pos;
       if (a_node)
       {
@@ -109,9 +114,29 @@ namespace dak::tree_reader
       }
    }
 
+   void visit_in_order(const text_tree_t& tree, const node* a_node, bool siblings, tree_visitor_t& visitor)
+   {
+      visit_nodes_in_order(tree, a_node, siblings, visitor);
+   }
+
    void visit_in_order(const text_tree_t& tree, const node* node, bool siblings, const node_visit_function_t& func)
    {
       function_tree_visitor_t visitor(func);
       visit_in_order(tree, node, siblings, visitor);
    }
+
+   void visit_in_order(const utf8_text_tree_t& tree, const utf8_text_tree_t::node_t* node, bool siblings, const utf8_node_visit_function_t& func)
+   {
+      struct utf8_function_visitor_t
+      {
+         const utf8_node_visit_function_t& func;
+
+         result go_deeper(size_t deeperLevel) { return continue_visit; }
+         result go_higher(size_t higherLevel) { return continue_visit; }
+         result visit(const utf8_text_tree_t& tree, const utf8_text_tree_t::node_t& node, size_t level) { return func(tree, node, level); }
+      };
+
+      utf8_function_visitor_t visitor{ func };
+      visit_nodes_in_order(tree, node, siblings, visitor);
+   }
 }
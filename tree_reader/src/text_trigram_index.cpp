@@ -0,0 +1,151 @@
+#include "dak/tree_reader/text_trigram_index.h"
+
+#include <algorithm>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+
+   namespace
+   {
+      // Combine three characters into a key. Unicode needs 21 bits per character.
+      uint64_t trigram_key(const wchar_t* chars)
+      {
+         constexpr uint64_t mask = 0x1FFFFF;
+         return ((uint64_t(chars[0]) & mask) << 42) | ((uint64_t(chars[1]) & mask) << 21) | (uint64_t(chars[2]) & mask);
+      }
+
+      // Gather the distinct trigrams of a text, sorted.
+      void gather_trigrams(wstring_view text, vector<uint64_t>& keys)
+      {
+         keys.clear();
+         if (text.size() < text_trigram_index_t::trigram_length)
+            return;
+
+         for (size_t pos = 0; pos + text_trigram_index_t::trigram_length <= text.size(); ++pos)
+            keys.emplace_back(trigram_key(text.data() + pos));
+
+         sort(keys.begin(), keys.end());
+         keys.erase(unique(keys.begin(), keys.end()), keys.end());
+      }
+
+      void append_delta(vector<uint8_t>& deltas, size_t delta)
+      {
+         while (delta >= 0x80)
+         {
+            deltas.emplace_back(uint8_t(delta | 0x80));
+            delta >>= 7;
+         }
+         deltas.emplace_back(uint8_t(delta));
+      }
+
+      size_t read_delta(const vector<uint8_t>& deltas, size_t& pos)
+      {
+         size_t delta = 0;
+         for (int shift = 0; ; shift += 7)
+         {
+            const uint8_t byte = deltas[pos++];
+            delta |= size_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+               return delta;
+         }
+      }
+   }
+
+   text_trigram_index_t::text_trigram_index_t(const text_tree_t& tree, const atomic<bool>* abort)
+   {
+      vector<uint64_t> keys;
+      const size_t size = tree.size();
+      for (size_t index = 0; index < size; ++index)
+      {
+         if (abort && *abort)
+         {
+            _postings.clear();
+            return;
+         }
+
+         gather_trigrams(tree.node(index).text(), keys);
+         for (const uint64_t key : keys)
+         {
+            posting_t& posting = _postings[key];
+            append_delta(posting.deltas, posting.count ? index - posting.last : index);
+            posting.last = index;
+            posting.count += 1;
+         }
+      }
+
+      for (auto& [key, posting] : _postings)
+         posting.deltas.shrink_to_fit();
+
+      _tree = &tree;
+      _tree_size = size;
+   }
+
+   bool text_trigram_index_t::find_candidates(wstring_view text, vector<size_t>& candidates) const
+   {
+      candidates.clear();
+
+      vector<uint64_t> keys;
+      gather_trigrams(text, keys);
+      if (keys.empty())
+         return false;
+
+      // Intersect the shortest lists first, to keep the candidates few.
+      vector<const posting_t*> postings;
+      for (const uint64_t key : keys)
+      {
+         const auto pos = _postings.find(key);
+         if (pos == _postings.end())
+            return true;
+         postings.emplace_back(&pos->second);
+      }
+
+      sort(postings.begin(), postings.end(), [](const posting_t* lhs, const posting_t* rhs) { return lhs->count < rhs->count; });
+
+      {
+         const posting_t& first = *postings.front();
+         candidates.reserve(first.count);
+         size_t pos = 0;
+         size_t index = 0;
+         for (size_t i = 0; i < first.count; ++i)
+         {
+            index += read_delta(first.deltas, pos);
+            candidates.emplace_back(index);
+         }
+      }
+
+      for (size_t which = 1; which < postings.size() && !candidates.empty(); ++which)
+      {
+         const posting_t& posting = *postings[which];
+         size_t pos = 0;
+         size_t index = 0;
+         size_t read = 0;
+         size_t kept = 0;
+         for (size_t i = 0; i < posting.count && read < candidates.size(); ++i)
+         {
+            index += read_delta(posting.deltas, pos);
+            while (read < candidates.size() && candidates[read] < index)
+               ++read;
+            if (read < candidates.size() && candidates[read] == index)
+               candidates[kept++] = candidates[read++];
+         }
+         candidates.resize(kept);
+      }
+
+      return true;
+   }
+
+   async_trigram_index_t build_trigram_index_async(const text_tree_ptr_t& tree)
+   {
+      if (!tree)
+         return {};
+
+      auto abort = make_shared<atomic<bool>>(false);
+      auto fut = async(launch::async, [tree, abort]() -> text_trigram_index_ptr_t
+      {
+         return make_shared<text_trigram_index_t>(*tree, abort.get());
+      });
+
+      return make_pair(move(fut), abort);
+   }
+}
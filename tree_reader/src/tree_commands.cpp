@@ -1,6 +1,7 @@
 #include "dak/tree_reader/tree_commands.h"
 #include "dak/tree_reader/global_commands.h" // For options...
 #include "dak/tree_reader/tree_filter_maker.h"
+#include "dak/tree_reader/tree_filter_helpers.h"
 #include "dak/utility/text.h"
 #include "dak/tree_reader/simple_tree_writer.h"
 
@@ -15,6 +16,218 @@ namespace dak::tree_reader
    tree_commands_t::tree_commands_t(text_tree_ptr_t tree, wstring name, shared_ptr<named_filters_t> knownFilters, shared_ptr<undo_stack> undoRedo)
    : _tree(move(tree)), _tree_filename(move(name)), _known_filters(move(knownFilters)), _undo_redo(move(undoRedo))
    {
+      if (_tree && _tree->size() >= text_trigram_index_t::min_indexed_nodes)
+         _trigram_index = build_trigram_index_async(_tree);
+
+      if (_tree && _tree->size() >= text_subtree_sketches_t::min_sketched_nodes)
+         _subtree_sketches = build_subtree_sketches_async(_tree);
+   }
+
+   tree_commands_t::~tree_commands_t()
+   {
+      // Don't wait for the index and sketches to be fully built.
+      if (_trigram_index.second)
+         *_trigram_index.second = true;
+      if (_subtree_sketches.second)
+         *_subtree_sketches.second = true;
+      if (_filtered_trigram_index.second)
+         *_filtered_trigram_index.second = true;
+      if (_filtered_subtree_sketches.second)
+         *_filtered_subtree_sketches.second = true;
+   }
+
+   void tree_commands_t::use_text_indexes_if_ready()
+   {
+      if (_trigram_index.first.valid() && _trigram_index.first.wait_for(0s) == future_status::ready)
+      {
+         _leaf_matches->set_index(_trigram_index.first.get());
+         _trigram_index = async_trigram_index_t();
+      }
+
+      // Only called when no filtering nor searching is in progress,
+      // so the tree can be given its sketches.
+      if (_subtree_sketches.first.valid() && _subtree_sketches.first.wait_for(0s) == future_status::ready)
+      {
+         _tree->subtree_sketches = _subtree_sketches.first.get();
+         _subtree_sketches = async_subtree_sketches_t();
+      }
+   }
+
+   void tree_commands_t::index_filtered_tree()
+   {
+      if (_filtered_trigram_index.second)
+         *_filtered_trigram_index.second = true;
+      _filtered_trigram_index = async_trigram_index_t();
+      if (_filtered_subtree_sketches.second)
+         *_filtered_subtree_sketches.second = true;
+      _filtered_subtree_sketches = async_subtree_sketches_t();
+
+      // note: a new filtered tree may be allocated where the previous one was.
+      _filtered_leaf_matches->clear();
+      _filtered_leaf_matches->set_index(nullptr);
+
+      // Searches in the tree itself use its own index and sketches.
+      if (!_filtered || _filtered == _tree)
+         return;
+
+      if (_filtered->size() >= text_trigram_index_t::min_indexed_nodes)
+         _filtered_trigram_index = build_trigram_index_async(_filtered);
+
+      if (_filtered->size() >= text_subtree_sketches_t::min_sketched_nodes)
+         _filtered_subtree_sketches = build_subtree_sketches_async(_filtered);
+   }
+
+   void tree_commands_t::use_filtered_text_indexes_if_ready()
+   {
+      if (_filtered_trigram_index.first.valid() && _filtered_trigram_index.first.wait_for(0s) == future_status::ready)
+      {
+         _filtered_leaf_matches->set_index(_filtered_trigram_index.first.get());
+         _filtered_trigram_index = async_trigram_index_t();
+      }
+
+      // Only called when no searching is in progress, so the filtered tree
+      // can be given its sketches.
+      if (_filtered_subtree_sketches.first.valid() && _filtered_subtree_sketches.first.wait_for(0s) == future_status::ready)
+      {
+         auto sketches = _filtered_subtree_sketches.first.get();
+         _filtered_subtree_sketches = async_subtree_sketches_t();
+         if (_filtered && sketches && sketches->is_of(*_filtered))
+            _filtered->subtree_sketches = move(sketches);
+      }
+   }
+
+   /////////////////////////////////////////////////////////////////////////
+   //
+   // Following the file of the tree.
+
+   bool tree_commands_t::follow_tree_file(const load_simple_text_tree_options_t& options)
+   {
+      if (!_tree || _tree_filename.empty())
+         return false;
+
+      // Nodes are appended to the tree, so nothing else may be reading it.
+      abort_async_filter();
+
+      // The index and sketches would no longer match the tree once it grows,
+      // and the sketches would skip the sub-trees where nodes are appended.
+      if (_trigram_index.second)
+         *_trigram_index.second = true;
+      _trigram_index = async_trigram_index_t();
+      if (_subtree_sketches.second)
+         *_subtree_sketches.second = true;
+      _subtree_sketches = async_subtree_sketches_t();
+      _tree->subtree_sketches = nullptr;
+      _leaf_matches->set_index(nullptr);
+
+      // The follower may replace the last node, when it was an incomplete line,
+      // so the tree can have the same size with another text.
+      _leaf_matches->clear();
+      if (_filtered_trigram_index.second)
+         *_filtered_trigram_index.second = true;
+      _filtered_trigram_index = async_trigram_index_t();
+      if (_filtered_subtree_sketches.second)
+         *_filtered_subtree_sketches.second = true;
+      _filtered_subtree_sketches = async_subtree_sketches_t();
+
+      _follower = make_shared<text_tree_follower_t>(_tree_filename, _tree, options);
+      if (_follower->was_truncated())
+      {
+         stop_following_tree_file();
+         return false;
+      }
+
+      filter_followed_tree();
+      return true;
+   }
+
+   void tree_commands_t::stop_following_tree_file()
+   {
+      _follower = nullptr;
+      _appended_filtering = nullptr;
+      _appended_filter = nullptr;
+      _appended_searching = nullptr;
+   }
+
+   bool tree_commands_t::is_following_tree_file() const
+   {
+      return _follower != nullptr;
+   }
+
+   bool tree_commands_t::was_followed_tree_file_truncated() const
+   {
+      return _follower && _follower->was_truncated();
+   }
+
+   bool tree_commands_t::wait_for_followed_tree_file_change(chrono::milliseconds timeout)
+   {
+      return _follower && _follower->wait_for_change(timeout);
+   }
+
+   size_t tree_commands_t::update_followed_tree()
+   {
+      if (!_follower)
+         return 0;
+
+      // The tree must not grow while it is being filtered or searched.
+      if (!is_async_filter_ready())
+         return 0;
+
+      const size_t added = _follower->append_new_lines();
+
+      // When the last node was replaced, the filtered trees no longer only need the appended nodes.
+      if (_follower->was_last_node_replaced())
+      {
+         _appended_filtering = nullptr;
+         _appended_searching = nullptr;
+         _leaf_matches->clear();
+      }
+
+      if (added > 0)
+         filter_followed_tree();
+
+      return added;
+   }
+
+   void tree_commands_t::filter_followed_tree()
+   {
+      if (!is_streamable_filter(_filter))
+      {
+         _appended_filtering = nullptr;
+         _appended_searching = nullptr;
+         apply_filter_to_tree(false);
+         return;
+      }
+
+      // Filter the whole tree again when the filter or the filtered tree were changed.
+      if (!_appended_filtering || _appended_filtering->filtered_tree != _filtered || _appended_filter != _filter)
+      {
+         _appended_filtering = make_shared<appended_nodes_filtering_t>(_filter);
+         _appended_filter = _filter;
+      }
+
+      _appended_filtering->filter_appended_nodes(*_tree);
+      _filtered = _appended_filtering->filtered_tree;
+      // note: pure copy of input tree are considered to have been saved.
+      _filtered_was_saved = !_filter;
+
+      if (_searched_text.empty())
+         return;
+
+      auto search_filter = convert_simple_text_to_filter(_searched_text, *_known_filters);
+      if (!search_filter || !is_streamable_filter(search_filter))
+      {
+         _appended_searching = nullptr;
+         apply_search_in_tree(false);
+         return;
+      }
+
+      if (!_appended_searching || _appended_searching->filtered_tree != _searched || _searched_source != _filtered)
+         _appended_searching = make_shared<appended_nodes_filtering_t>(search_filter);
+
+      _appended_searching->filter_appended_nodes(*_filtered);
+      _searched = _appended_searching->filtered_tree;
+      _searched_filter = search_filter;
+      _searched_source = _filtered;
    }
 
    /////////////////////////////////////////////////////////////////////////
@@ -64,26 +277,30 @@ namespace dak::tree_reader
    void tree_commands_t::apply_filter_to_tree(bool async)
    {
       abort_async_filter();
+      use_text_indexes_if_ready();
 
       if (_filter)
       {
          if (async)
          {
-            _async_filtering = move(filter_tree_async(_tree, _filter));
+            _async_filtering = move(filter_tree_async(_tree, _filter, _leaf_matches));
          }
          else
          {
             _filtered = make_shared<text_tree_t>();
-            filter_tree(*_tree, *_filtered, *_filter);
+            filter_tree(*_tree, *_filtered, *_filter, _leaf_matches);
             _filtered_was_saved = false;
+            index_filtered_tree();
             apply_search_in_tree(async);
          }
       }
       else
       {
-         _filtered = make_shared<text_tree_t>(*_tree);
+         // note: the tree is used as-is, so searches use its index and sketches.
+         _filtered = _tree;
          // note: pure copy of input tree are considered to have been saved.
          _filtered_was_saved = true;
+         index_filtered_tree();
          apply_search_in_tree(async);
       }
    }
@@ -107,6 +324,7 @@ namespace dak::tree_reader
          _filtered = make_shared<text_tree_t>(_async_filtering.first.get());
          _filtered_was_saved = false;
          _async_filtering = async_filter_tree_result_t();
+         index_filtered_tree();
 
          apply_search_in_tree(true);
       }
@@ -123,6 +341,8 @@ namespace dak::tree_reader
       if (_async_searching.second)
          _async_searching.second->abort = true;
       _async_searching = async_filter_tree_result_t();
+      _async_searched_filter = nullptr;
+      _async_searched_source = nullptr;
    }
 
    bool tree_commands_t::is_async_search_ready()
@@ -133,6 +353,8 @@ namespace dak::tree_reader
             return false;
 
          _searched = make_shared<text_tree_t>(_async_searching.first.get());
+         _searched_filter = move(_async_searched_filter);
+         _searched_source = move(_async_searched_source);
          _async_searching = async_filter_tree_result_t();
       }
 
@@ -164,6 +386,8 @@ namespace dak::tree_reader
       if (_searched_text.empty())
       {
          _searched = nullptr;
+         _searched_filter = nullptr;
+         _searched_source = nullptr;
          return;
       }
 
@@ -176,16 +400,30 @@ namespace dak::tree_reader
       if (!_filter)
          return;
 
+      // When the search only narrows the last completed search of the same tree,
+      // only the nodes it found can match, so search in its result instead.
+      text_tree_ptr_t searchIn = applyTo;
+      if (_searched && _searched_source == applyTo && is_narrower_contains_filter(_filter, _searched_filter))
+         searchIn = _searched;
+
       abort_async_search();
+      use_filtered_text_indexes_if_ready();
+
+      // The leaf matches are kept for the searches in the tree and in the filtered tree.
+      const leaf_match_cache_ptr_t cache = (searchIn == _tree) ? _leaf_matches : (searchIn == _filtered) ? _filtered_leaf_matches : nullptr;
 
       if (async)
       {
-         _async_searching = move(filter_tree_async(applyTo, _filter));
+         _async_searching = move(filter_tree_async(searchIn, _filter, cache));
+         _async_searched_filter = _filter;
+         _async_searched_source = applyTo;
       }
       else
       {
          _searched = make_shared<text_tree_t>();
-         filter_tree(*applyTo, *_searched, *_filter);
+         filter_tree(*searchIn, *_searched, *_filter, cache);
+         _searched_filter = _filter;
+         _searched_source = applyTo;
       }
    }
 
@@ -199,6 +437,16 @@ namespace dak::tree_reader
       return _tree_filename;
    }
 
+   void tree_commands_t::set_original_tree_read_options(const load_simple_text_tree_options_t& options)
+   {
+      _tree_read_options = options;
+   }
+
+   const std::optional<load_simple_text_tree_options_t>& tree_commands_t::get_original_tree_read_options() const
+   {
+      return _tree_read_options;
+   }
+
    /////////////////////////////////////////////////////////////////////////
    //
    // Current filtered tree.
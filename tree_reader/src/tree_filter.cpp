@@ -4,7 +4,9 @@
 #include "dak/tree_reader/text_tree_visitor.h"
 #include "dak/tree_reader/named_filters.h"
 
+#include <regex>
 #include <sstream>
+#include <cwchar>
 
 namespace dak::tree_reader
 {
@@ -24,6 +26,10 @@ namespace dak::tree_reader
       return get_short_name();
    }
 
+   void tree_filter_t::begin_filtering(const text_tree_t& tree)
+   {
+   }
+
    delegate_tree_filter_t::delegate_tree_filter_t(const delegate_tree_filter_t& other)
    : sub_filter(other.sub_filter)
    {
@@ -39,6 +45,12 @@ namespace dak::tree_reader
       return sub_filter->is_kept(tree, node, level);
    }
 
+   void delegate_tree_filter_t::begin_filtering(const text_tree_t& tree)
+   {
+      if (sub_filter)
+         sub_filter->begin_filtering(tree);
+   }
+
    result accept_tree_filter_t::is_kept(const text_tree_t& tree, const node& node, size_t level)
    {
       return keep;
@@ -56,25 +68,20 @@ namespace dak::tree_reader
 
    result contains_tree_filter_t::is_kept(const text_tree_t& tree, const node& node, size_t level)
    {
-      return (wcsstr(node.text_ptr, contained.c_str()) != nullptr) ? keep : drop;
-   }
-   
-   int unique_tree_filter_t::hash::operator()(const wchar_t* text) const
-   {
-      int h = 0;  if (text) while (*text) { h += *text * 131; ++text; } return h & INT_MAX;
+      return _searcher.is_in(node.text()) ? keep : drop;
    }
 
-   bool unique_tree_filter_t::comp::operator()(const wchar_t* lhs, const wchar_t* rhs) const
+   void contains_tree_filter_t::begin_filtering(const text_tree_t& tree)
    {
-      return std::wcscmp(lhs, rhs) == 0;
+      if (_searcher.needle() != contained)
+         _searcher = substring_searcher_t(contained);
    }
-
+   
    result unique_tree_filter_t::is_kept(const text_tree_t& tree, const node& node, size_t level)
    {
-      if (_uniques.count(node.text_ptr) > 0)
+      if (!_uniques.insert(node.text(), node.text_hash))
          return drop;
 
-      _uniques.insert(node.text_ptr);
       return keep;
    }
 
@@ -85,7 +92,24 @@ namespace dak::tree_reader
 
    result regex_tree_filter_t::is_kept(const text_tree_t& tree, const node& node, size_t level)
    {
-      return regex_search(node.text_ptr, regex) ? keep : drop;
+      return regex.search(node.text()) ? keep : drop;
+   }
+
+   void regex_tree_filter_t::begin_filtering(const text_tree_t& tree)
+   {
+      if (_compiled_text == regex_text)
+         return;
+
+      // The text can be edited while invalid, in which case nothing matches.
+      try
+      {
+         regex = linear_regex_t(regex_text);
+      }
+      catch (const regex_error&)
+      {
+         regex = linear_regex_t();
+      }
+      _compiled_text = regex_text;
    }
 
    combine_tree_filter_t::combine_tree_filter_t(const combine_tree_filter_t& other)
@@ -96,6 +120,13 @@ namespace dak::tree_reader
             filter = filter->clone();
    }
 
+   void combine_tree_filter_t::begin_filtering(const text_tree_t& tree)
+   {
+      for (const auto& filter : filters)
+         if (filter)
+            filter->begin_filtering(tree);
+   }
+
    result not_tree_filter_t::is_kept(const text_tree_t& tree, const node& node, size_t level)
    {
       result_t result = delegate_tree_filter_t::is_kept(tree, node, level);
@@ -136,6 +167,18 @@ namespace dak::tree_reader
       if (level <= _keep_all_nodes_under_level)
          _keep_all_nodes_under_level = -1;
 
+      // Likewise, drop the nodes of a sub-tree where the under filter cannot match.
+      if (level > _drop_all_nodes_under_level)
+         return drop;
+
+      _drop_all_nodes_under_level = -1;
+
+      if (_pruner.can_skip(tree, node))
+      {
+         _drop_all_nodes_under_level = level;
+         return drop;
+      }
+
       // If the node doesn't match the under filter, don't apply the other filter.
       // Just return the result of the other filter.
       result_t result = delegate_tree_filter_t::is_kept(tree, node, level);
@@ -157,6 +200,18 @@ namespace dak::tree_reader
       return result;
    }
 
+   void under_tree_filter_t::begin_filtering(const text_tree_t& tree)
+   {
+      delegate_tree_filter_t::begin_filtering(tree);
+
+      _keep_all_nodes_under_level = -1;
+      _drop_all_nodes_under_level = -1;
+
+      // Dropping a whole sub-tree is only the same as calling the under filter
+      // on each node when it never stops nor skips children.
+      _pruner = (sub_filter && is_text_only_filter(sub_filter)) ? subtree_pruner_t(*sub_filter, tree) : subtree_pruner_t();
+   }
+
    result remove_children_tree_filter_t::is_kept(const text_tree_t& tree, const node& node, size_t level)
    {
       if (!delegate_tree_filter_t::is_kept(tree, node, level).keep)
@@ -187,15 +242,89 @@ namespace dak::tree_reader
 
    result if_subtree_tree_filter_t::is_kept(const text_tree_t& tree, const node& node, size_t level)
    {
+      if (_matched_tree == &tree)
+         return _nodes_with_matching_descendant.count(&node) ? keep : drop;
+
+      if (_pruner.can_skip(tree, node))
+         return drop;
+
       stop_when_kept_tree_filter_t stop_when_kept(sub_filter);
       filter_tree_visitor_t visitor(tree, _filtered, stop_when_kept);
       visit_in_order(tree, &node, false, visitor);
       return (_filtered.roots.size() > 0) ? keep : drop;
    }
 
+   void if_subtree_tree_filter_t::begin_filtering(const text_tree_t& tree)
+   {
+      delegate_tree_filter_t::begin_filtering(tree);
+
+      _matched_tree = nullptr;
+      _nodes_with_matching_descendant.clear();
+      _pruner = sub_filter ? subtree_pruner_t(*sub_filter, tree) : subtree_pruner_t();
+
+      if (!is_text_only_filter(sub_filter))
+         return;
+
+      // Since the result of the sub-filter does not depend on the level
+      // nor on previous nodes, it can be applied once per node.
+      //
+      // Nodes are gathered in order, so going through them in reverse
+      // processes all the descendants of a node before the node itself.
+      //
+      // The nodes of the sub-trees where the sub-filter cannot match
+      // have no matching descendant, so they are not gathered.
+      vector<const node*> nodes;
+      visit_in_order(tree, [this, &nodes](const text_tree_t& tree, const node& a_node, size_t level)
+      {
+         if (_pruner.can_skip(tree, a_node))
+            return tree_visitor_t::result_t{ false, true };
+
+         nodes.emplace_back(&a_node);
+         return tree_visitor_t::result_t();
+      });
+
+      for (auto pos = nodes.rbegin(); pos != nodes.rend(); ++pos)
+      {
+         const node& a_node = **pos;
+         if (!a_node.parent)
+            continue;
+
+         if (_nodes_with_matching_descendant.count(&a_node) || delegate_tree_filter_t::is_kept(tree, a_node, a_node.depth).keep)
+            _nodes_with_matching_descendant.insert(a_node.parent);
+      }
+
+      _matched_tree = &tree;
+   }
+
    result if_sibling_tree_filter_t::is_kept(const text_tree_t& tree, const node& a_node, size_t level)
    {
       const auto& children = a_node.parent ? a_node.parent->children : tree.roots;
+
+      if (_matched_tree == &tree)
+      {
+         if (_matched_groups.size() <= a_node.depth)
+            _matched_groups.resize(a_node.depth + 1);
+
+         matched_group_t& group = _matched_groups[a_node.depth];
+         if (!group.is_matched || group.parent != a_node.parent)
+         {
+            // Scan the siblings in reverse: a sibling is kept if it matches,
+            // otherwise if the next sibling is kept, unless it asked to stop.
+            group.later_sibling_matches.assign(children.size() + 1, false);
+            for (size_t index = children.size(); index > 0; --index)
+            {
+               const node& c_node = *children[index - 1];
+               const auto result = delegate_tree_filter_t::is_kept(tree, c_node, level);
+               group.later_sibling_matches[index - 1] = result.keep || (!result.stop && group.later_sibling_matches[index]);
+            }
+
+            group.parent = a_node.parent;
+            group.is_matched = true;
+         }
+
+         return group.later_sibling_matches[a_node.index_in_parent] ? keep : drop;
+      }
+
       auto pos = children.begin();
       pos += a_node.index_in_parent;
 
@@ -212,6 +341,14 @@ namespace dak::tree_reader
       return drop;
    }
 
+   void if_sibling_tree_filter_t::begin_filtering(const text_tree_t& tree)
+   {
+      delegate_tree_filter_t::begin_filtering(tree);
+
+      _matched_groups.clear();
+      _matched_tree = is_text_only_filter(sub_filter) ? &tree : nullptr;
+   }
+
    result named_tree_filter_t::is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level)
    {
       if (!filter)
@@ -220,6 +357,12 @@ namespace dak::tree_reader
       return filter->is_kept(tree, node, level);
    }
 
+   void named_tree_filter_t::begin_filtering(const text_tree_t& tree)
+   {
+      if (filter)
+         filter->begin_filtering(tree);
+   }
+
    #define IMPLEMENT_SIMPLE_NAME(cl, name, desc)      \
       wstring cl::get_short_name() const              \
       {                                               \
@@ -1,8 +1,11 @@
 #include "dak/tree_reader/tree_filter_command_line.h"
 #include "dak/tree_reader/tree_commands.h"
 #include "dak/tree_reader/tree_filter_maker.h"
+#include "dak/tree_reader/tree_filter_helpers.h"
+#include "dak/tree_reader/text_tree_snapshot.h"
 #include "dak/utility/text.h"
 
+#include <chrono>
 #include <sstream>
 
 namespace dak::tree_reader
@@ -26,7 +29,17 @@ namespace dak::tree_reader
       stream << L"  output-indent ''text'': indent the printed lines with the given text." << endl;
       stream << L"  load ''file name'': load a text tree from the given file." << endl;
       stream << L"       (The tree is pushed on the active tree stack, ready to be filtered.)" << endl;
+      stream << L"       (When only the kept lines are printed and the filter only looks at the current line and its parents, the file is streamed instead.)" << endl;
+      stream << L"  stream ''file name'': filter the given file while it is read and print the kept lines." << endl;
+      stream << L"       (The file is not loaded, so only filters that look at the current line and its parents can be used.)" << endl;
+      stream << L"  load-lazy ''file name'': index the given file without loading it, then filter it and print the kept lines." << endl;
+      stream << L"       (For files too large to be loaded, so only filters that look at the current line and its parents can be used.)" << endl;
+      stream << L"  follow: after printing the filtered tree, keep reading the lines appended to its file and print the kept ones." << endl;
+      stream << L"       (Runs until the file becomes shorter or the program is stopped.)" << endl;
+      stream << L"  no-follow: turn off following the file." << endl;
       stream << L"  save ''file name'': save the tree into the named file." << endl;
+      stream << L"  save-snapshot: save a binary snapshot of the loaded tree next to its file." << endl;
+      stream << L"       (Loading the file again uses the snapshot while the file and input options are unchanged.)" << endl;
       stream << L"  filter ''filter'': convert the given textual filters description into filters." << endl;
       stream << L"  push-filtered: use the current filtered tree as input to the filters." << endl;
       stream << L"  pop-tree: pop the current tree and use the previous tree as input to the filters." << endl;
@@ -79,6 +92,117 @@ namespace dak::tree_reader
       return stream.str();
    }
 
+   wstring command_line_t::filter_streamed_file(wostream& output)
+   {
+      if (streamed_filename.empty())
+         return L"";
+
+      tree_filter_ptr_t filter = use_v1
+         ? convert_text_to_filter(filter_text, *_known_filters)
+         : convert_simple_text_to_filter(filter_text, *_known_filters);
+      if (!filter)
+         filter = accept();
+
+      if (!is_streamable_filter(filter))
+         return L"The filter needs the whole tree, load the file instead: " + filter_text;
+
+      filter_simple_text(streamed_filename, output, *filter, options.read_options, options.output_line_indent);
+
+      return L"";
+   }
+
+   wstring command_line_t::filter_lazy_tree(wostream& output)
+   {
+      if (!lazy_tree)
+         return L"";
+
+      tree_filter_ptr_t filter = use_v1
+         ? convert_text_to_filter(filter_text, *_known_filters)
+         : convert_simple_text_to_filter(filter_text, *_known_filters);
+      if (!filter)
+         filter = accept();
+
+      if (!is_streamable_filter(filter))
+         return L"The filter needs the whole tree, load the file instead: " + filter_text;
+
+      filter_simple_text(*lazy_tree, output, *filter, options.output_line_indent);
+
+      return L"";
+   }
+
+   wstring command_line_t::follow_current_tree(wostream& output)
+   {
+      if (!current_tree)
+         return L"";
+
+      text_tree_ptr_t printed_tree = current_tree->get_filtered_tree();
+      size_t printed_count = printed_tree ? printed_tree->size() : 0;
+
+      if (!follow_tree(current_tree))
+         return L"The file of the tree cannot be followed.";
+
+      // The filtered tree only grows when the filter only looks at the current line and its parents.
+      const bool filtered_tree_grows = is_streamable_filter(current_tree->get_filter());
+
+      while (true)
+      {
+         const text_tree_ptr_t filtered = current_tree->get_filtered_tree();
+         if (filtered && filtered_tree_grows)
+         {
+            for (; printed_count < filtered->size(); ++printed_count)
+            {
+               const auto& node = filtered->node(printed_count);
+               for (size_t depth = 0; depth < node.depth; ++depth)
+                  output << options.output_line_indent;
+               output << node.text() << L'\n';
+            }
+            output.flush();
+         }
+         else if (filtered && (filtered != printed_tree || filtered->size() != printed_count))
+         {
+            print_tree(output, *filtered, options.output_line_indent) << endl;
+            printed_tree = filtered;
+            printed_count = filtered->size();
+         }
+
+         while (!current_tree->update_followed_tree())
+         {
+            if (current_tree->was_followed_tree_file_truncated())
+            {
+               current_tree->stop_following_tree_file();
+               return L"The followed file became shorter, load it again.";
+            }
+            current_tree->wait_for_followed_tree_file_change(chrono::seconds(1));
+         }
+      }
+   }
+
+   void command_line_t::load_pending_tree()
+   {
+      if (pending_load_filename.empty())
+         return;
+
+      current_tree = load_tree(pending_load_filename);
+      pending_load_filename.clear();
+   }
+
+   bool command_line_t::can_stream_pending_tree() const
+   {
+      if (pending_load_filename.empty() || is_interactive || is_following)
+         return false;
+
+      // A snapshot, when still valid, is faster to load than reading the file.
+      error_code error;
+      if (filesystem::exists(get_text_tree_snapshot_path(pending_load_filename), error))
+         return false;
+
+      tree_filter_ptr_t filter = use_v1
+         ? convert_text_to_filter(filter_text, *_known_filters)
+         : convert_simple_text_to_filter(filter_text, *_known_filters);
+
+      return !filter || is_streamable_filter(filter);
+   }
+
    wstring command_line_t::list_filters()
    {
       wostringstream sstream;
@@ -150,30 +274,63 @@ namespace dak::tree_reader
          }
          else if (cmd == L"load" && i + 1 < cmds.size())
          {
-            current_tree = load_tree(cmds[++i]);
+            load_pending_tree();
+            pending_load_filename = cmds[++i];
+            streamed_filename.clear();
+            lazy_tree = nullptr;
+         }
+         else if (cmd == L"load-lazy" && i + 1 < cmds.size())
+         {
+            lazy_tree = load_lazy_text_tree(cmds[++i], options.read_options);
+            streamed_filename.clear();
+            pending_load_filename.clear();
+         }
+         else if (cmd == L"stream" && i + 1 < cmds.size())
+         {
+            streamed_filename = cmds[++i];
+            lazy_tree = nullptr;
+            pending_load_filename.clear();
+         }
+         else if (cmd == L"follow")
+         {
+            is_following = true;
+         }
+         else if (cmd == L"no-follow")
+         {
+            is_following = false;
          }
          else if (cmd == L"save" && i + 1 < cmds.size())
          {
+            load_pending_tree();
             if (current_tree)
                current_tree->save_filtered_tree(cmds[++i], options);
          }
+         else if (cmd == L"save-snapshot")
+         {
+            load_pending_tree();
+            if (!save_tree_snapshot(current_tree))
+               result += L"Could not save the snapshot of the tree.\n";
+         }
          else if (cmd == L"filter" && i + 1 < cmds.size())
          {
             append_filter_text(cmds[++i]);
          }
          else if (cmd == L"push-filtered")
          {
+            load_pending_tree();
             if (current_tree)
               current_tree = create_tree_from_filtered(current_tree);
          }
          else if (cmd == L"pop-tree")
          {
+            load_pending_tree();
             remove_tree(current_tree);
             // TODO: would need to recover old context.
             current_tree = nullptr;
          }
          else if (cmd == L"then")
          {
+            load_pending_tree();
             if (current_tree)
             {
                result += create_filter();
@@ -185,6 +342,7 @@ namespace dak::tree_reader
          }
          else if (cmd == L"name" && i + 1 < cmds.size())
          {
+            load_pending_tree();
             if (current_tree)
             {
                result += create_filter();
@@ -212,6 +370,18 @@ namespace dak::tree_reader
       if (filter_text.empty())
          filter_text = previous_filter_text;
 
+      // Stream the loaded file when nothing needs its tree, otherwise load it now.
+      if (can_stream_pending_tree())
+      {
+         streamed_filename = pending_load_filename;
+         pending_load_filename.clear();
+         current_tree = nullptr;
+      }
+      else
+      {
+         load_pending_tree();
+      }
+
       const bool filter_text_changed = (previous_filter_text != filter_text);
       if (filter_text_changed)
          result += create_filter();
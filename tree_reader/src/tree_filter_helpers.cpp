@@ -1,4 +1,8 @@
 #include "dak/tree_reader/tree_filter_helpers.h"
+#include "dak/tree_reader/named_filters.h"
+
+#include <algorithm>
+#include <typeinfo>
 
 namespace dak::tree_reader
 {
@@ -28,5 +32,197 @@ namespace dak::tree_reader
 
       return true;
    }
-}
 
+   bool is_text_only_filter(const tree_filter_ptr_t& filter)
+   {
+      if (!filter)
+         return true;
+
+      if (auto named = dynamic_pointer_cast<named_tree_filter_t>(filter))
+         return is_text_only_filter(named->filter);
+
+      if (dynamic_pointer_cast<not_tree_filter_t>(filter))
+         return is_text_only_filter(dynamic_pointer_cast<delegate_tree_filter_t>(filter)->sub_filter);
+
+      if (auto combined = dynamic_pointer_cast<combine_tree_filter_t>(filter))
+      {
+         for (const auto& child : combined->filters)
+            if (!is_text_only_filter(child))
+               return false;
+         return true;
+      }
+
+      return dynamic_pointer_cast<accept_tree_filter_t>(filter)
+          || dynamic_pointer_cast<contains_tree_filter_t>(filter)
+          || dynamic_pointer_cast<regex_tree_filter_t>(filter)
+          || dynamic_pointer_cast<text_address_tree_filter_t>(filter);
+   }
+
+   // Gather the texts searched by a contains filter or an and of contains filters.
+   static bool get_contained_texts(const tree_filter_ptr_t& filter, vector<wstring>& texts)
+   {
+      if (auto contains = dynamic_pointer_cast<contains_tree_filter_t>(filter))
+      {
+         texts.emplace_back(contains->contained);
+         return true;
+      }
+
+      if (auto combined = dynamic_pointer_cast<and_tree_filter_t>(filter))
+      {
+         for (const auto& child : combined->filters)
+            if (!get_contained_texts(child, texts))
+               return false;
+         return true;
+      }
+
+      return false;
+   }
+
+   bool is_narrower_contains_filter(const tree_filter_ptr_t& narrower, const tree_filter_ptr_t& wider)
+   {
+      vector<wstring> narrower_texts;
+      vector<wstring> wider_texts;
+      if (!get_contained_texts(narrower, narrower_texts) || !get_contained_texts(wider, wider_texts))
+         return false;
+
+      for (const auto& wider_text : wider_texts)
+      {
+         const bool found = any_of(narrower_texts.begin(), narrower_texts.end(), [&wider_text](const wstring& text)
+         {
+            return text.find(wider_text) != wstring::npos;
+         });
+         if (!found)
+            return false;
+      }
+
+      return true;
+   }
+
+   static bool is_stateless_filter(const tree_filter_t* filter, vector<const tree_filter_t*>& named_in_progress)
+   {
+      if (!filter)
+         return true;
+
+      if (auto named = dynamic_cast<const named_tree_filter_t*>(filter))
+      {
+         // A named filter that refers to itself is never stateless.
+         if (find(named_in_progress.begin(), named_in_progress.end(), named) != named_in_progress.end())
+            return false;
+
+         named_in_progress.emplace_back(named);
+         const bool stateless = is_stateless_filter(named->filter.get(), named_in_progress);
+         named_in_progress.pop_back();
+         return stateless;
+      }
+
+      if (auto combined = dynamic_cast<const combine_tree_filter_t*>(filter))
+      {
+         for (const auto& child : combined->filters)
+            if (!is_stateless_filter(child.get(), named_in_progress))
+               return false;
+         return true;
+      }
+
+      if (dynamic_cast<const not_tree_filter_t*>(filter)
+       || dynamic_cast<const remove_children_tree_filter_t*>(filter)
+       || typeid(*filter) == typeid(delegate_tree_filter_t))
+         return is_stateless_filter(static_cast<const delegate_tree_filter_t*>(filter)->sub_filter.get(), named_in_progress);
+
+      return dynamic_cast<const accept_tree_filter_t*>(filter)
+          || dynamic_cast<const contains_tree_filter_t*>(filter)
+          || dynamic_cast<const regex_tree_filter_t*>(filter)
+          || dynamic_cast<const text_address_tree_filter_t*>(filter)
+          || dynamic_cast<const level_range_tree_filter_t*>(filter);
+   }
+
+   bool is_stateless_filter(const tree_filter_t& filter)
+   {
+      vector<const tree_filter_t*> named_in_progress;
+      return is_stateless_filter(&filter, named_in_progress);
+   }
+
+   bool is_stateless_filter(const tree_filter_ptr_t& filter)
+   {
+      vector<const tree_filter_t*> named_in_progress;
+      return is_stateless_filter(filter.get(), named_in_progress);
+   }
+
+   static bool is_streamable_filter(const tree_filter_t* filter, vector<const tree_filter_t*>& named_in_progress)
+   {
+      if (!filter)
+         return true;
+
+      if (auto named = dynamic_cast<const named_tree_filter_t*>(filter))
+      {
+         // A named filter that refers to itself is never streamable.
+         if (find(named_in_progress.begin(), named_in_progress.end(), named) != named_in_progress.end())
+            return false;
+
+         named_in_progress.emplace_back(named);
+         const bool streamable = is_streamable_filter(named->filter.get(), named_in_progress);
+         named_in_progress.pop_back();
+         return streamable;
+      }
+
+      if (auto combined = dynamic_cast<const combine_tree_filter_t*>(filter))
+      {
+         for (const auto& child : combined->filters)
+            if (!is_streamable_filter(child.get(), named_in_progress))
+               return false;
+         return true;
+      }
+
+      if (dynamic_cast<const not_tree_filter_t*>(filter)
+       || dynamic_cast<const under_tree_filter_t*>(filter)
+       || dynamic_cast<const remove_children_tree_filter_t*>(filter)
+       || dynamic_cast<const stop_when_kept_tree_filter_t*>(filter)
+       || dynamic_cast<const until_tree_filter_t*>(filter)
+       || typeid(*filter) == typeid(delegate_tree_filter_t))
+         return is_streamable_filter(static_cast<const delegate_tree_filter_t*>(filter)->sub_filter.get(), named_in_progress);
+
+      return dynamic_cast<const accept_tree_filter_t*>(filter)
+          || dynamic_cast<const stop_tree_filter_t*>(filter)
+          || dynamic_cast<const contains_tree_filter_t*>(filter)
+          || dynamic_cast<const regex_tree_filter_t*>(filter)
+          || dynamic_cast<const level_range_tree_filter_t*>(filter);
+   }
+
+   bool is_streamable_filter(const tree_filter_t& filter)
+   {
+      vector<const tree_filter_t*> named_in_progress;
+      return is_streamable_filter(&filter, named_in_progress);
+   }
+
+   bool is_streamable_filter(const tree_filter_ptr_t& filter)
+   {
+      vector<const tree_filter_t*> named_in_progress;
+      return is_streamable_filter(filter.get(), named_in_progress);
+   }
+
+   static tree_filter_ptr_t deep_clone_filter(const tree_filter_t& filter, vector<const tree_filter_t*>& named_in_progress)
+   {
+      // Cloning already clones the sub-filters, except those of named filters.
+      tree_filter_ptr_t clone = filter.clone();
+      visit_filters(clone, [&named_in_progress](const tree_filter_ptr_t& sub_filter)
+      {
+         auto named = dynamic_pointer_cast<named_tree_filter_t>(sub_filter);
+         if (!named || !named->filter)
+            return true;
+         if (find(named_in_progress.begin(), named_in_progress.end(), named->filter.get()) != named_in_progress.end())
+            return true;
+
+         named_in_progress.emplace_back(named->filter.get());
+         named->filter = deep_clone_filter(*named->filter, named_in_progress);
+         named_in_progress.pop_back();
+         return true;
+      });
+
+      return clone;
+   }
+
+   tree_filter_ptr_t deep_clone_filter(const tree_filter_t& filter)
+   {
+      vector<const tree_filter_t*> named_in_progress;
+      return deep_clone_filter(filter, named_in_progress);
+   }
+}
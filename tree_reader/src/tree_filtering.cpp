@@ -1,5 +1,16 @@
 #include "dak/tree_reader/tree_filtering.h"
 #include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/compiled_tree_filter.h"
+#include "dak/tree_reader/utf8_tree_filter.h"
+#include "dak/tree_reader/lazy_text_tree.h"
+#include "dak/tree_reader/tree_filter_helpers.h"
+#include "dak/tree_reader/text_line_batch_queue.h"
+#include "dak/tree_reader/buffers_text_holder.h"
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <unordered_map>
 
 namespace dak::tree_reader
 {
@@ -22,55 +33,253 @@ namespace dak::tree_reader
       _fill_children.push_back(false);
    }
 
-   tree_visitor_t::result_t filter_tree_visitor_t::visit(const text_tree_t& tree, const node& source_node, const size_t source_level)
+   // Access to the nodes of the filtered trees.
+   //
+   // The wide and UTF-8 trees use node pointers.
+
+   template <class TREE>
+   static typename TREE::node_t* no_filtered_node(const TREE&) { return nullptr; }
+
+   template <class TREE>
+   static typename TREE::node_t* filtered_parent(const TREE&, typename TREE::node_t* node) { return node->parent; }
+
+   template <class TREE, class NODE>
+   static NODE add_filtered_child(TREE& tree, NODE under, const typename TREE::node_t& source_node) { return tree.add_child(under, source_node.text_ptr, source_node.text_length, source_node.text_hash); }
+
+   // Collecting the filtered nodes of a streamed text as they are added, without building a tree.
+   //
+   // The filtered nodes are their depth plus one, zero being no node.
+
+   struct kept_text_lines_t
    {
-      _filtered_branch_nodes.resize(source_level + 1, nullptr);
-      _fill_children.resize(source_level + 1, false);
+      text_line_batch_t& batch;
+   };
 
-      // Either the index of the newly created filtered node if kept, or -1 if not kept.
-      node* filtered_node = nullptr;
+   static size_t no_filtered_node(const kept_text_lines_t&) { return 0; }
+   static size_t filtered_parent(const kept_text_lines_t&, size_t node) { return node - 1; }
+   static size_t add_filtered_child(kept_text_lines_t& tree, size_t under, const node& source_node)
+   {
+      tree.batch.add_line(source_node.text(), under);
+      return under + 1;
+   }
 
-      const tree_filter_t::result_t result = filter.is_kept(tree, source_node, source_level);
-      if (result.keep)
+   // Add a source node to the filtered tree if kept, connecting it to the nearest
+   // kept node in the current filtered branch.
+   //
+   // Shared by the wide and UTF-8 trees and the kept lines of a streamed text.
+
+   template <class TREE, class NODE, class SOURCE_NODE>
+   static void add_filtered_node(TREE& filtered_tree, vector<NODE>& filtered_branch_nodes, vector<bool>& fill_children,
+                                 const SOURCE_NODE& source_node, const size_t source_level, bool keep)
+   {
+      const NODE no_node = no_filtered_node(filtered_tree);
+
+      filtered_branch_nodes.resize(source_level + 1, no_node);
+      fill_children.resize(source_level + 1, false);
+
+      // Either the newly created filtered node if kept, or no node if not kept.
+      NODE filtered_node = no_node;
+
+      if (keep)
       {
          // Connect to the nearest node in the branch.
-         node* add_under = nullptr;
-         for (size_t level = source_level; level < _filtered_branch_nodes.size(); --level)
+         NODE add_under = no_node;
+         for (size_t level = source_level; level < filtered_branch_nodes.size(); --level)
          {
-            if (_filtered_branch_nodes[level])
+            if (filtered_branch_nodes[level] != no_node)
             {
                // If the node is at the same level, do not add as a child.
-               add_under = (level < source_level && _fill_children[level]) ? _filtered_branch_nodes[level] : _filtered_branch_nodes[level]->parent;
+               add_under = (level < source_level && fill_children[level]) ? filtered_branch_nodes[level] : filtered_parent(filtered_tree, filtered_branch_nodes[level]);
                break;
             }
          }
 
-         filtered_node = filtered_tree.add_child(add_under, source_node.text_ptr);
+         filtered_node = add_filtered_child(filtered_tree, add_under, source_node);
       }
 
       // If kept, this node is the new active node for this level.
       // If not kept, do not over-write a sibling node that may exists at this level.
-      _filtered_branch_nodes.resize(source_level + 1, nullptr);
-      if (filtered_node)
-         _filtered_branch_nodes[source_level] = filtered_node;
+      filtered_branch_nodes.resize(source_level + 1, no_node);
+      if (filtered_node != no_node)
+         filtered_branch_nodes[source_level] = filtered_node;
 
       // If the node is kept, start to add sub-node as children.
       // If not kept, make any existing singling node begin to add node as sibling instead
       // of children.
-      _fill_children.resize(source_level + 1, false);
-      _fill_children[source_level] = (filtered_node != nullptr);
+      fill_children.resize(source_level + 1, false);
+      fill_children[source_level] = (filtered_node != no_node);
+   }
+
+   tree_visitor_t::result_t filter_tree_visitor_t::visit(const text_tree_t& tree, const node& source_node, const size_t source_level)
+   {
+      const tree_filter_t::result_t result = filter.is_kept(tree, source_node, source_level);
+
+      add_filtered_node(filtered_tree, _filtered_branch_nodes, _fill_children, source_node, source_level, result.keep);
 
       // note: we really do want to slice the result down to the tree_visitor::result type.
       return tree_visitor_t::result_t(result);
    }
 
-   void filter_tree(const text_tree_t& source_tree, text_tree_t& filteredTree, tree_filter_t& filter)
+   ////////////////////////////////////////////////////////////////////////////
+   //
+   // Parallel filtering.
+
+   namespace
+   {
+      // Trees with fewer nodes are filtered by a single thread.
+      constexpr size_t min_parallel_nodes = 20000;
+
+      // Each thread gets about this many sub-trees, so that threads that finish early take more.
+      constexpr size_t subtrees_per_thread = 8;
+
+      constexpr result stop_and_drop { true, false, false };
+
+      ////////////////////////////////////////////////////////////////////////////
+      //
+      // filter that gives the results of a stateless filter evaluated in parallel
+      // over all the sub-trees at a given depth. The few nodes above that depth
+      // are filtered when visited.
+      //
+      // The results of each sub-tree are kept in visiting order, so they are given
+      // back in order when the tree is visited to build the filtered tree.
+
+      struct parallel_tree_filter_t : tree_filter_t
+      {
+         parallel_tree_filter_t(const text_tree_t& tree, tree_filter_t& filter, size_t thread_count, const leaf_match_cache_ptr_t& cache, const atomic<bool>* abort);
+
+         result_t is_kept(const text_tree_t& tree, const node& a_node, size_t level) override;
+         wstring get_name() const override { return _source.get_name(); }
+         wstring get_short_name() const override { return _source.get_short_name(); }
+         wstring get_description() const override { return _source.get_description(); }
+         tree_filter_ptr_t clone() const override { return _source.clone(); }
+
+      private:
+         void filter_subtree(const text_tree_t& tree, size_t index, tree_filter_t& filter, const atomic<bool>* abort);
+
+         tree_filter_t& _source;
+         compiled_tree_filter_t _compiled;
+
+         size_t _split_depth = 0;
+         vector<const node*> _subtrees;
+         unordered_map<const node*, size_t> _subtree_indexes;
+         vector<vector<result>> _results;
+
+         const vector<result>* _current_results = nullptr;
+         size_t _next_result = 0;
+      };
+
+      parallel_tree_filter_t::parallel_tree_filter_t(const text_tree_t& tree, tree_filter_t& filter, size_t thread_count, const leaf_match_cache_ptr_t& cache, const atomic<bool>* abort)
+      : _source(filter), _compiled(filter, cache)
+      {
+         // note: the leaf matches that are not cached are found by multiple threads in the cache.
+         _compiled.begin_filtering(tree);
+
+         // Go deeper until there are enough sub-trees to share between the threads.
+         _subtrees.assign(tree.roots.begin(), tree.roots.end());
+         while (_subtrees.size() < thread_count * subtrees_per_thread)
+         {
+            vector<const node*> children;
+            for (const node* a_node : _subtrees)
+               children.insert(children.end(), a_node->children.begin(), a_node->children.end());
+            if (children.empty())
+               break;
+
+            _subtrees = move(children);
+            ++_split_depth;
+         }
+
+         for (size_t index = 0; index < _subtrees.size(); ++index)
+            _subtree_indexes[_subtrees[index]] = index;
+         _results.resize(_subtrees.size());
+
+         // Each thread has its own copy of the filter and takes the next sub-tree when done.
+         atomic<size_t> next_subtree = 0;
+         auto filter_subtrees = [this, &tree, &filter, &cache, &next_subtree, abort]()
+         {
+            compiled_tree_filter_t compiled(deep_clone_filter(filter), cache);
+            compiled.begin_filtering(tree);
+            for (size_t index = next_subtree++; index < _subtrees.size(); index = next_subtree++)
+               filter_subtree(tree, index, compiled, abort);
+         };
+
+         vector<future<void>> threads;
+         for (size_t i = 1; i < thread_count; ++i)
+            threads.emplace_back(async(launch::async, filter_subtrees));
+         filter_subtrees();
+         for (auto& thread : threads)
+            thread.get();
+      }
+
+      void parallel_tree_filter_t::filter_subtree(const text_tree_t& tree, size_t index, tree_filter_t& filter, const atomic<bool>* abort)
+      {
+         // Visit the sub-tree in the same order as visit_in_order.
+         vector<result>& results = _results[index];
+         vector<const node*> to_visit(1, _subtrees[index]);
+         while (!to_visit.empty())
+         {
+            if (abort && *abort)
+               return;
+
+            const node* a_node = to_visit.back();
+            to_visit.pop_back();
+
+            const result result = filter.is_kept(tree, *a_node, a_node->depth);
+            results.emplace_back(result);
+            if (result.stop)
+               return;
+
+            if (!result.skip_children)
+               to_visit.insert(to_visit.end(), a_node->children.rbegin(), a_node->children.rend());
+         }
+      }
+
+      result parallel_tree_filter_t::is_kept(const text_tree_t& tree, const node& a_node, size_t level)
+      {
+         if (level < _split_depth)
+            return _compiled.is_kept(tree, a_node, level);
+
+         if (level == _split_depth)
+         {
+            _current_results = &_results[_subtree_indexes[&a_node]];
+            _next_result = 0;
+         }
+
+         // Results are missing when aborted.
+         if (!_current_results || _next_result >= _current_results->size())
+            return stop_and_drop;
+
+         return (*_current_results)[_next_result++];
+      }
+
+      bool should_filter_in_parallel(const text_tree_t& tree, const tree_filter_t& filter)
+      {
+         return tree.size() >= min_parallel_nodes && thread::hardware_concurrency() > 1 && is_stateless_filter(filter);
+      }
+   }
+
+   void filter_tree_in_parallel(const text_tree_t& source_tree, text_tree_t& filtered_tree, tree_filter_t& filter, size_t thread_count, const leaf_match_cache_ptr_t& cache)
    {
-      filter_tree_visitor_t visitor(source_tree, filteredTree, filter);
+      if (thread_count <= 1 || !is_stateless_filter(filter))
+      {
+         compiled_tree_filter_t compiled(filter, cache);
+         compiled.begin_filtering(source_tree);
+         filter_tree_visitor_t visitor(source_tree, filtered_tree, compiled);
+         visit_in_order(source_tree, visitor);
+         return;
+      }
+
+      parallel_tree_filter_t parallel(source_tree, filter, thread_count, cache, nullptr);
+      filter_tree_visitor_t visitor(source_tree, filtered_tree, parallel);
       visit_in_order(source_tree, visitor);
    }
 
-   void filter_tree(const text_tree_t& source_tree, text_tree_t& filteredTree, const tree_filter_ptr_t& filter)
+   void filter_tree(const text_tree_t& source_tree, text_tree_t& filteredTree, tree_filter_t& filter, const leaf_match_cache_ptr_t& cache)
+   {
+      const bool parallel = should_filter_in_parallel(source_tree, filter);
+      filter_tree_in_parallel(source_tree, filteredTree, filter, parallel ? thread::hardware_concurrency() : 1, cache);
+   }
+
+   void filter_tree(const text_tree_t& source_tree, text_tree_t& filteredTree, const tree_filter_ptr_t& filter, const leaf_match_cache_ptr_t& cache)
    {
       if (!filter)
       {
@@ -78,19 +287,276 @@ namespace dak::tree_reader
          return;
       }
 
-      filter_tree(source_tree, filteredTree, *filter);
+      filter_tree(source_tree, filteredTree, *filter, cache);
+   }
+
+   void filter_tree(const utf8_text_tree_t& source_tree, utf8_text_tree_t& filtered_tree, utf8_tree_filter_t& filter)
+   {
+      filtered_tree.reset();
+      filtered_tree.source_text_lines = source_tree.source_text_lines;
+
+      // See filter_tree_visitor_t for why the level zero is already present.
+      vector<utf8_text_tree_t::node_t*> filtered_branch_nodes(1, nullptr);
+      vector<bool> fill_children(1, false);
+
+      visit_in_order(source_tree, [&](const utf8_text_tree_t& tree, const utf8_text_tree_t::node_t& source_node, size_t source_level)
+      {
+         const utf8_tree_filter_t::result_t result = filter.is_kept(tree, source_node, source_level);
+         add_filtered_node(filtered_tree, filtered_branch_nodes, fill_children, source_node, source_level, result.keep);
+         return tree_visitor_t::result_t(result);
+      });
    }
 
-   async_filter_tree_result_t filter_tree_async(const text_tree_ptr_t& source_tree, const tree_filter_ptr_t& filter)
+   // filter the batches of lines read from the read queue and push the kept lines
+   // in the kept queue, with their depth in the filtered tree.
+
+   static void filter_text_lines(text_line_batch_queue_t& read_queue, text_line_batch_queue_t& kept_queue, tree_filter_t& filter)
+   {
+      // The streamable filters only look at the node they are given,
+      // so they are given an empty tree.
+      const text_tree_t tree;
+      compiled_tree_filter_t compiled(filter);
+      compiled.begin_filtering(tree);
+
+      text_line_batch_t kept_batch;
+      kept_text_lines_t kept { kept_batch };
+
+      // See filter_tree_visitor_t for why the level zero is already present.
+      vector<size_t> filtered_branch_nodes(1, 0);
+      vector<bool> fill_children(1, false);
+
+      // The same node is reused for each line, only its index tells them apart.
+      node source_node;
+      size_t index = 0;
+
+      // Lines deeper than this level are in a sub-tree whose children are skipped.
+      size_t skip_under_level = size_t(-1);
+
+      text_line_batch_t read_batch;
+      while (read_queue.pop(read_batch))
+      {
+         for (const auto& line : read_batch.lines)
+         {
+            const size_t level = line.depth;
+            if (level > skip_under_level)
+               continue;
+            skip_under_level = size_t(-1);
+
+            const wstring_view text = read_batch.text(line);
+            source_node.text_ptr = text.data();
+            source_node.text_length = text.size();
+            source_node.depth = level;
+            source_node.index = index++;
+
+            const result result = compiled.is_kept(tree, source_node, level);
+            add_filtered_node(kept, filtered_branch_nodes, fill_children, source_node, level, result.keep);
+
+            if (result.skip_children)
+               skip_under_level = level;
+
+            if (result.stop)
+            {
+               if (!kept_batch.empty())
+                  kept_queue.push(kept_batch);
+               return;
+            }
+         }
+
+         if (!kept_batch.empty() && !kept_queue.push(kept_batch))
+            return;
+      }
+   }
+
+   // filter the lines given by the reading function as they are read.
+   //
+   // The lines are read, filtered and used by three threads connected
+   // by queues of line batches, so reading, filtering and using overlap
+   // and the time taken is close to the time of the slowest of the three.
+   //
+   // The batches of kept lines are given to the using function on the
+   // calling thread, with their depth in the filtered tree.
+
+   template <class READ_LINES, class USE_KEPT_LINES>
+   static void filter_simple_text_lines(READ_LINES read_lines, tree_filter_t& filter, USE_KEPT_LINES use_kept_lines)
+   {
+      constexpr size_t lines_per_batch = 4096;
+
+      text_line_batch_queue_t read_queue;
+      text_line_batch_queue_t kept_queue;
+
+      auto reading = async(launch::async, [&read_lines, &read_queue]()
+      {
+         try
+         {
+            text_line_batch_t batch;
+            read_lines([&batch, &read_queue](wstring_view text, size_t depth)
+            {
+               batch.add_line(text, depth);
+               return batch.size() < lines_per_batch || read_queue.push(batch);
+            });
+            if (!batch.empty())
+               read_queue.push(batch);
+         }
+         catch (...)
+         {
+            read_queue.close();
+            throw;
+         }
+         read_queue.close();
+      });
+
+      auto filtering = async(launch::async, [&read_queue, &kept_queue, &filter]()
+      {
+         // Canceling the read queue stops the reading when the filter stopped early.
+         try
+         {
+            filter_text_lines(read_queue, kept_queue, filter);
+         }
+         catch (...)
+         {
+            read_queue.cancel();
+            kept_queue.close();
+            throw;
+         }
+         read_queue.cancel();
+         kept_queue.close();
+      });
+
+      try
+      {
+         text_line_batch_t batch;
+         while (kept_queue.pop(batch))
+            use_kept_lines(batch);
+      }
+      catch (...)
+      {
+         kept_queue.cancel();
+         throw;
+      }
+
+      // Report the errors of the other threads.
+      reading.get();
+      filtering.get();
+   }
+
+   // filter the lines given by the reading function and print the kept lines.
+
+   template <class READ_LINES>
+   static void filter_simple_text(READ_LINES read_lines, wostream& output, tree_filter_t& filter, const wstring& indentation)
+   {
+      wstring printed;
+      filter_simple_text_lines(read_lines, filter, [&output, &indentation, &printed](const text_line_batch_t& batch)
+      {
+         printed.clear();
+         for (const auto& line : batch.lines)
+         {
+            for (size_t indent = 0; indent < line.depth; ++indent)
+               printed += indentation;
+            printed += batch.text(line);
+            printed += L'\n';
+         }
+         output << printed;
+      });
+
+      output.flush();
+   }
+
+   void filter_simple_text(const filesystem::path& path, wostream& output, tree_filter_t& filter, const load_simple_text_tree_options_t& read_options, const wstring& indentation)
+   {
+      auto read_lines = [&path, &read_options](const read_line_function_t& func) { read_simple_text_lines(path, func, read_options); };
+      filter_simple_text(read_lines, output, filter, indentation);
+   }
+
+   void filter_simple_text(wistream& input, wostream& output, tree_filter_t& filter, const load_simple_text_tree_options_t& read_options, const wstring& indentation)
+   {
+      auto read_lines = [&input, &read_options](const read_line_function_t& func) { read_simple_text_lines(input, func, read_options); };
+      filter_simple_text(read_lines, output, filter, indentation);
+   }
+
+   void filter_simple_text(const lazy_text_tree_t& tree, wostream& output, tree_filter_t& filter, const wstring& indentation)
+   {
+      auto read_lines = [&tree](const read_line_function_t& func) { tree.read_lines(func); };
+      filter_simple_text(read_lines, output, filter, indentation);
+   }
+
+   void filter_simple_text(const lazy_text_tree_t& tree, text_tree_t& filtered_tree, tree_filter_t& filter)
+   {
+      auto holder = make_shared<buffers_text_holder_t>();
+
+      // The node of each level of the current branch of the filtered tree.
+      vector<node*> branch;
+
+      auto read_lines = [&tree](const read_line_function_t& func) { tree.read_lines(func); };
+      filter_simple_text_lines(read_lines, filter, [&filtered_tree, &holder, &branch](const text_line_batch_t& batch)
+      {
+         // The texts of each batch are kept in their own buffer, which never moves.
+         auto buffer = make_shared<buffers_text_holder_t::buffer>(batch.texts.begin(), batch.texts.end());
+         holder->text_buffers.emplace_back(buffer);
+
+         for (const auto& line : batch.lines)
+         {
+            branch.resize(line.depth);
+            branch.emplace_back(filtered_tree.add_child(branch.empty() ? nullptr : branch.back(), buffer->data() + line.text_index, line.text_length));
+         }
+      });
+
+      filtered_tree.source_text_lines = holder;
+   }
+
+   // See filter_tree_visitor_t for why the level zero is already in the filtered branch.
+
+   appended_nodes_filtering_t::appended_nodes_filtering_t(const tree_filter_ptr_t& filter)
+      : _filter(make_shared<compiled_tree_filter_t>(filter ? deep_clone_filter(*filter) : accept()))
+      , _filtered_branch_nodes(1, nullptr), _fill_children(1, false)
+   {
+   }
+
+   void appended_nodes_filtering_t::filter_appended_nodes(const text_tree_t& source_tree)
+   {
+      // The appended nodes may have their text in a new holder.
+      filtered_tree->source_text_lines = source_tree.source_text_lines;
+
+      if (_filtered_count == 0)
+         _filter->begin_filtering(source_tree);
+
+      for (; _filtered_count < source_tree.size() && !_stopped; ++_filtered_count)
+      {
+         const node& source_node = source_tree.node(_filtered_count);
+         const size_t level = source_node.depth;
+         if (level > _skip_under_level)
+            continue;
+         _skip_under_level = size_t(-1);
+
+         const result result = _filter->is_kept(source_tree, source_node, level);
+         add_filtered_node(*filtered_tree, _filtered_branch_nodes, _fill_children, source_node, level, result.keep);
+
+         if (result.skip_children)
+            _skip_under_level = level;
+
+         _stopped = result.stop;
+      }
+   }
+
+   async_filter_tree_result_t filter_tree_async(const text_tree_ptr_t& source_tree, const tree_filter_ptr_t& filter, const leaf_match_cache_ptr_t& cache)
    {
       if (!filter)
          return {};
 
       auto abort = make_shared<can_abort_tree_visitor>();
-      auto fut = async(launch::async, [source_tree, filter, abort]()
+      auto fut = async(launch::async, [source_tree, filter, cache, abort]()
       {
          text_tree_t filtered;
-         abort->visitor = make_shared<filter_tree_visitor_t>(*source_tree, filtered, *filter);
+         unique_ptr<tree_filter_t> prepared;
+         if (should_filter_in_parallel(*source_tree, *filter))
+         {
+            prepared = make_unique<parallel_tree_filter_t>(*source_tree, *filter, thread::hardware_concurrency(), cache, &abort->abort);
+         }
+         else
+         {
+            prepared = make_unique<compiled_tree_filter_t>(filter, cache);
+            prepared->begin_filtering(*source_tree);
+         }
+         abort->visitor = make_shared<filter_tree_visitor_t>(*source_tree, filtered, *prepared);
          visit_in_order(*source_tree, *abort);
          return filtered;
       });
@@ -0,0 +1,34 @@
+#include "dak/tree_reader/utf8_tree_filter.h"
+#include "dak/utility/text.h"
+
+#include <cstring>
+
+namespace dak::tree_reader
+{
+   using namespace std;
+   using result = utf8_tree_filter_t::result_t;
+   using node = utf8_text_tree_t::node_t;
+
+   constexpr result keep { false, false, true };
+   constexpr result drop { false, false, false };
+
+   result utf8_contains_tree_filter_t::is_kept(const utf8_text_tree_t& tree, const node& node, size_t level)
+   {
+      return _searcher.is_in(node.text()) ? keep : drop;
+   }
+
+   result utf8_regex_tree_filter_t::is_kept(const utf8_text_tree_t& tree, const node& node, size_t level)
+   {
+      return regex.search(node.text()) ? keep : drop;
+   }
+
+   shared_ptr<utf8_contains_tree_filter_t> utf8_contains(const wstring& text)
+   {
+      return make_shared<utf8_contains_tree_filter_t>(utility::to_utf8(text));
+   }
+
+   shared_ptr<utf8_regex_tree_filter_t> utf8_regex(const wstring& reg)
+   {
+      return make_shared<utf8_regex_tree_filter_t>(utility::to_utf8(reg));
+   }
+}
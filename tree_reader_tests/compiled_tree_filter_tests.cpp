@@ -0,0 +1,151 @@
+#include "dak/tree_reader/compiled_tree_filter.h"
+#include "dak/tree_reader/named_filters.h"
+#include "dak/tree_reader/tree_filtering.h"
+#include "tree_reader_test_helpers.h"
+
+#include "CppUnitTest.h"
+
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(compiled_tree_filter_tests)
+	{
+	public:
+
+		TEST_METHOD(compiled_filters_give_same_results)
+		{
+			named_filters_t named;
+			auto named_f = named.add(L"has-f", contains(L"f"));
+
+			const vector<tree_filter_ptr_t> filters =
+			{
+				accept(),
+				contains(L"g"),
+				dak::tree_reader::regex(L"[jm]"),
+				not(contains(L"f")),
+				or(contains(L"f"), contains(L"m")),
+				and(contains(L"m"), level_range(1, 2)),
+				any({ contains(L"x"), and(contains(L"p"), stop()), contains(L"d") }),
+				all({ not(contains(L"v")), or(contains(L"s"), until(contains(L"p"))), min_level(1) }),
+				no_child(contains(L"g"), true),
+				stop_when_kept(contains(L"m")),
+				and(under(contains(L"g"), false), contains(L"s")),
+				or(if_subtree(contains(L"x")), unique()),
+				or(named_f, contains(L"v")),
+				not(named.add(L"empty", tree_filter_ptr_t())),
+				any({ contains(L"b"), contains(L"kl"), not(contains(L"s")), named_f, dak::tree_reader::regex(L"wx"), contains(L"") }),
+				all({ not(contains(L"z")), contains(L""), not(dak::tree_reader::regex(L"q")), not(named_f), dak::tree_reader::regex(L"."), min_level(1) }),
+				any({ dak::tree_reader::regex(L"^g"), not(dak::tree_reader::regex(L"[ko]$")), dak::tree_reader::regex(L"s|w"), contains(L"b") }),
+				all({ dak::tree_reader::regex(L"^[a-m]"), dak::tree_reader::regex(L"\\w{3}"), not(dak::tree_reader::regex(L"e.")) }),
+				make_shared<or_tree_filter_t>(),
+				make_shared<and_tree_filter_t>(),
+			};
+
+			const text_tree_t tree = create_simple_tree();
+
+			for (const auto& filter : filters)
+			{
+				compiled_tree_filter_t compiled(filter->clone());
+				tree_filter_ptr_t reference = filter->clone();
+
+				compiled.begin_filtering(tree);
+				reference->begin_filtering(tree);
+
+				visit_in_order(tree, [&](const text_tree_t& tree, const text_tree_t::node_t& node, size_t level)
+				{
+					const tree_filter_t::result_t expected = reference->is_kept(tree, node, level);
+					const tree_filter_t::result_t result = compiled.is_kept(tree, node, level);
+
+					Assert::AreEqual(expected.keep, result.keep);
+					Assert::AreEqual(expected.stop, result.stop);
+					Assert::AreEqual(expected.skip_children, result.skip_children);
+
+					return tree_visitor_t::result_t();
+				});
+			}
+		}
+
+		TEST_METHOD(compiled_filter_short_circuits)
+		{
+			// The or jumps over the stop once kept, the and jumps over it once dropped.
+			compiled_tree_filter_t or_compiled(or(contains(L"a"), stop()));
+			compiled_tree_filter_t and_compiled(and(contains(L"a"), stop()));
+
+			const text_tree_t tree = create_simple_tree();
+			const auto& root = *tree.roots[0];
+			const auto& child = *root.children[0];
+
+			Assert::IsFalse(or_compiled.is_kept(tree, root, 0).stop);
+			Assert::IsTrue(or_compiled.is_kept(tree, child, 1).stop);
+
+			Assert::IsTrue(and_compiled.is_kept(tree, root, 0).stop);
+			Assert::IsFalse(and_compiled.is_kept(tree, child, 1).stop);
+		}
+
+		TEST_METHOD(planned_filters_give_same_results)
+		{
+			named_filters_t named;
+			auto named_rare = named.add(L"rare", all({ dak::tree_reader::regex(L"[a-z]+"), contains(L"v") }));
+
+			// Expensive and rarely decisive sub-filters come first, so planning reorders them.
+			// The level ranges that skip children prevent reordering.
+			const vector<tree_filter_ptr_t> filters =
+			{
+				all({ dak::tree_reader::regex(L"\\w"), not(contains(L"z")), contains(L"m") }),
+				any({ dak::tree_reader::regex(L"^q"), not(dak::tree_reader::regex(L"[a-z]")), contains(L"d"), min_level(3) }),
+				all({ any({ dak::tree_reader::regex(L"."), contains(L"a") }), not(named_rare), contains(L"s") }),
+				any({ named_rare, contains(L"abc") }),
+				all({ dak::tree_reader::regex(L"."), contains(L"g"), max_level(1) }),
+				any({ dak::tree_reader::regex(L"x"), contains(L"p"), level_range(1, 2) }),
+			};
+
+			const text_tree_t tree = create_simple_tree();
+
+			for (const auto& filter : filters)
+			{
+				compiled_tree_filter_t compiled(filter->clone());
+				tree_filter_ptr_t reference = filter->clone();
+
+				compiled.begin_filtering(tree);
+				reference->begin_filtering(tree);
+
+				visit_in_order(tree, [&](const text_tree_t& tree, const text_tree_t::node_t& node, size_t level)
+				{
+					const tree_filter_t::result_t expected = reference->is_kept(tree, node, level);
+					const tree_filter_t::result_t result = compiled.is_kept(tree, node, level);
+
+					Assert::AreEqual(expected.keep, result.keep);
+					Assert::AreEqual(expected.stop, result.stop);
+					Assert::AreEqual(expected.skip_children, result.skip_children);
+
+					return tree_visitor_t::result_t();
+				});
+			}
+		}
+
+		TEST_METHOD(filter_tree_uses_named_filters)
+		{
+			named_filters_t named;
+			auto named_g = named.add(L"g", contains(L"g"));
+
+			text_tree_t filtered;
+			filter_tree(create_simple_tree(), filtered, under(named_g, true));
+
+			wostringstream sstream;
+			sstream << filtered;
+
+			const wchar_t expected_output[] =
+				L"ghi\n"
+				L"  mno\n"
+				L"    pqr\n"
+				L"    stu\n"
+				L"      vwx\n";
+			Assert::AreEqual(expected_output, sstream.str().c_str());
+		}
+	};
+}
@@ -0,0 +1,185 @@
+#include "dak/tree_reader/lazy_text_tree.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/tree_filtering.h"
+#include "dak/tree_reader/tree_filter_command_line.h"
+#include "dak/tree_reader/tree_filter_maker.h"
+#include "dak/tree_reader/global_commands.h"
+#include "dak/tree_reader/text_tree_snapshot.h"
+#include "dak/tree_reader/tree_commands.h"
+#include "tree_reader_test_helpers.h"
+
+#include "CppUnitTest.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(lazy_text_tree_tests)
+	{
+	public:
+
+		// Write a file of many pages of lines, with empty lines and varying indentation.
+		static filesystem::path write_large_tree_file(const wchar_t* name)
+		{
+			const auto path = filesystem::temp_directory_path() / name;
+			wofstream file(path);
+			for (size_t i = 0; i < 3 * lazy_text_tree_t::lines_per_page; ++i)
+			{
+				file << wstring((i % 5) * 2, L' ') << L"line " << i << L"\n";
+				if (i % 97 == 0)
+					file << L"\n";
+			}
+			return path;
+		}
+
+		template <class NODES>
+		static vector<lazy_text_tree_t::node_id_t> node_ids(const NODES& nodes)
+		{
+			vector<lazy_text_tree_t::node_id_t> ids;
+			for (const auto node : nodes)
+				ids.emplace_back(lazy_text_tree_t::node_id_t(node->index));
+			return ids;
+		}
+
+		static void verify_same_tree(const lazy_text_tree_t& lazy, const text_tree_t& tree)
+		{
+			Assert::AreEqual(tree.size(), lazy.size());
+			for (size_t index = 0; index < tree.size(); ++index)
+			{
+				const auto node = lazy_text_tree_t::node_id_t(index);
+				const auto& tree_node = tree.node(index);
+				Assert::AreEqual(tree_node.parent ? lazy_text_tree_t::node_id_t(tree_node.parent->index) : lazy_text_tree_t::no_node, lazy.parents[index]);
+				Assert::AreEqual<size_t>(tree_node.depth, lazy.depths[index]);
+				Assert::AreEqual<size_t>(tree_node.index_in_parent, lazy.rows[index]);
+				Assert::AreEqual(wstring(tree_node.text_ptr, tree_node.text_length).c_str(), lazy.text(node).c_str());
+				Assert::IsTrue(node_ids(tree_node.children) == lazy.get_children(node));
+			}
+			Assert::IsTrue(node_ids(tree.roots) == lazy.get_children(lazy_text_tree_t::no_node));
+		}
+
+		TEST_METHOD(lazy_tree_gives_same_tree)
+		{
+			const auto path = write_large_tree_file(L"lazy_tree_gives_same_tree.txt");
+
+			auto lazy = load_lazy_text_tree(path);
+			Assert::IsTrue(lazy != nullptr);
+			Assert::AreEqual<size_t>(3, lazy->page_offsets.size());
+
+			// A single cached page makes every page change decode the page again.
+			lazy->max_cached_pages = 1;
+			verify_same_tree(*lazy, load_simple_text_tree(path));
+			Assert::AreEqual(L"line 2050", lazy->text(2050).c_str());
+			Assert::AreEqual(L"line 3", lazy->text(3).c_str());
+			Assert::AreEqual(L"", lazy->text(lazy_text_tree_t::node_id_t(lazy->size())).c_str());
+
+			// The input filter removes lines and changes the indentation.
+			load_simple_text_tree_options_t options;
+			options.input_filter = L"^( *line [0-9]*[02468])$";
+			lazy = load_lazy_text_tree(path, options);
+			Assert::IsTrue(lazy != nullptr);
+			verify_same_tree(*lazy, load_simple_text_tree(path, options));
+
+			lazy.reset();
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(filter_lazy_tree_gives_same_text)
+		{
+			const auto path = write_large_tree_file(L"filter_lazy_tree_gives_same_text.txt");
+
+			const auto lazy = load_lazy_text_tree(path);
+			Assert::IsTrue(lazy != nullptr);
+
+			const vector<tree_filter_ptr_t> filters = { accept(), contains(L"7"), not(contains(L"1")), level_range(1, 2), under(contains(L"line 1234"), false),
+			                                            stop_when_kept(contains(L"line 2500")) };
+			for (const auto& filter : filters)
+			{
+				wostringstream expected;
+				filter_simple_text(path, expected, *filter->clone(), load_simple_text_tree_options_t(), L"--");
+
+				wostringstream filtered;
+				filter_simple_text(*lazy, filtered, *filter->clone(), L"--");
+
+				Assert::AreEqual(expected.str().c_str(), filtered.str().c_str());
+
+				text_tree_t filtered_tree;
+				filter_simple_text(*lazy, filtered_tree, *filter->clone());
+
+				wostringstream printed;
+				print_tree(printed, filtered_tree, L"--");
+				Assert::AreEqual(expected.str().c_str(), printed.str().c_str());
+			}
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(command_line_filters_lazy_tree_like_streamed_file)
+		{
+			const auto path = write_large_tree_file(L"command_line_filters_lazy_tree_like_streamed_file.txt");
+
+			command_line_t ctx;
+			ctx.options.output_line_indent = L"--";
+			ctx.parse_commands(vector<wstring>{ L"load-lazy", path.wstring(), L"filter", L"7" });
+			Assert::IsTrue(ctx.lazy_tree != nullptr);
+
+			wostringstream filtered;
+			Assert::AreEqual(L"", ctx.filter_lazy_tree(filtered).c_str());
+
+			wostringstream expected;
+			filter_simple_text(path, expected, *convert_simple_text_to_filter(L"7", named_filters_t()), load_simple_text_tree_options_t(), L"--");
+			Assert::AreEqual(expected.str().c_str(), filtered.str().c_str());
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(file_larger_than_loaded_size_is_indexed_unless_it_has_a_snapshot)
+		{
+			const auto path = filesystem::temp_directory_path() / L"file_larger_than_loaded_size_is_indexed.txt";
+			{
+				wofstream file(path);
+				for (size_t i = 0; i < 100000; ++i)
+					file << wstring(i % 3, L' ') << L"line " << i << L"\n";
+			}
+			const auto snapshot_path = get_text_tree_snapshot_path(path);
+			filesystem::remove(snapshot_path);
+
+			global_commands_t ctx;
+			ctx.options.max_loaded_file_megabytes = 1;
+			Assert::IsFalse(ctx.can_load_tree(path));
+
+			lazy_text_tree_ptr_t lazy;
+			Assert::IsTrue(ctx.load_tree(path, lazy) == nullptr);
+			Assert::IsTrue(lazy != nullptr);
+			Assert::AreEqual<size_t>(100000, lazy->size());
+
+			// Without a limit, the file fits in memory and is loaded.
+			ctx.options.max_loaded_file_megabytes = 0;
+			Assert::IsTrue(ctx.can_load_tree(path));
+			auto loaded = ctx.load_tree(path, lazy);
+			Assert::IsTrue(loaded != nullptr);
+			Assert::IsTrue(lazy == nullptr);
+			Assert::IsTrue(ctx.save_tree_snapshot(loaded));
+
+			// The snapshot is used even above the limit.
+			ctx.options.max_loaded_file_megabytes = 1;
+			loaded = ctx.load_tree(path, lazy);
+			Assert::IsTrue(loaded != nullptr);
+			Assert::IsTrue(lazy == nullptr);
+			Assert::AreEqual<size_t>(100000, loaded->get_original_tree()->size());
+
+			loaded.reset();
+			filesystem::remove(snapshot_path);
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(lazy_tree_of_missing_file_is_null)
+		{
+			Assert::IsTrue(load_lazy_text_tree(filesystem::temp_directory_path() / L"lazy_tree_of_missing_file.txt") == nullptr);
+		}
+	};
+}
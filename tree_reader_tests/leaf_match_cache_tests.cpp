@@ -0,0 +1,116 @@
+#include "dak/tree_reader/leaf_match_cache.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/tree_filtering.h"
+#include "tree_reader_test_helpers.h"
+
+#include "CppUnitTest.h"
+
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(leaf_match_cache_tests)
+	{
+	public:
+
+		static wstring filter_to_text(const text_tree_t& tree, const tree_filter_ptr_t& filter, const leaf_match_cache_ptr_t& cache)
+		{
+			text_tree_t filtered;
+			filter_tree(tree, filtered, filter, cache);
+
+			wostringstream sstream;
+			sstream << filtered;
+			return sstream.str();
+		}
+
+		TEST_METHOD(cached_filters_give_same_results)
+		{
+			const text_tree_t tree = create_simple_tree();
+			auto cache = make_shared<leaf_match_cache_t>();
+
+			const vector<tree_filter_ptr_t> filters =
+			{
+				contains(L"g"),
+				not(contains(L"m")),
+				or(contains(L"d"), dak::tree_reader::regex(L"^s")),
+				and(contains(L"m"), max_level(2)),
+				under(dak::tree_reader::regex(L"[gm]")),
+				any({ contains(L"a"), contains(L"e"), contains(L"i"), contains(L"o"), contains(L"u") }),
+				no_child(contains(L"h")),
+			};
+
+			for (const auto& filter : filters)
+				Assert::AreEqual(filter_to_text(tree, filter, nullptr).c_str(), filter_to_text(tree, filter, cache).c_str());
+		}
+
+		TEST_METHOD(edited_filter_only_evaluates_new_leaves)
+		{
+			const text_tree_t tree = create_simple_tree();
+			auto cache = make_shared<leaf_match_cache_t>();
+
+			auto edited = contains(L"v");
+			auto filter = or(contains(L"d"), edited);
+			Assert::AreEqual(L"def\nvwx\n", filter_to_text(tree, filter, cache).c_str());
+			Assert::AreEqual<size_t>(2, cache->size());
+
+			// Changing one leaf adds its matches, the other leaf is read from the cache.
+			edited->contained = L"j";
+			Assert::AreEqual(L"def\n  jkl\n", filter_to_text(tree, filter, cache).c_str());
+			Assert::AreEqual<size_t>(3, cache->size());
+
+			// Going back to a previous text reuses its matches.
+			edited->contained = L"v";
+			Assert::AreEqual(L"def\nvwx\n", filter_to_text(tree, filter, cache).c_str());
+			Assert::AreEqual<size_t>(3, cache->size());
+		}
+
+		TEST_METHOD(many_leaves_are_found_together_and_kept)
+		{
+			// Large enough to be scanned by multiple threads.
+			text_tree_t tree;
+			auto text_lines = make_shared<text_lines_text_holder_t>();
+			for (size_t index = 0; index < leaf_match_cache_t::min_parallel_nodes + 1000; ++index)
+				text_lines->lines.emplace_back(L"line " + to_wstring(index * 7919 % 100000));
+			tree.source_text_lines = text_lines;
+			text_tree_t::node_t* parent = nullptr;
+			for (size_t index = 0; index < text_lines->lines.size(); ++index)
+			{
+				auto a_node = tree.add_child(index % 100 == 0 ? nullptr : parent, text_lines->lines[index].c_str());
+				if (index % 100 == 0)
+					parent = a_node;
+			}
+
+			vector<tree_filter_ptr_t> leaves;
+			for (size_t index = 0; index < 100; ++index)
+				leaves.emplace_back(contains(to_wstring(index * 37 + 1000)));
+			leaves.emplace_back(dak::tree_reader::regex(L"^line 1[0-9]$"));
+			leaves.emplace_back(dak::tree_reader::regex(L"99$"));
+			const auto filter = any(leaves);
+
+			auto cache = make_shared<leaf_match_cache_t>();
+			const wstring expected = filter_to_text(tree, filter, nullptr);
+			Assert::AreEqual(expected.c_str(), filter_to_text(tree, filter, cache).c_str());
+			Assert::AreEqual<size_t>(leaves.size(), cache->size());
+
+			// All the leaves are still cached.
+			Assert::AreEqual(expected.c_str(), filter_to_text(tree, filter, cache).c_str());
+			Assert::AreEqual<size_t>(leaves.size(), cache->size());
+		}
+
+		TEST_METHOD(cache_is_cleared_for_another_tree)
+		{
+			const text_tree_t tree = create_simple_tree();
+			auto cache = make_shared<leaf_match_cache_t>();
+			filter_to_text(tree, contains(L"g"), cache);
+
+			text_tree_t other;
+			other.add_child(nullptr, L"ghost");
+			Assert::AreEqual(L"ghost\n", filter_to_text(other, contains(L"g"), cache).c_str());
+			Assert::AreEqual<size_t>(1, cache->size());
+		}
+	};
+}
@@ -0,0 +1,66 @@
+#include "dak/tree_reader/line_scanner.h"
+
+#include "CppUnitTest.h"
+
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(line_scanner_tests)
+	{
+	public:
+
+		TEST_METHOD(scan_short_lines)
+		{
+			const string text = "abc\n  def\r\n\n\t jkl\n  ghi";
+
+			scanned_lines_t lines;
+			scan_lines(text.c_str(), text.size(), false, 4, lines);
+
+			Assert::AreEqual<size_t>(3, lines.size());
+			Assert::AreEqual<size_t>(0, lines.offsets[0]);
+			Assert::AreEqual<size_t>(3, lines.lengths[0]);
+			Assert::AreEqual<size_t>(0, lines.indents[0]);
+			Assert::AreEqual<size_t>(4, lines.offsets[1]);
+			Assert::AreEqual<size_t>(5, lines.lengths[1]);
+			Assert::AreEqual<size_t>(2, lines.indents[1]);
+			Assert::AreEqual<size_t>(2, lines.text_indexes[1]);
+			Assert::AreEqual<size_t>(12, lines.offsets[2]);
+			Assert::AreEqual<size_t>(5, lines.lengths[2]);
+			Assert::AreEqual<size_t>(5, lines.indents[2]);
+			Assert::AreEqual<size_t>(2, lines.text_indexes[2]);
+			Assert::AreEqual<size_t>(18, lines.scanned_end);
+
+			scan_lines(text.c_str(), text.size(), true, 4, lines);
+
+			Assert::AreEqual<size_t>(4, lines.size());
+			Assert::AreEqual<size_t>(18, lines.offsets[3]);
+			Assert::AreEqual<size_t>(5, lines.lengths[3]);
+			Assert::AreEqual<size_t>(2, lines.indents[3]);
+			Assert::AreEqual<size_t>(text.size(), lines.scanned_end);
+		}
+
+		TEST_METHOD(scan_long_wide_lines)
+		{
+			const wstring indentation = wstring(40, L' ') + L"\t" + wstring(30, L' ');
+			const wstring long_text = wstring(100, L'x');
+			const wstring text = L"\r\n" + indentation + long_text + L"\n" + long_text + L"\r";
+
+			scanned_lines_t lines;
+			scan_lines(text.c_str(), text.size(), false, 8, lines);
+
+			Assert::AreEqual<size_t>(2, lines.size());
+			Assert::AreEqual<size_t>(2, lines.offsets[0]);
+			Assert::AreEqual<size_t>(indentation.size() + long_text.size(), lines.lengths[0]);
+			Assert::AreEqual<size_t>(indentation.size(), lines.text_indexes[0]);
+			Assert::AreEqual<size_t>(indentation.size() + 7, lines.indents[0]);
+			Assert::AreEqual<size_t>(long_text.size(), lines.lengths[1]);
+			Assert::AreEqual<size_t>(0, lines.indents[1]);
+			Assert::AreEqual<size_t>(text.size(), lines.scanned_end);
+		}
+	};
+}
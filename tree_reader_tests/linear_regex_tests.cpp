@@ -0,0 +1,185 @@
+#include "dak/tree_reader/linear_regex.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/tree_filtering.h"
+#include "tree_reader_test_helpers.h"
+
+#include "CppUnitTest.h"
+
+#include <regex>
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(linear_regex_tests)
+	{
+	public:
+
+		static vector<wstring> patterns()
+		{
+			return {
+				L"", L"a", L"abc", L"a|b", L"ab|cd|ef", L"a*", L"a+", L"a?", L"a*?b", L"(a|ab)(c|bcd)",
+				L"^a", L"c$", L"^$", L"^abc$", L"a.c", L"[abc]+", L"[^a]", L"[a-c]*d", L"[]", L"[^]",
+				L"\\d+", L"\\w+", L"\\s", L"\\D\\W\\S", L"\\bab", L"b\\b", L"\\Bb", L"a{2}", L"a{1,2}", L"(ab){2,}",
+				L"(?:a|b)*c", L"(a*)*b", L"(a|b)*abb", L"x*", L"a\\.b", L"[\\]a]", L"\\u0161+", L"[a\\-c]", L"(a|)+b", L"a{0}b",
+				L"[[:digit:]]+", L"[[:alpha:]_]+", L"[^[:space:]]+", L"[[:punct:]]", L"[[:upper:][:digit:]]", L"[a[:digit:]]+", L"[[:w:]]+",
+			};
+		}
+
+		static vector<wstring> texts()
+		{
+			return {
+				L"", L"a", L"b", L"abc", L"aab", L"xabcx", L"ab cd ef", L"abbabb", L"aaaaac", L"a.b",
+				L"a]b", L"12 ab_3", L"ca", L"c", L"abcd", L"\u0161\u0161a", L"a-c", L"b ab", L"a\nc", L"ba",
+			};
+		}
+
+		TEST_METHOD(search_same_as_std_regex)
+		{
+			for (const auto& pattern : patterns())
+			{
+				linear_regex_t regex(pattern);
+				const wregex reference(pattern);
+
+				for (const auto& text : texts())
+				{
+					Assert::AreEqual(regex_search(text, reference), regex.search(text), (pattern + L" / " + text).c_str());
+				}
+			}
+		}
+
+		TEST_METHOD(find_same_as_std_regex)
+		{
+			for (const auto& pattern : patterns())
+			{
+				linear_regex_t regex(pattern);
+				const wregex reference(pattern);
+
+				for (const auto& text : texts())
+				{
+					wsmatch match;
+					const bool expected = regex_search(text, match, reference);
+
+					size_t match_start = 0, match_end = 0;
+					Assert::AreEqual(expected, regex.find(text, 0, match_start, match_end), (pattern + L" / " + text).c_str());
+					if (expected)
+					{
+						Assert::AreEqual<size_t>(match.position(0), match_start, (pattern + L" / " + text).c_str());
+						Assert::AreEqual<size_t>(match.position(0) + match.length(0), match_end, (pattern + L" / " + text).c_str());
+					}
+				}
+			}
+		}
+
+		TEST_METHOD(utf8_regex_searches_bytes)
+		{
+			utf8_linear_regex_t regex("\xC5\xA1+b");
+
+			Assert::IsTrue(regex.search("a\xC5\xA1\xC5\xA1" "b"));
+			Assert::IsFalse(regex.search("a\xC5\xA1" "c"));
+		}
+
+		TEST_METHOD(default_regex_matches_nothing)
+		{
+			linear_regex_t regex;
+
+			Assert::IsFalse(regex.search(L""));
+			Assert::IsFalse(regex.search(L"abc"));
+		}
+
+		TEST_METHOD(unsupported_patterns_throw)
+		{
+			for (const wchar_t* pattern : { L"(a)\\1", L"a(?=b)", L"a(?!b)", L"(ab", L"ab)", L"[ab", L"*a", L"a{2,1}", L"[b-a]", L"a{5000}",
+			                                   L"[[.a.]]", L"[[=a=]]", L"[[:foo:]]", L"[[:digit]" })
+			{
+				bool thrown = false;
+				try
+				{
+					linear_regex_t regex(pattern);
+				}
+				catch (const regex_error&)
+				{
+					thrown = true;
+				}
+				Assert::IsTrue(thrown, pattern);
+			}
+		}
+
+		TEST_METHOD(named_classes_match_their_characters)
+		{
+			linear_regex_t digit(L"^[[:digit:]]$");
+			Assert::IsTrue(digit.search(L"5"));
+			Assert::IsFalse(digit.search(L"d]"));
+			Assert::IsFalse(digit.search(L":]"));
+
+			linear_regex_t alpha(L"^[[:alpha:]]+$");
+			Assert::IsTrue(alpha.search(L"abcXYZ"));
+			Assert::IsFalse(alpha.search(L"a1"));
+			Assert::IsFalse(alpha.search(L"]"));
+		}
+
+				TEST_METHOD(nested_repetitions_match_in_linear_time)
+		{
+			// This pattern takes exponential time in a backtracking engine.
+			const wstring text(20000, L'a');
+
+			linear_regex_t regex(L"(a*)*b");
+			Assert::IsFalse(regex.search(text));
+
+			size_t match_start = 0, match_end = 0;
+			Assert::IsFalse(regex.find(text, 0, match_start, match_end));
+
+			linear_regex_t word_regex(L"\\b(a|aa)*\\bc");
+			Assert::IsFalse(word_regex.search(text));
+		}
+
+		TEST_METHOD(find_continuous_and_not_empty)
+		{
+			linear_regex_t regex(L"a*");
+			size_t match_start = 0, match_end = 0;
+
+			Assert::IsTrue(regex.find(L"baa", 0, match_start, match_end));
+			Assert::AreEqual<size_t>(0, match_start);
+			Assert::AreEqual<size_t>(0, match_end);
+
+			Assert::IsFalse(regex.find(L"baa", 0, match_start, match_end, true, true));
+
+			Assert::IsTrue(regex.find(L"baa", 0, match_start, match_end, false, true));
+			Assert::AreEqual<size_t>(1, match_start);
+			Assert::AreEqual<size_t>(3, match_end);
+		}
+
+		TEST_METHOD(regex_set_finds_all_matching_regexes)
+		{
+			linear_regex_set_t regexes({ L"^a", L"b+c", L"d$", L"x", L"" });
+
+			vector<bool> found;
+			regexes.find_all(L"abbcd", found);
+
+			Assert::AreEqual<size_t>(5, regexes.size());
+			Assert::IsTrue(found == vector<bool>{ true, true, true, false, true });
+
+			regexes.find_all(L"bd", found);
+			Assert::IsTrue(found == vector<bool>{ false, false, true, false, true });
+		}
+
+		TEST_METHOD(regex_filter_uses_changed_text)
+		{
+			auto filter = dak::tree_reader::regex(L"g");
+
+			text_tree_t filtered;
+			filter_tree(create_simple_tree(), filtered, filter);
+
+			filter->regex_text = L"^m.o$";
+			filter_tree(create_simple_tree(), filtered, filter);
+
+			wostringstream sstream;
+			sstream << filtered;
+
+			Assert::AreEqual(L"mno\n", sstream.str().c_str());
+		}
+	};
+}
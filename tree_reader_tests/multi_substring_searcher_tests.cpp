@@ -0,0 +1,66 @@
+#include "dak/tree_reader/multi_substring_searcher.h"
+
+#include "CppUnitTest.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(multi_substring_searcher_tests)
+	{
+	public:
+
+		TEST_METHOD(find_overlapping_needles)
+		{
+			const multi_substring_searcher_t searcher({ L"he", L"she", L"his", L"hers", L"", L"\u0161e" });
+			Assert::AreEqual<size_t>(6, searcher.size());
+
+			vector<bool> found;
+			searcher.find_all(L"ushers", found);
+
+			const vector<bool> expected = { true, true, false, true, true, false };
+			Assert::IsTrue(expected == found);
+
+			searcher.find_all(L"\u0161e", found);
+			const vector<bool> expected_high = { false, false, false, false, true, true };
+			Assert::IsTrue(expected_high == found);
+		}
+
+		TEST_METHOD(find_same_as_find)
+		{
+			const wchar_t letters[] = { L'a', L'b', L'c', L'\u0161' };
+
+			unsigned seed = 7;
+			auto next_letter = [&]() { seed = seed * 1103515245u + 12345u; return letters[(seed >> 16) % 4]; };
+
+			vector<wstring> needles;
+			for (size_t needle_size = 1; needle_size < 7; ++needle_size)
+			{
+				for (size_t count = 0; count < 5; ++count)
+				{
+					wstring needle;
+					for (size_t i = 0; i < needle_size; ++i)
+						needle += next_letter();
+					needles.emplace_back(needle);
+				}
+			}
+
+			const multi_substring_searcher_t searcher(needles);
+
+			for (size_t text_size = 0; text_size < 100; text_size += 3)
+			{
+				wstring text;
+				for (size_t i = 0; i < text_size; ++i)
+					text += next_letter();
+
+				vector<bool> found;
+				searcher.find_all(text, found);
+
+				for (size_t index = 0; index < needles.size(); ++index)
+					Assert::AreEqual(text.find(needles[index]) != wstring::npos, bool(found[index]));
+			}
+		}
+	};
+}
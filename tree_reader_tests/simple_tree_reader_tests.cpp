@@ -1,9 +1,12 @@
 #include "dak/tree_reader/simple_tree_reader.h"
+#include "dak/tree_reader/mapped_text_holder.h"
+#include "dak/tree_reader/text_tree_visitor.h"
 #include "tree_reader_test_helpers.h"
 
 #include "CppUnitTest.h"
 
 #include <sstream>
+#include <fstream>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace std;
@@ -67,5 +70,205 @@ namespace dak::tree_reader_tests
 				L"        vwx\n";
 			Assert::AreEqual(expected_output, sstream2.str().c_str());
 		}
+
+		TEST_METHOD(read_simple_tree_records_length_and_depth)
+		{
+			wstringstream sstream;
+			sstream << L"abc\n  de\n    f\n  ghij\n";
+			sstream.seekg(0);
+
+			text_tree_t tree = load_simple_text_tree(sstream);
+
+			Assert::AreEqual<size_t>(1, tree.roots.size());
+			const auto root = tree.roots[0];
+			Assert::AreEqual<size_t>(3, root->text_length);
+			Assert::AreEqual<size_t>(0, root->depth);
+			Assert::AreEqual<size_t>(2, root->children[0]->text_length);
+			Assert::AreEqual<size_t>(1, root->children[0]->depth);
+			Assert::AreEqual<size_t>(1, root->children[0]->children[0]->text_length);
+			Assert::AreEqual<size_t>(2, root->children[0]->children[0]->depth);
+			Assert::AreEqual<size_t>(4, root->children[1]->text_length);
+			Assert::AreEqual<size_t>(1, root->children[1]->depth);
+		}
+
+		TEST_METHOD(read_lines_one_at_a_time_with_tree_depths)
+		{
+			// Irregular indentation, going back to levels that were never used.
+			const wchar_t text[] = L" a\n   b\n     c\n    d\n  e\n f\n\tg\n   h\n i\n";
+
+			wistringstream tree_stream(text);
+			text_tree_t tree = load_simple_text_tree(tree_stream);
+
+			wstring expected;
+			visit_in_order(tree, [&expected](const text_tree_t& tree, const text_tree_t::node_t& node, size_t level)
+			{
+				expected += wstring(node.text()) + to_wstring(level) + L"|";
+				return tree_visitor_t::result_t();
+			});
+
+			wstring streamed;
+			wistringstream lines_stream(text);
+			read_simple_text_lines(lines_stream, [&streamed](wstring_view text, size_t depth)
+			{
+				streamed += wstring(text) + to_wstring(depth) + L"|";
+				return true;
+			});
+			Assert::AreEqual(expected.c_str(), streamed.c_str());
+
+			const auto path = filesystem::temp_directory_path() / L"read_lines_one_at_a_time_with_tree_depths.txt";
+			{
+				wofstream file(path);
+				file << text;
+			}
+
+			wstring mapped;
+			read_simple_text_lines(path, [&mapped](wstring_view text, size_t depth)
+			{
+				mapped += wstring(text) + to_wstring(depth) + L"|";
+				return mapped.size() < 8;
+			});
+			filesystem::remove(path);
+
+			// Reading stops when the function returns false.
+			Assert::AreEqual(expected.substr(0, mapped.size()).c_str(), mapped.c_str());
+			Assert::AreEqual(L"a0|b1|c2|", mapped.c_str());
+		}
+
+		TEST_METHOD(read_mapped_utf8_tree_file)
+		{
+			const auto path = filesystem::temp_directory_path() / L"read_mapped_utf8_tree_file.txt";
+			{
+				ofstream file(path, ios::binary);
+				file << "\xEF\xBB\xBF" "abc\r\n"
+				        "  d\xC3\xA9" "f\r\n"
+				        "\r\n"
+				        "    jkl\n"
+				        "  ghi";
+			}
+
+			text_tree_t tree = load_simple_text_tree(path);
+			filesystem::remove(path);
+
+			wostringstream sstream;
+			sstream << tree;
+
+			const wchar_t expected_output[] =
+				L"abc\n"
+				L"  d\u00E9f\n"
+				L"    jkl\n"
+				L"  ghi\n";
+			Assert::AreEqual(expected_output, sstream.str().c_str());
+		}
+
+		TEST_METHOD(read_mapped_utf8_tree_file_as_utf8)
+		{
+			const auto path = filesystem::temp_directory_path() / L"read_mapped_utf8_tree_file_as_utf8.txt";
+			{
+				ofstream file(path, ios::binary);
+				file << "abc\n"
+				        "  d\xC3\xA9" "f\n"
+				        "    jkl\r\n"
+				        "  ghi";
+			}
+
+			utf8_text_tree_t tree = load_utf8_text_tree(path);
+
+			ostringstream sstream;
+			sstream << tree;
+
+			const char expected_output[] =
+				"abc\n"
+				"  d\xC3\xA9" "f\n"
+				"    jkl\n"
+				"  ghi\n";
+			Assert::AreEqual(expected_output, sstream.str().c_str());
+
+			tree.reset();
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(split_mapped_tree_file_in_chunks)
+		{
+			const auto path = filesystem::temp_directory_path() / L"split_mapped_tree_file_in_chunks.txt";
+			{
+				ofstream file(path, ios::binary);
+				file << "abc\n"
+				        "  d\xC3\xA9" "f\n"
+				        "    jkl\r\n"
+				        "  ghi\n"
+				        "    mno\n"
+				        "      pqr";
+			}
+
+			mapped_text_holder_reader_t reader;
+			Assert::IsTrue(reader.open(path));
+
+			wstring lines;
+			size_t chunk_count = 0;
+			for (auto& chunk : reader.split(3))
+			{
+				++chunk_count;
+				while (true)
+				{
+					const auto [line, count] = chunk.read_line();
+					if (count <= 0)
+						break;
+					lines += wstring(line, count) + L"|";
+				}
+			}
+
+			Assert::IsTrue(chunk_count > 1);
+			Assert::AreEqual(L"abc|  d\u00E9f|    jkl|  ghi|    mno|      pqr|", lines.c_str());
+
+			reader = mapped_text_holder_reader_t();
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(load_large_file_in_parallel_chunks_gives_same_tree)
+		{
+			// Larger than three chunks, with lines of varied lengths and depths,
+			// empty lines and CR-LF line ends, so that chunks end in the middle of lines.
+			const auto path = filesystem::temp_directory_path() / L"load_large_file_in_parallel_chunks_gives_same_tree.txt";
+			{
+				ofstream file(path, ios::binary);
+				size_t written = 0;
+				for (size_t i = 0; written < 13 * 1024 * 1024; ++i)
+				{
+					string line = string((i * 7 % 11) % 6 * 2, ' ') + "line " + to_string(i) + string(i % 37, 'x');
+					line += (i % 5 == 0) ? "\r\n" : "\n";
+					if (i % 101 == 0)
+						line += "\n";
+					file << line;
+					written += line.size();
+				}
+				file << "  last";
+			}
+
+			const load_simple_text_tree_options_t options;
+			const text_tree_t parallel = load_simple_text_tree(path, options, 3);
+			const text_tree_t single = load_simple_text_tree(path, options, 1);
+
+			wifstream stream(path);
+			const text_tree_t streamed = load_simple_text_tree(stream, options);
+			stream.close();
+
+			Assert::IsTrue(parallel.size() > 100000);
+			for (const text_tree_t* other : { &single, &streamed })
+			{
+				Assert::AreEqual(other->size(), parallel.size());
+				for (size_t index = 0; index < parallel.size(); ++index)
+				{
+					const auto& node = parallel.node(index);
+					const auto& other_node = other->node(index);
+					Assert::IsTrue(node.text() == other_node.text());
+					Assert::AreEqual(other_node.depth, node.depth);
+					Assert::AreEqual(other_node.index_in_parent, node.index_in_parent);
+					Assert::AreEqual(other_node.text_hash, node.text_hash);
+					Assert::AreEqual(other_node.parent ? other_node.parent->index : size_t(-1), node.parent ? node.parent->index : size_t(-1));
+				}
+			}
+
+			filesystem::remove(path);
+		}
 	};
 }
@@ -0,0 +1,88 @@
+#include "dak/tree_reader/substring_searcher.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/tree_filtering.h"
+#include "tree_reader_test_helpers.h"
+
+#include "CppUnitTest.h"
+
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(substring_searcher_tests)
+	{
+	public:
+
+		template <class CHAR>
+		static void verify_same_as_find()
+		{
+			// Texts made of few different characters, so that partial matches are frequent.
+			// Characters that differ only above the low byte share their Horspool skip.
+			const CHAR letters[] = { CHAR('a'), CHAR('b'), CHAR('c'), CHAR(sizeof(CHAR) > 1 ? 0x161 : 'd') };
+
+			unsigned seed = 1;
+			auto next_letter = [&]() { seed = seed * 1103515245u + 12345u; return letters[(seed >> 16) % 4]; };
+
+			for (size_t text_size = 0; text_size < 200; text_size += 7)
+			{
+				basic_string<CHAR> text;
+				for (size_t i = 0; i < text_size; ++i)
+					text += next_letter();
+
+				for (size_t needle_size = 0; needle_size < 48; ++needle_size)
+				{
+					// Take needles from the text so that some are found, and random ones that mostly are not.
+					basic_string<CHAR> needle;
+					if (needle_size <= text_size && (needle_size % 2))
+						needle = text.substr(text_size - needle_size, needle_size);
+					else
+						for (size_t i = 0; i < needle_size; ++i)
+							needle += next_letter();
+
+					const basic_substring_searcher_t<CHAR> searcher(needle);
+					Assert::AreEqual(basic_string_view<CHAR>(text).find(needle), searcher.find(text));
+				}
+			}
+		}
+
+		TEST_METHOD(wide_searcher_finds_same_as_find)
+		{
+			verify_same_as_find<wchar_t>();
+		}
+
+		TEST_METHOD(utf8_searcher_finds_same_as_find)
+		{
+			verify_same_as_find<char>();
+		}
+
+		TEST_METHOD(searcher_does_not_read_past_text)
+		{
+			const wstring text = L"abcabcabcabcabcabcabcabcabcabcXY";
+			const substring_searcher_t searcher(L"cX");
+
+			// The text view stops before the match.
+			Assert::IsFalse(searcher.is_in(wstring_view(text.data(), text.size() - 2)));
+			Assert::IsTrue(searcher.is_in(text));
+		}
+
+		TEST_METHOD(contains_filter_uses_changed_text)
+		{
+			auto filter = contains(L"g");
+
+			text_tree_t filtered;
+			filter_tree(create_simple_tree(), filtered, filter);
+
+			filter->contained = L"m";
+			filter_tree(create_simple_tree(), filtered, filter);
+
+			wostringstream sstream;
+			sstream << filtered;
+
+			Assert::AreEqual(L"mno\n", sstream.str().c_str());
+		}
+	};
+}
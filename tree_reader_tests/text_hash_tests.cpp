@@ -0,0 +1,84 @@
+#include "dak/tree_reader/text_hash.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/tree_filtering.h"
+#include "tree_reader_test_helpers.h"
+
+#include "CppUnitTest.h"
+
+#include <set>
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(text_hash_tests)
+	{
+	public:
+
+		TEST_METHOD(permuted_texts_have_different_hashes)
+		{
+			Assert::IsFalse(hash_text(L"abc") == hash_text(L"cba"));
+			Assert::IsFalse(hash_text(L"abc") == hash_text(L"bac"));
+			Assert::IsFalse(hash_text(L"") == hash_text(L"a"));
+			Assert::IsTrue(hash_text(L"abc") == hash_text(wstring(L"xabcx").substr(1, 3)));
+
+			// Lines of logs that only differ by a few characters.
+			set<uint64_t> hashes;
+			for (int i = 0; i < 1000; ++i)
+				hashes.insert(hash_text(L"12:00:" + to_wstring(i) + L" request done in " + to_wstring(1000 - i) + L" ms"));
+			Assert::AreEqual<size_t>(1000, hashes.size());
+		}
+
+		TEST_METHOD(nodes_keep_the_hash_of_their_text)
+		{
+			const text_tree_t tree = create_simple_tree();
+			const auto& node = *tree.roots[0]->children[1];
+
+			Assert::IsTrue(node.text_hash == hash_text(node.text()));
+		}
+
+		TEST_METHOD(hash_set_inserts_each_text_once)
+		{
+			vector<wstring> texts;
+			for (int i = 0; i < 500; ++i)
+				texts.emplace_back(to_wstring(i % 200));
+
+			text_hash_set_t set;
+			size_t inserted = 0;
+			for (const auto& text : texts)
+				if (set.insert(text, hash_text(text)))
+					++inserted;
+
+			Assert::AreEqual<size_t>(200, inserted);
+			Assert::AreEqual<size_t>(200, set.size());
+
+			// Equal hashes with different texts are both kept.
+			Assert::IsTrue(set.insert(L"x", 7));
+			Assert::IsTrue(set.insert(L"y", 7));
+			Assert::IsFalse(set.insert(L"x", 7));
+
+			set.clear();
+			Assert::AreEqual<size_t>(0, set.size());
+			Assert::IsTrue(set.insert(texts[0], hash_text(texts[0])));
+		}
+
+		TEST_METHOD(unique_filter_keeps_permuted_texts)
+		{
+			text_tree_t tree;
+			const wchar_t* texts[] = { L"abc", L"cba", L"abc", L"bca", L"cba" };
+			for (const wchar_t* text : texts)
+				tree.add_child(nullptr, text);
+
+			text_tree_t filtered;
+			filter_tree(tree, filtered, *unique());
+
+			wostringstream sstream;
+			sstream << filtered;
+
+			Assert::AreEqual(L"abc\ncba\nbca\n", sstream.str().c_str());
+		}
+	};
+}
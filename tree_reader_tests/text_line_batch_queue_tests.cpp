@@ -0,0 +1,80 @@
+#include "dak/tree_reader/text_line_batch_queue.h"
+
+#include "CppUnitTest.h"
+
+#include <future>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(text_line_batch_queue_tests)
+	{
+	public:
+
+		TEST_METHOD(pass_batches_between_threads_in_order)
+		{
+			text_line_batch_queue_t queue(2);
+
+			auto producing = async(launch::async, [&queue]()
+			{
+				text_line_batch_t batch;
+				for (size_t i = 0; i < 1000; ++i)
+				{
+					batch.add_line(to_wstring(i), i % 7);
+					if (batch.size() == 3)
+						Assert::IsTrue(queue.push(batch));
+					Assert::IsTrue(batch.size() < 3);
+				}
+				if (!batch.empty())
+					queue.push(batch);
+				queue.close();
+			});
+
+			size_t expected = 0;
+			text_line_batch_t batch;
+			while (queue.pop(batch))
+			{
+				for (const auto& line : batch.lines)
+				{
+					Assert::AreEqual(to_wstring(expected), wstring(batch.text(line)));
+					Assert::AreEqual<size_t>(expected % 7, line.depth);
+					++expected;
+				}
+			}
+
+			producing.get();
+			Assert::AreEqual<size_t>(1000, expected);
+		}
+
+		TEST_METHOD(canceled_queue_stops_the_producer)
+		{
+			text_line_batch_queue_t queue(1);
+
+			auto producing = async(launch::async, [&queue]()
+			{
+				text_line_batch_t batch;
+				size_t pushed = 0;
+				while (true)
+				{
+					batch.add_line(L"a", 0);
+					if (!queue.push(batch))
+						break;
+					++pushed;
+				}
+				queue.close();
+				return pushed;
+			});
+
+			text_line_batch_t batch;
+			Assert::IsTrue(queue.pop(batch));
+			Assert::AreEqual(wstring(L"a"), wstring(batch.text(batch.lines[0])));
+			queue.cancel();
+
+			// The producer can only be one batch ahead of the consumer.
+			Assert::IsTrue(producing.get() <= 2);
+		}
+	};
+}
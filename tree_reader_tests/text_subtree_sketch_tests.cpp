@@ -0,0 +1,149 @@
+#include "dak/tree_reader/text_subtree_sketch.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/tree_filtering.h"
+#include "tree_reader_test_helpers.h"
+
+#include "CppUnitTest.h"
+
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(text_subtree_sketch_tests)
+	{
+	public:
+
+		// Create a tree four levels deep where each node has four children.
+		// Some words are only found in a few branches.
+		static void create_bushy_tree(text_tree_t& tree)
+		{
+			static const wchar_t* words[] = { L"alpha", L"beta", L"gamma", L"delta" };
+
+			auto text_lines = make_shared<text_lines_text_holder_t>();
+			vector<size_t> parents;
+			vector<wstring> paths(1, L"");
+			for (size_t depth = 0, first = 0; depth < 4; ++depth)
+			{
+				const size_t count = paths.size();
+				for (size_t index = first; index < count; ++index)
+				{
+					for (size_t child = 0; child < 4; ++child)
+					{
+						const wstring path = paths[index] + to_wstring(child);
+						wstring text = L"node " + path;
+						if (path.front() == L'0' && depth >= 2)
+							text += L" " + wstring(words[child]);
+						if (path == L"3210")
+							text += L" needle";
+						paths.emplace_back(path);
+						parents.emplace_back(index);
+						text_lines->lines.emplace_back(text);
+					}
+				}
+				first = count;
+			}
+			tree.source_text_lines = text_lines;
+
+			// The path of each line gives its parent, the root path being empty.
+			vector<text_tree_t::node_t*> nodes(1, nullptr);
+			for (size_t index = 0; index < text_lines->lines.size(); ++index)
+				nodes.emplace_back(tree.add_child(nodes[parents[index]], text_lines->lines[index].c_str()));
+		}
+
+		static wstring filter_to_text(const text_tree_t& tree, const tree_filter_ptr_t& filter)
+		{
+			text_tree_t filtered;
+			filter_tree(tree, filtered, filter);
+
+			wostringstream sstream;
+			sstream << filtered;
+			return sstream.str();
+		}
+
+		TEST_METHOD(sketches_may_contain_texts_of_sub_tree)
+		{
+			text_tree_t tree;
+			create_bushy_tree(tree);
+			text_subtree_sketches_t sketches(tree);
+			Assert::IsTrue(sketches.is_of(tree));
+			Assert::AreEqual<size_t>(4 + 16 + 64, sketches.size());
+
+			const auto needle = text_subtree_sketches_t::sketch_text(L"needle");
+			const auto alpha = text_subtree_sketches_t::sketch_text(L"alpha");
+			const auto short_text = text_subtree_sketches_t::sketch_text(L"ne");
+
+			// The needle is only under the last root, alpha only under the first.
+			Assert::IsFalse(sketches.may_contain(*tree.roots[0], needle));
+			Assert::IsTrue(sketches.may_contain(*tree.roots[3], needle));
+			Assert::IsTrue(sketches.may_contain(*tree.roots[0], alpha));
+			Assert::IsFalse(sketches.may_contain(*tree.roots[1]->children[2], alpha));
+
+			// Short texts and leaves are never excluded.
+			Assert::IsTrue(sketches.may_contain(*tree.roots[0], short_text));
+			Assert::IsTrue(sketches.may_contain(*tree.roots[0]->children[0]->children[0]->children[0], needle));
+
+			tree.add_child(nullptr, L"more");
+			Assert::IsFalse(sketches.is_of(tree));
+		}
+
+		TEST_METHOD(pruned_filtering_gives_same_tree)
+		{
+			auto tree = make_shared<text_tree_t>();
+			create_bushy_tree(*tree);
+
+			const vector<tree_filter_ptr_t> filters =
+			{
+				contains(L"needle"),
+				contains(L"alpha"),
+				dak::tree_reader::regex(L"gam+a$"),
+				and(contains(L"node 01"), contains(L"delta")),
+				or(contains(L"needle"), dak::tree_reader::regex(L"beta")),
+				or(contains(L"needle"), max_level(1)),
+				not(contains(L"needle")),
+				under(contains(L"needle")),
+				under(contains(L"node 32"), false),
+				if_subtree(contains(L"needle")),
+				if_subtree(and(contains(L"gamma"), min_level(3))),
+			};
+
+			for (const auto& filter : filters)
+			{
+				tree->subtree_sketches = nullptr;
+				const wstring scanned = filter_to_text(*tree, filter);
+
+				tree->subtree_sketches = make_shared<text_subtree_sketches_t>(*tree);
+				const wstring pruned = filter_to_text(*tree, filter);
+
+				Assert::AreEqual(scanned.c_str(), pruned.c_str());
+			}
+		}
+
+		TEST_METHOD(pruner_only_skips_sub_trees_without_match)
+		{
+			text_tree_t tree;
+			create_bushy_tree(tree);
+			tree.subtree_sketches = make_shared<text_subtree_sketches_t>(tree);
+
+			auto needle = contains(L"needle");
+			subtree_pruner_t pruner(*needle, tree);
+			Assert::IsTrue(pruner.is_active());
+			Assert::IsTrue(pruner.can_skip(tree, *tree.roots[0]));
+			Assert::IsFalse(pruner.can_skip(tree, *tree.roots[3]));
+
+			// Filters that may keep any node, or keep state, never skip.
+			Assert::IsFalse(subtree_pruner_t(*not(needle), tree).is_active());
+			Assert::IsFalse(subtree_pruner_t(*or(needle, accept()), tree).is_active());
+			Assert::IsFalse(subtree_pruner_t(*and(needle, unique()), tree).is_active());
+			Assert::IsTrue(subtree_pruner_t(*and(needle, max_level(2)), tree).is_active());
+
+			// Never skips in another tree.
+			text_tree_t other;
+			create_bushy_tree(other);
+			Assert::IsFalse(pruner.can_skip(other, *other.roots[0]));
+		}
+	};
+}
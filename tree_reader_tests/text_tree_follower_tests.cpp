@@ -0,0 +1,252 @@
+#include "dak/tree_reader/text_tree_follower.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/tree_filtering.h"
+#include "dak/tree_reader/tree_filter_maker.h"
+#include "dak/tree_reader/tree_commands.h"
+#include "dak/tree_reader/global_commands.h"
+
+#include "CppUnitTest.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(text_tree_follower_tests)
+	{
+	public:
+
+		static void append_to_file(const filesystem::path& path, const wchar_t* text)
+		{
+			wofstream file(path, ios::app);
+			file << text;
+		}
+
+		static wstring tree_text(const text_tree_t& tree)
+		{
+			wostringstream stream;
+			print_tree(stream, tree);
+			return stream.str();
+		}
+
+		// Load the given text as a tree, as if the whole file had been loaded at once.
+		static wstring loaded_tree_text(const wchar_t* text)
+		{
+			const auto path = filesystem::temp_directory_path() / L"text_tree_follower_expected.txt";
+			wofstream(path) << text;
+			const auto tree = load_simple_text_tree(path);
+			filesystem::remove(path);
+			return tree_text(tree);
+		}
+
+		TEST_METHOD(follower_appends_lines_like_a_load)
+		{
+			const auto path = filesystem::temp_directory_path() / L"follower_appends_lines_like_a_load.txt";
+			wofstream(path) << L"a\n  b\n    c\n";
+
+			auto tree = make_shared<text_tree_t>(load_simple_text_tree(path));
+			text_tree_follower_t follower(path, tree, load_simple_text_tree_options_t());
+			Assert::AreEqual<size_t>(0, follower.append_new_lines());
+
+			// The last line is incomplete, so it is not read yet.
+			append_to_file(path, L"      d\n    e\n  f\ng\n  h");
+			Assert::AreEqual<size_t>(4, follower.append_new_lines());
+			Assert::AreEqual(loaded_tree_text(L"a\n  b\n    c\n      d\n    e\n  f\ng\n").c_str(), tree_text(*tree).c_str());
+
+			append_to_file(path, L"h\n    i\n");
+			Assert::AreEqual<size_t>(2, follower.append_new_lines());
+			Assert::AreEqual(loaded_tree_text(L"a\n  b\n    c\n      d\n    e\n  f\ng\n  hh\n    i\n").c_str(), tree_text(*tree).c_str());
+			Assert::IsFalse(follower.was_truncated());
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(follower_adds_lines_appended_before_following)
+		{
+			const auto path = filesystem::temp_directory_path() / L"follower_adds_lines_appended_before_following.txt";
+			wofstream(path) << L"a\n  b\n";
+
+			auto tree = make_shared<text_tree_t>(load_simple_text_tree(path));
+			append_to_file(path, L"    c\nd\n");
+
+			text_tree_follower_t follower(path, tree, load_simple_text_tree_options_t());
+			Assert::AreEqual(loaded_tree_text(L"a\n  b\n    c\nd\n").c_str(), tree_text(*tree).c_str());
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(follower_completes_incomplete_last_line_of_loaded_tree)
+		{
+			const auto path = filesystem::temp_directory_path() / L"follower_completes_incomplete_last_line_of_loaded_tree.txt";
+			wofstream(path) << L"a\n  b\n  c";
+
+			auto tree = make_shared<text_tree_t>(load_simple_text_tree(path));
+			Assert::AreEqual<size_t>(3, tree->size());
+
+			text_tree_follower_t follower(path, tree, load_simple_text_tree_options_t());
+			Assert::AreEqual<size_t>(3, tree->size());
+			Assert::AreEqual<size_t>(0, follower.append_new_lines());
+			Assert::IsFalse(follower.was_last_node_replaced());
+
+			append_to_file(path, L"d\n  e\n");
+			Assert::AreEqual<size_t>(2, follower.append_new_lines());
+			Assert::IsTrue(follower.was_last_node_replaced());
+			Assert::IsFalse(follower.was_last_node_replaced());
+			Assert::AreEqual(loaded_tree_text(L"a\n  b\n  cd\n  e\n").c_str(), tree_text(*tree).c_str());
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(follower_completes_last_line_completed_before_following)
+		{
+			const auto path = filesystem::temp_directory_path() / L"follower_completes_last_line_completed_before_following.txt";
+			wofstream(path) << L"a\n  b";
+
+			auto tree = make_shared<text_tree_t>(load_simple_text_tree(path));
+			append_to_file(path, L"c\nd\n");
+
+			text_tree_follower_t follower(path, tree, load_simple_text_tree_options_t());
+			Assert::AreEqual(loaded_tree_text(L"a\n  bc\nd\n").c_str(), tree_text(*tree).c_str());
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(follower_keeps_last_line_of_file_without_line_end)
+		{
+			const auto path = filesystem::temp_directory_path() / L"follower_keeps_last_line_of_file_without_line_end.txt";
+			wofstream(path) << L"a\n  b";
+
+			auto tree = make_shared<text_tree_t>(load_simple_text_tree(path));
+			text_tree_follower_t follower(path, tree, load_simple_text_tree_options_t());
+			Assert::AreEqual<size_t>(0, follower.append_new_lines());
+			Assert::AreEqual(loaded_tree_text(L"a\n  b\n").c_str(), tree_text(*tree).c_str());
+
+			filesystem::remove(path);
+		}
+
+				TEST_METHOD(follower_detects_truncated_file)
+		{
+			const auto path = filesystem::temp_directory_path() / L"follower_detects_truncated_file.txt";
+			wofstream(path) << L"a\n  b\n";
+
+			auto tree = make_shared<text_tree_t>(load_simple_text_tree(path));
+			text_tree_follower_t follower(path, tree, load_simple_text_tree_options_t());
+
+			wofstream(path) << L"a\n";
+			Assert::AreEqual<size_t>(0, follower.append_new_lines());
+			Assert::IsTrue(follower.was_truncated());
+			Assert::AreEqual<size_t>(2, tree->size());
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(appended_nodes_filtering_gives_same_tree)
+		{
+			const auto path = filesystem::temp_directory_path() / L"appended_nodes_filtering_gives_same_tree.txt";
+			wofstream(path) << L"a\n  b\n    c\n";
+
+			auto tree = make_shared<text_tree_t>(load_simple_text_tree(path));
+			text_tree_follower_t follower(path, tree, load_simple_text_tree_options_t());
+
+			const vector<tree_filter_ptr_t> filters = { accept(), contains(L"c"), not(contains(L"b")), level_range(1, 2), under(contains(L"a"), false),
+			                                            stop_when_kept(contains(L"e")) };
+			vector<appended_nodes_filtering_t> filterings;
+			for (const auto& filter : filters)
+				filterings.emplace_back(filter);
+
+			for (const wchar_t* appended : { L"", L"      cc\n  d\n", L"e\n  bc\nf\n  c\n" })
+			{
+				append_to_file(path, appended);
+				follower.append_new_lines();
+
+				for (size_t i = 0; i < filters.size(); ++i)
+				{
+					filterings[i].filter_appended_nodes(*tree);
+
+					text_tree_t expected;
+					filter_tree(*tree, expected, filters[i]);
+					Assert::AreEqual(tree_text(expected).c_str(), tree_text(*filterings[i].filtered_tree).c_str());
+				}
+			}
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(followed_tree_commands_filter_appended_lines)
+		{
+			const auto path = filesystem::temp_directory_path() / L"followed_tree_commands_filter_appended_lines.txt";
+			wofstream(path) << L"a\n  b\n    c\n";
+
+			global_commands_t ctx;
+			auto tree = ctx.load_tree(path);
+			Assert::IsTrue(tree != nullptr);
+
+			tree->set_filter(contains(L"c"));
+			tree->apply_filter_to_tree();
+			tree->search_in_tree(L"cc");
+			Assert::IsTrue(ctx.follow_tree(tree));
+			Assert::IsTrue(tree->is_following_tree_file());
+
+			append_to_file(path, L"      cc\n  d\nc\n");
+			Assert::AreEqual<size_t>(3, ctx.update_followed_trees());
+
+			text_tree_t filtered;
+			filter_tree(*tree->get_original_tree(), filtered, contains(L"c"));
+			text_tree_t searched;
+			filter_tree(filtered, searched, convert_simple_text_to_filter(L"cc", named_filters_t()));
+			Assert::AreEqual(tree_text(searched).c_str(), tree_text(*tree->get_filtered_tree()).c_str());
+			Assert::IsTrue(tree_text(*tree->get_filtered_tree()).find(L"cc") != wstring::npos);
+
+			tree->search_in_tree(L"");
+			Assert::AreEqual(tree_text(filtered).c_str(), tree_text(*tree->get_filtered_tree()).c_str());
+
+			tree->stop_following_tree_file();
+			Assert::IsFalse(tree->is_following_tree_file());
+			Assert::AreEqual<size_t>(0, ctx.update_followed_trees());
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(followed_tree_commands_read_like_loaded_and_do_not_grow_other_trees)
+		{
+			const auto path = filesystem::temp_directory_path() / L"followed_tree_commands_read_like_loaded.txt";
+			wofstream(path) << L"a\n..b\n..c";
+
+			global_commands_t ctx;
+			ctx.options.read_options.input_indent = L".";
+			auto tree = ctx.load_tree(path);
+			Assert::IsTrue(tree != nullptr);
+			const auto loaded_options = ctx.options.read_options;
+			ctx.options.read_options = load_simple_text_tree_options_t();
+
+			tree->set_filter(contains(L"c"));
+			tree->apply_filter_to_tree();
+			Assert::IsTrue(ctx.follow_tree(tree));
+
+			// The tree created from the filtered tree does not grow with it.
+			auto other = ctx.create_tree_from_filtered(tree);
+			const wstring other_text = tree_text(*other->get_original_tree());
+
+			append_to_file(path, L"d\n....c\n");
+			Assert::AreEqual<size_t>(2, ctx.update_followed_trees());
+
+			const auto expected_path = filesystem::temp_directory_path() / L"followed_tree_commands_read_like_loaded_expected.txt";
+			wofstream(expected_path) << L"a\n..b\n..cd\n....c\n";
+			const text_tree_t expected = load_simple_text_tree(expected_path, loaded_options);
+			filesystem::remove(expected_path);
+			Assert::AreEqual(tree_text(expected).c_str(), tree_text(*tree->get_original_tree()).c_str());
+
+			text_tree_t filtered;
+			filter_tree(expected, filtered, contains(L"c"));
+			Assert::AreEqual(tree_text(filtered).c_str(), tree_text(*tree->get_filtered_tree()).c_str());
+			Assert::AreEqual(other_text.c_str(), tree_text(*other->get_original_tree()).c_str());
+
+			tree->stop_following_tree_file();
+			filesystem::remove(path);
+		}
+	};
+}
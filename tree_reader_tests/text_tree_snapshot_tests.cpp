@@ -0,0 +1,157 @@
+#include "dak/tree_reader/text_tree_snapshot.h"
+#include "dak/tree_reader/simple_tree_reader.h"
+#include "dak/tree_reader/global_commands.h"
+#include "dak/tree_reader/tree_commands.h"
+#include "tree_reader_test_helpers.h"
+
+#include "CppUnitTest.h"
+
+#include <fstream>
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(text_tree_snapshot_tests)
+	{
+	public:
+
+		static wstring tree_to_text(const text_tree_t& tree)
+		{
+			wostringstream sstream;
+			sstream << tree;
+			return sstream.str();
+		}
+
+		TEST_METHOD(reload_tree_from_snapshot)
+		{
+			const auto path = filesystem::temp_directory_path() / L"reload_tree_from_snapshot.txt";
+			{
+				wofstream file(path);
+				file << create_simple_tree();
+			}
+
+			const auto snapshot_path = get_text_tree_snapshot_path(path);
+			const load_simple_text_tree_options_t options;
+			const text_tree_t tree = load_simple_text_tree(path, options);
+
+			for (const bool with_hashes : { true, false })
+			{
+				Assert::IsTrue(save_text_tree_snapshot(snapshot_path, tree, path, options, with_hashes));
+
+				text_tree_t reloaded;
+				Assert::IsTrue(load_text_tree_snapshot(snapshot_path, path, options, reloaded));
+				Assert::AreEqual(tree_to_text(tree).c_str(), tree_to_text(reloaded).c_str());
+				Assert::AreEqual(tree.size(), reloaded.size());
+
+				for (size_t index = 0; index < tree.size(); ++index)
+				{
+					Assert::AreEqual(tree.node(index).depth, reloaded.node(index).depth);
+					Assert::AreEqual(tree.node(index).text_hash, reloaded.node(index).text_hash);
+				}
+			}
+
+			filesystem::remove(snapshot_path);
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(stale_snapshot_is_not_loaded)
+		{
+			const auto path = filesystem::temp_directory_path() / L"stale_snapshot_is_not_loaded.txt";
+			{
+				wofstream file(path);
+				file << L"a\n  b\n";
+			}
+
+			const auto snapshot_path = get_text_tree_snapshot_path(path);
+			const load_simple_text_tree_options_t options;
+			Assert::IsTrue(save_text_tree_snapshot(snapshot_path, load_simple_text_tree(path, options), path, options));
+
+			// Other reading options would give another tree.
+			load_simple_text_tree_options_t other_options;
+			other_options.input_indent = L" ";
+			text_tree_t reloaded;
+			Assert::IsFalse(load_text_tree_snapshot(snapshot_path, path, other_options, reloaded));
+			Assert::AreEqual<size_t>(0, reloaded.size());
+
+			// The source file changed.
+			{
+				wofstream file(path, ios::app);
+				file << L"c\n";
+			}
+			Assert::IsFalse(load_text_tree_snapshot(snapshot_path, path, options, reloaded));
+			Assert::AreEqual<size_t>(0, reloaded.size());
+
+			// No snapshot.
+			filesystem::remove(snapshot_path);
+			Assert::IsFalse(load_text_tree_snapshot(snapshot_path, path, options, reloaded));
+
+			filesystem::remove(path);
+		}
+
+		TEST_METHOD(snapshot_with_corrupted_text_offset_is_not_loaded)
+		{
+			const auto path = filesystem::temp_directory_path() / L"snapshot_with_corrupted_text_offset_is_not_loaded.txt";
+			{
+				wofstream file(path);
+				file << L"a\n  b\n";
+			}
+
+			const auto snapshot_path = get_text_tree_snapshot_path(path);
+			const load_simple_text_tree_options_t options;
+			Assert::IsTrue(save_text_tree_snapshot(snapshot_path, load_simple_text_tree(path, options), path, options, false));
+
+			// Replace the first text offset by one that wraps around when the text length is added.
+			// The offsets follow the header and the parents, each on an 8-byte boundary.
+			{
+				fstream file(snapshot_path, ios::in | ios::out | ios::binary);
+				file.seekp(64 + 8);
+				const uint64_t offset = UINT64_MAX;
+				file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+			}
+
+			text_tree_t reloaded;
+			Assert::IsFalse(load_text_tree_snapshot(snapshot_path, path, options, reloaded));
+			Assert::AreEqual<size_t>(0, reloaded.size());
+
+			filesystem::remove(snapshot_path);
+			filesystem::remove(path);
+		}
+
+				TEST_METHOD(snapshot_records_options_tree_was_loaded_with)
+		{
+			const auto path = filesystem::temp_directory_path() / L"snapshot_records_options_tree_was_loaded_with.txt";
+			{
+				wofstream file(path);
+				file << L"a\n  b\n  c\n";
+			}
+			const auto snapshot_path = get_text_tree_snapshot_path(path);
+			filesystem::remove(snapshot_path);
+
+			global_commands_t ctx;
+			const load_simple_text_tree_options_t loaded_options = ctx.options.read_options;
+			auto tree = ctx.load_tree(path);
+			Assert::IsTrue(tree != nullptr);
+
+			// Changing the options after loading does not change the options of the loaded tree.
+			ctx.set_input_filter(L"b");
+			Assert::IsTrue(ctx.save_tree_snapshot(tree));
+
+			text_tree_t reloaded;
+			Assert::IsFalse(load_text_tree_snapshot(snapshot_path, path, ctx.options.read_options, reloaded));
+			Assert::IsTrue(load_text_tree_snapshot(snapshot_path, path, loaded_options, reloaded));
+			Assert::AreEqual(tree_to_text(*tree->get_original_tree()).c_str(), tree_to_text(reloaded).c_str());
+
+			// Trees not read from a file have no snapshot.
+			tree->set_filter(accept());
+			tree->apply_filter_to_tree();
+			Assert::IsFalse(ctx.save_tree_snapshot(ctx.create_tree_from_filtered(tree)));
+
+			filesystem::remove(snapshot_path);
+			filesystem::remove(path);
+		}
+	};
+}
@@ -3,6 +3,7 @@
 
 #include "CppUnitTest.h"
 
+#include <memory>
 #include <sstream>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -24,7 +25,35 @@ namespace dak::tree_reader_tests
 			Assert::AreEqual(expected_output, sstream.str().c_str());
 		}
 
-		TEST_METHOD(count_simple_tree)
+		TEST_METHOD(copied_tree_has_its_own_nodes)
+		{
+			auto tree = make_unique<text_tree_t>(create_simple_tree());
+			const text_tree_t copy = *tree;
+
+			wostringstream expected;
+			expected << *tree;
+
+			Assert::AreEqual(tree->size(), copy.size());
+			for (size_t index = 0; index < copy.size(); ++index)
+			{
+				const auto& a_node = copy.node(index);
+				Assert::AreEqual(index, a_node.index);
+				Assert::AreEqual(tree->node(index).depth, a_node.depth);
+				Assert::AreEqual(tree->node(index).text_hash, a_node.text_hash);
+				if (a_node.parent)
+					Assert::IsTrue(a_node.parent == &copy.node(a_node.parent->index));
+				for (const auto child : a_node.children)
+					Assert::IsTrue(child == &copy.node(child->index));
+			}
+
+			// The copy stays valid once the original is gone.
+			tree.reset();
+			wostringstream copied;
+			copied << copy;
+			Assert::AreEqual(expected.str().c_str(), copied.str().c_str());
+		}
+
+				TEST_METHOD(count_simple_tree)
 		{
 			const text_tree_t tree = create_simple_tree();
 
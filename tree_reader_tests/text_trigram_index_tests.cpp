@@ -0,0 +1,120 @@
+#include "dak/tree_reader/text_trigram_index.h"
+#include "dak/tree_reader/leaf_match_cache.h"
+#include "dak/tree_reader/tree_filter.h"
+#include "dak/tree_reader/tree_filtering.h"
+#include "tree_reader_test_helpers.h"
+
+#include "CppUnitTest.h"
+
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace std;
+using namespace dak::tree_reader;
+
+namespace dak::tree_reader_tests
+{
+	TEST_CLASS(text_trigram_index_tests)
+	{
+	public:
+
+		static void create_numbered_tree(text_tree_t& tree)
+		{
+			auto text_lines = make_shared<text_lines_text_holder_t>();
+			for (size_t index = 0; index < 3000; ++index)
+				text_lines->lines.emplace_back(L"item " + to_wstring(index * 7919 % 3000) + L" of " + to_wstring(index % 7));
+			tree.source_text_lines = text_lines;
+
+			vector<text_tree_t::node_t*> branch;
+			for (size_t index = 0; index < text_lines->lines.size(); ++index)
+			{
+				const size_t depth = min<size_t>(branch.size(), index % 4);
+				branch.resize(depth);
+				branch.emplace_back(tree.add_child(depth ? branch.back() : nullptr, text_lines->lines[index].c_str()));
+			}
+		}
+
+		TEST_METHOD(candidates_include_all_matching_nodes)
+		{
+			text_tree_t tree;
+			create_numbered_tree(tree);
+			text_trigram_index_t index(tree);
+			Assert::IsTrue(index.is_of(tree));
+
+			for (const wchar_t* text : { L"item 12", L"12 of 3", L"999", L" of 6", L"missing", L"tem" })
+			{
+				vector<size_t> candidates;
+				Assert::IsTrue(index.find_candidates(text, candidates));
+
+				vector<size_t> expected;
+				for (size_t node = 0; node < tree.size(); ++node)
+					if (tree.node(node).text().find(text) != wstring_view::npos)
+						expected.emplace_back(node);
+
+				// Candidates are sorted and include all the nodes containing the text.
+				Assert::IsTrue(is_sorted(candidates.begin(), candidates.end()));
+				Assert::IsTrue(includes(candidates.begin(), candidates.end(), expected.begin(), expected.end()));
+				Assert::IsTrue(candidates.size() <= tree.size() / 2 || expected.size() > tree.size() / 2);
+			}
+
+			vector<size_t> candidates;
+			Assert::IsFalse(index.find_candidates(L"12", candidates));
+		}
+
+		TEST_METHOD(index_is_only_valid_for_its_tree)
+		{
+			text_tree_t tree = create_simple_tree();
+			text_trigram_index_t index(tree);
+			Assert::IsTrue(index.is_of(tree));
+
+			tree.add_child(nullptr, L"more");
+			Assert::IsFalse(index.is_of(tree));
+
+			text_tree_t other = create_simple_tree();
+			Assert::IsFalse(index.is_of(other));
+			Assert::IsFalse(text_trigram_index_t().is_of(other));
+		}
+
+		TEST_METHOD(regex_gives_required_text)
+		{
+			Assert::AreEqual(L"abc", linear_regex_t(L"x?abc[0-9]+").required_text().c_str());
+			Assert::AreEqual(L"item 1", linear_regex_t(L"^item 1\\d* of").required_text().c_str());
+			Assert::AreEqual(L"", linear_regex_t(L"abc|def").required_text().c_str());
+			Assert::AreEqual(L"", linear_regex_t().required_text().c_str());
+		}
+
+		TEST_METHOD(indexed_filtering_gives_same_tree)
+		{
+			auto tree = make_shared<text_tree_t>();
+			create_numbered_tree(*tree);
+
+			auto cache = make_shared<leaf_match_cache_t>();
+			auto index = build_trigram_index_async(tree);
+			cache->set_index(index.first.get());
+
+			const vector<tree_filter_ptr_t> filters =
+			{
+				contains(L"item 12"),
+				contains(L"of"),
+				or(contains(L"99"), dak::tree_reader::regex(L"^item 1[0-9] of")),
+				and(dak::tree_reader::regex(L"of [35]$"), not(contains(L"item 2"))),
+				dak::tree_reader::regex(L"7|8"),
+			};
+
+			for (const auto& filter : filters)
+			{
+				text_tree_t scanned;
+				filter_tree(*tree, scanned, filter);
+
+				text_tree_t indexed;
+				filter_tree(*tree, indexed, filter, cache);
+
+				wostringstream scanned_stream;
+				scanned_stream << scanned;
+				wostringstream indexed_stream;
+				indexed_stream << indexed;
+				Assert::AreEqual(scanned_stream.str().c_str(), indexed_stream.str().c_str());
+			}
+		}
+	};
+}
@@ -1,8 +1,14 @@
 #include "dak/tree_reader/global_commands.h"
+#include "dak/tree_reader/tree_commands.h"
+#include "dak/tree_reader/tree_filter_command_line.h"
+#include "dak/tree_reader/tree_filter_maker.h"
+#include "tree_reader_test_helpers.h"
 
 #include "CppUnitTest.h"
 
+#include <fstream>
 #include <sstream>
+#include <thread>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 using namespace dak::tree_reader;
@@ -22,6 +28,7 @@ namespace dak::tree_reader_tests
          ctx.options.read_options.input_filter = L"def";
          ctx.options.read_options.input_indent = L"ghi";
          ctx.options.read_options.tab_size = 5;
+         ctx.options.max_loaded_file_megabytes = 7;
 
          wostringstream ostream;
          ctx.save_options(ostream);
@@ -34,6 +41,190 @@ namespace dak::tree_reader_tests
          Assert::AreEqual(L"def", ctx2.options.read_options.input_filter.c_str());
          Assert::AreEqual(L"ghi", ctx2.options.read_options.input_indent.c_str());
          Assert::AreEqual<size_t>(5, ctx2.options.read_options.tab_size);
+         Assert::AreEqual<size_t>(7, ctx2.options.max_loaded_file_megabytes);
+      }
+
+      static wstring searched_text(tree_commands_t& commands)
+      {
+         while (!commands.is_async_search_ready())
+            ;
+
+         wostringstream sstream;
+         sstream << *commands.get_filtered_tree();
+         return sstream.str();
+      }
+
+      TEST_METHOD(Extended_search_gives_same_tree)
+      {
+         auto tree = make_shared<text_tree_t>();
+         auto text_lines = make_shared<text_lines_text_holder_t>();
+         text_lines->lines = { L"ab", L"abc", L"x", L"abcd", L"ab", L"abcde", L"y", L"abd", L"abcd" };
+         tree->source_text_lines = text_lines;
+
+         auto r0 = tree->add_child(nullptr, text_lines->lines[0].c_str());
+         auto r0c0 = tree->add_child(r0, text_lines->lines[1].c_str());
+         auto r0c0c0 = tree->add_child(r0c0, text_lines->lines[2].c_str());
+         tree->add_child(r0c0c0, text_lines->lines[3].c_str());
+         auto r1 = tree->add_child(nullptr, text_lines->lines[4].c_str());
+         auto r1c0 = tree->add_child(r1, text_lines->lines[5].c_str());
+         tree->add_child(r1c0, text_lines->lines[6].c_str());
+         auto r1c1 = tree->add_child(r1, text_lines->lines[7].c_str());
+         tree->add_child(r1c1, text_lines->lines[8].c_str());
+
+         auto known_filters = make_shared<named_filters_t>();
+         tree_commands_t typed(tree, L"typed", known_filters, make_shared<undo_stack>());
+         typed.apply_filter_to_tree();
+
+         // Each search extends the previous one, the last one does not.
+         const wchar_t* searches[] = { L"a", L"ab", L"abc", L"abc d", L"abcd e", L"bd", L"abcde" };
+         for (const bool async : { false, true })
+         {
+            for (const wchar_t* search : searches)
+            {
+               if (async)
+                  typed.search_in_tree_async(search);
+               else
+                  typed.search_in_tree(search);
+
+               tree_commands_t direct(tree, L"direct", known_filters, make_shared<undo_stack>());
+               direct.apply_filter_to_tree();
+               direct.search_in_tree(search);
+
+               Assert::AreEqual(searched_text(direct).c_str(), searched_text(typed).c_str());
+            }
+
+            typed.search_in_tree(L"");
+         }
+      }
+
+      TEST_METHOD(Search_in_indexed_filtered_tree_gives_same_tree)
+      {
+         // Large enough for the tree and the filtered tree to be indexed.
+         auto tree = make_shared<text_tree_t>();
+         auto text_lines = make_shared<text_lines_text_holder_t>();
+         for (size_t index = 0; index < text_trigram_index_t::min_indexed_nodes + 20000; ++index)
+            text_lines->lines.emplace_back(L"line " + to_wstring(index * 7919 % 1000003));
+         tree->source_text_lines = text_lines;
+         text_tree_t::node_t* parent = nullptr;
+         for (size_t index = 0; index < text_lines->lines.size(); ++index)
+         {
+            auto a_node = tree->add_child(index % 100 == 0 ? nullptr : parent, text_lines->lines[index].c_str());
+            if (index % 100 == 0)
+               parent = a_node;
+         }
+
+         auto known_filters = make_shared<named_filters_t>();
+         tree_commands_t commands(tree, L"indexed", known_filters, make_shared<undo_stack>());
+
+         // The same searches are done in the tree and in filtered trees, while the indexes are built.
+         const tree_filter_ptr_t filters[] = { nullptr, not(contains(L"77")), nullptr, not(contains(L"88")) };
+         for (const auto& filter : filters)
+         {
+            commands.set_filter(filter);
+            commands.apply_filter_to_tree();
+
+            text_tree_t filtered;
+            filter_tree(*tree, filtered, filter);
+
+            for (const wchar_t* search : { L"12345", L"999", L"55" })
+            {
+               commands.search_in_tree(L"");
+               commands.search_in_tree(search);
+
+               text_tree_t searched;
+               filter_tree(filtered, searched, contains(search));
+
+               wostringstream expected;
+               expected << searched;
+               Assert::AreEqual(expected.str().c_str(), searched_text(commands).c_str());
+            }
+         }
+      }
+
+      TEST_METHOD(Search_in_large_filtered_tree_uses_its_sketches)
+      {
+         auto tree = make_shared<text_tree_t>();
+         auto text_lines = make_shared<text_lines_text_holder_t>();
+         for (size_t index = 0; index < text_subtree_sketches_t::min_sketched_nodes + 20000; ++index)
+            text_lines->lines.emplace_back(L"line " + to_wstring(index));
+         tree->source_text_lines = text_lines;
+         text_tree_t::node_t* parent = nullptr;
+         for (size_t index = 0; index < text_lines->lines.size(); ++index)
+         {
+            auto a_node = tree->add_child(index % 100 == 0 ? nullptr : parent, text_lines->lines[index].c_str());
+            if (index % 100 == 0)
+               parent = a_node;
+         }
+
+         auto known_filters = make_shared<named_filters_t>();
+         tree_commands_t commands(tree, L"sketched", known_filters, make_shared<undo_stack>());
+         commands.set_filter(not(contains(L"line 5")));
+         commands.apply_filter_to_tree();
+         const auto filtered = commands.get_filtered_tree();
+         Assert::IsTrue(filtered != tree);
+
+         text_tree_t searched;
+         filter_tree(*filtered, searched, contains(L"12345"));
+         wostringstream expected;
+         expected << searched;
+
+         // The sketches of the filtered tree are given to it by the searches once built.
+         for (size_t attempt = 0; attempt < 600 && !filtered->subtree_sketches; ++attempt)
+         {
+            commands.search_in_tree(L"");
+            commands.search_in_tree(L"12345");
+            Assert::AreEqual(expected.str().c_str(), searched_text(commands).c_str());
+            this_thread::sleep_for(100ms);
+         }
+
+         Assert::IsTrue(filtered->subtree_sketches != nullptr);
+         Assert::IsTrue(filtered->subtree_sketches->is_of(*filtered));
+
+         commands.search_in_tree(L"");
+         commands.search_in_tree(L"12345");
+         Assert::AreEqual(expected.str().c_str(), searched_text(commands).c_str());
+      }
+
+      TEST_METHOD(Batch_load_is_streamed_when_only_printed)
+      {
+         const auto path = filesystem::temp_directory_path() / L"batch_load_is_streamed_when_only_printed.txt";
+         {
+            wofstream file(path);
+            for (size_t i = 0; i < 5000; ++i)
+               file << wstring((i % 4) * 2, L' ') << L"line " << i << L"\n";
+         }
+
+         wostringstream expected;
+         {
+            const text_tree_t tree = load_simple_text_tree(path);
+            text_tree_t filtered;
+            filter_tree(tree, filtered, *convert_simple_text_to_filter(L"7", named_filters_t()));
+            print_tree(expected, filtered, L"--");
+         }
+
+         command_line_t ctx;
+         ctx.options.output_line_indent = L"--";
+         ctx.parse_commands(vector<wstring>{ L"load", path.wstring(), L"filter", L"7" });
+         Assert::IsTrue(ctx.current_tree == nullptr);
+         Assert::AreEqual(path.wstring().c_str(), ctx.streamed_filename.wstring().c_str());
+
+         wostringstream streamed;
+         Assert::AreEqual(L"", ctx.filter_streamed_file(streamed).c_str());
+         Assert::AreEqual(expected.str().c_str(), streamed.str().c_str());
+
+         // Filters that need the whole tree load it.
+         command_line_t unique_ctx;
+         unique_ctx.parse_commands(vector<wstring>{ L"load", path.wstring(), L"unique" });
+         Assert::IsTrue(unique_ctx.current_tree != nullptr);
+         Assert::IsTrue(unique_ctx.streamed_filename.empty());
+
+         // Commands that use the tree load it.
+         command_line_t then_ctx;
+         then_ctx.parse_commands(vector<wstring>{ L"load", path.wstring(), L"filter", L"7", L"then", L"filter", L"8" });
+         Assert::IsTrue(then_ctx.current_tree != nullptr);
+         Assert::IsTrue(then_ctx.streamed_filename.empty());
+
+         filesystem::remove(path);
       }
 	};
 }
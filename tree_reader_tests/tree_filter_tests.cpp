@@ -1,5 +1,8 @@
 #include "dak/tree_reader/tree_filter.h"
 #include "dak/tree_reader/tree_filtering.h"
+#include "dak/tree_reader/utf8_tree_filter.h"
+#include "dak/tree_reader/tree_filter_helpers.h"
+#include "dak/tree_reader/text_lines_text_holder.h"
 #include "tree_reader_test_helpers.h"
 
 #include "CppUnitTest.h"
@@ -107,6 +110,42 @@ namespace dak::tree_reader_tests
          Assert::AreEqual(expected_output, sstream.str().c_str());
       }
 
+      TEST_METHOD(IfSubTreeFilterMatchesDeepDescendants)
+      {
+         // Text-only sub-filters are matched in a single bottom-up pass,
+         // other sub-filters are visited under each node.
+         // Both must give the same result.
+         const vector<tree_filter_ptr_t> sub_filters = { contains(L"x"), contains(L"p"), contains(L"m"), contains(L"e"), or(contains(L"j"), contains(L"s")) };
+         for (const tree_filter_ptr_t& sub_filter : sub_filters)
+         {
+            text_tree_t memoized;
+            filter_tree(create_simple_tree(), memoized, if_subtree(sub_filter));
+
+            text_tree_t visited;
+            filter_tree(create_simple_tree(), visited, if_subtree(and(sub_filter, min_level(0))));
+
+            wostringstream memoized_stream;
+            memoized_stream << memoized;
+            wostringstream visited_stream;
+            visited_stream << visited;
+
+            Assert::AreEqual(visited_stream.str().c_str(), memoized_stream.str().c_str());
+         }
+
+         text_tree_t filtered;
+         filter_tree(create_simple_tree(), filtered, if_subtree(contains(L"x")));
+
+         wostringstream sstream;
+         sstream << filtered;
+
+         const wchar_t expected_output[] =
+            L"abc\n"
+            L"  ghi\n"
+            L"    mno\n"
+            L"      stu\n";
+         Assert::AreEqual(expected_output, sstream.str().c_str());
+      }
+
       TEST_METHOD(PrintSimpleTreeWithIfSiblingFilter)
       {
          text_tree_t filtered;
@@ -121,6 +160,87 @@ namespace dak::tree_reader_tests
          Assert::AreEqual(expected_output, sstream.str().c_str());
       }
 
+      TEST_METHOD(IfSiblingFilterMatchesWholeSiblingGroups)
+      {
+         text_tree_t tree;
+         auto text_lines = make_shared<text_lines_text_holder_t>();
+         text_lines->lines = { L"root", L"a1", L"b2", L"a3", L"c4", L"b5", L"c6", L"other", L"b7" };
+         tree.source_text_lines = text_lines;
+         auto root = tree.add_child(nullptr, text_lines->lines[0].c_str());
+         for (size_t index = 1; index < 7; ++index)
+            tree.add_child(root, text_lines->lines[index].c_str());
+         auto other = tree.add_child(nullptr, text_lines->lines[7].c_str());
+         tree.add_child(other, text_lines->lines[8].c_str());
+
+         // Text-only sub-filters are matched once per sibling group,
+         // other sub-filters are applied to each later sibling.
+         // Both must give the same result.
+         const vector<tree_filter_ptr_t> sub_filters = { contains(L"a"), contains(L"b"), contains(L"c"), contains(L"z"), or(contains(L"3"), contains(L"7")) };
+         for (const tree_filter_ptr_t& sub_filter : sub_filters)
+         {
+            text_tree_t memoized;
+            filter_tree(tree, memoized, if_sibling(sub_filter));
+
+            text_tree_t visited;
+            filter_tree(tree, visited, if_sibling(and(sub_filter, min_level(0))));
+
+            wostringstream memoized_stream;
+            memoized_stream << memoized;
+            wostringstream visited_stream;
+            visited_stream << visited;
+
+            Assert::AreEqual(visited_stream.str().c_str(), memoized_stream.str().c_str());
+         }
+
+         text_tree_t filtered;
+         filter_tree(tree, filtered, if_sibling(contains(L"a")));
+
+         wostringstream sstream;
+         sstream << filtered;
+
+         const wchar_t expected_output[] =
+            L"a1\n"
+            L"b2\n"
+            L"a3\n";
+         Assert::AreEqual(expected_output, sstream.str().c_str());
+      }
+
+      TEST_METHOD(IfSiblingFilterMatchesNestedSiblingGroupsOnce)
+      {
+         // Counts how many nodes the sub-filter is given.
+         struct counting_contains_t : contains_tree_filter_t
+         {
+            counting_contains_t(const wstring& text, size_t& count) : contains_tree_filter_t(text), count(count) {}
+
+            result_t is_kept(const text_tree_t& tree, const text_tree_t::node_t& node, size_t level) override
+            {
+               ++count;
+               return contains_tree_filter_t::is_kept(tree, node, level);
+            }
+
+            size_t& count;
+         };
+
+         text_tree_t tree;
+         auto text_lines = make_shared<text_lines_text_holder_t>();
+         text_lines->lines = { L"root", L"child", L"grand-child", L"last" };
+         tree.source_text_lines = text_lines;
+         auto root = tree.add_child(nullptr, text_lines->lines[0].c_str());
+         for (size_t index = 0; index < 50; ++index)
+         {
+            auto child = tree.add_child(root, text_lines->lines[index == 49 ? 3 : 1].c_str());
+            tree.add_child(child, text_lines->lines[2].c_str());
+            tree.add_child(child, text_lines->lines[2].c_str());
+         }
+
+         size_t count = 0;
+         text_tree_t filtered;
+         filter_tree(tree, filtered, if_sibling(make_shared<counting_contains_t>(L"last", count)));
+
+         Assert::AreEqual<size_t>(tree.size(), count);
+         Assert::AreEqual<size_t>(50, filtered.size());
+      }
+
       TEST_METHOD(PrintSimpleTreeWithOrFilter)
 		{
 			text_tree_t filtered;
@@ -290,5 +410,136 @@ namespace dak::tree_reader_tests
          Assert::AreEqual(expected_output, sstream.str().c_str());
       }
 
+      TEST_METHOD(PrintUtf8TreeWithcontainsAndregexFilters)
+      {
+         utf8_text_tree_t tree;
+         auto r0 = tree.add_child(nullptr, "abc");
+         tree.add_child(r0, "d\xC3\xA9" "f");
+         auto r0c1 = tree.add_child(r0, "ghi");
+         tree.add_child(r0c1, "jkl");
+
+         utf8_text_tree_t filtered;
+         filter_tree(tree, filtered, *utf8_contains(L"\u00E9"));
+
+         ostringstream sstream;
+         sstream << filtered;
+
+         Assert::AreEqual("d\xC3\xA9" "f\n", sstream.str().c_str());
+
+         filter_tree(tree, filtered, *utf8_regex(L"[gj]"));
+
+         ostringstream sstream2;
+         sstream2 << filtered;
+
+         const char expected_output[] =
+            "ghi\n"
+            "  jkl\n";
+         Assert::AreEqual(expected_output, sstream2.str().c_str());
+      }
+
+      TEST_METHOD(StatelessFiltersAreClassified)
+      {
+         const vector<tree_filter_ptr_t> stateless = { contains(L"a"), dak::tree_reader::regex(L"b+"), level_range(1, 2), not(contains(L"a")),
+                                                       or(contains(L"a"), and(not(contains(L"b")), min_level(1))), no_child(contains(L"a")), accept() };
+         for (const auto& filter : stateless)
+            Assert::IsTrue(is_stateless_filter(filter));
+
+         const vector<tree_filter_ptr_t> stateful = { unique(), under(contains(L"a")), until(contains(L"a")), stop(), or(contains(L"a"), unique()),
+                                                      not(stop_when_kept(contains(L"a"))), if_subtree(contains(L"a")), if_sibling(contains(L"a")) };
+         for (const auto& filter : stateful)
+            Assert::IsFalse(is_stateless_filter(filter));
+      }
+
+      TEST_METHOD(StreamableFiltersAreClassified)
+      {
+         const vector<tree_filter_ptr_t> streamable = { contains(L"a"), dak::tree_reader::regex(L"b+"), level_range(1, 2), not(contains(L"a")),
+                                                        under(contains(L"a")), until(contains(L"a")), stop(), no_child(contains(L"a")), or(contains(L"a"), and(not(contains(L"b")), min_level(1))) };
+         for (const auto& filter : streamable)
+            Assert::IsTrue(is_streamable_filter(filter));
+
+         const vector<tree_filter_ptr_t> not_streamable = { unique(), if_subtree(contains(L"a")), or(contains(L"a"), unique()),
+                                                            under(if_subtree(contains(L"a"))), if_sibling(contains(L"a")) };
+         for (const auto& filter : not_streamable)
+            Assert::IsFalse(is_streamable_filter(filter));
+      }
+
+      TEST_METHOD(StreamedFilteringGivesSameText)
+      {
+         wstringstream source;
+         source << create_simple_tree();
+         const wstring text = source.str();
+
+         const vector<tree_filter_ptr_t> filters = { accept(), contains(L"g"), dak::tree_reader::regex(L"[jm]"), not(contains(L"f")), level_range(1, 2),
+                                                     under(contains(L"g"), false), or(contains(L"d"), under(contains(L"p"))), and(not(contains(L"s")), max_level(2)),
+                                                     no_child(contains(L"m")), stop_when_kept(contains(L"p")), any({ contains(L"b"), contains(L"kl"), contains(L"wx") }) };
+         for (const auto& filter : filters)
+         {
+            wistringstream tree_stream(text);
+            text_tree_t filtered;
+            filter_tree(load_simple_text_tree(tree_stream), filtered, *filter->clone());
+
+            wostringstream expected;
+            print_tree(expected, filtered, L"--");
+
+            wistringstream input(text);
+            wostringstream streamed;
+            filter_simple_text(input, streamed, *filter->clone(), load_simple_text_tree_options_t(), L"--");
+
+            Assert::AreEqual(expected.str().c_str(), streamed.str().c_str());
+         }
+      }
+
+      TEST_METHOD(NarrowerContainsFiltersAreDetected)
+      {
+         Assert::IsTrue(is_narrower_contains_filter(contains(L"abc"), contains(L"ab")));
+         Assert::IsTrue(is_narrower_contains_filter(contains(L"xabc"), contains(L"bc")));
+         Assert::IsTrue(is_narrower_contains_filter(and(contains(L"ab"), contains(L"d")), contains(L"ab")));
+         Assert::IsTrue(is_narrower_contains_filter(and(contains(L"abc"), contains(L"de")), and(contains(L"d"), contains(L"ab"))));
+
+         Assert::IsFalse(is_narrower_contains_filter(contains(L"ab"), contains(L"abc")));
+         Assert::IsFalse(is_narrower_contains_filter(contains(L"ac"), contains(L"ab")));
+         Assert::IsFalse(is_narrower_contains_filter(contains(L"ab"), and(contains(L"ab"), contains(L"d"))));
+         Assert::IsFalse(is_narrower_contains_filter(or(contains(L"abc"), contains(L"d")), contains(L"ab")));
+         Assert::IsFalse(is_narrower_contains_filter(not(contains(L"abc")), not(contains(L"ab"))));
+         Assert::IsFalse(is_narrower_contains_filter(contains(L"abc"), nullptr));
+      }
+
+      TEST_METHOD(ParallelFilteringGivesSameTree)
+      {
+         // A tree with many small sub-trees, so that each thread filters several of them.
+         text_tree_t tree;
+         auto text_lines = make_shared<text_lines_text_holder_t>();
+         for (size_t index = 0; index < 2000; ++index)
+            text_lines->lines.emplace_back(L"line " + to_wstring(index * 7919 % 1000));
+         tree.source_text_lines = text_lines;
+
+         vector<text_tree_t::node_t*> branch;
+         for (size_t index = 0; index < text_lines->lines.size(); ++index)
+         {
+            const size_t depth = min<size_t>(branch.size(), index % 5);
+            branch.resize(depth);
+            branch.emplace_back(tree.add_child(depth ? branch.back() : nullptr, text_lines->lines[index].c_str()));
+         }
+
+         const vector<tree_filter_ptr_t> filters = { contains(L"7"), dak::tree_reader::regex(L"[13]$"), level_range(1, 2), not(contains(L"5")),
+                                                     no_child(contains(L"9")), or(contains(L"42"), max_level(0)), unique(), under(contains(L"88")) };
+         for (const auto& filter : filters)
+         {
+            // The unique filter remembers the texts it has seen, so each run uses its own copy.
+            text_tree_t serial;
+            filter_tree_in_parallel(tree, serial, *filter->clone(), 1);
+
+            text_tree_t parallel;
+            filter_tree_in_parallel(tree, parallel, *filter->clone(), 4);
+
+            wostringstream serial_stream;
+            serial_stream << serial;
+            wostringstream parallel_stream;
+            parallel_stream << parallel;
+
+            Assert::AreEqual(serial_stream.str().c_str(), parallel_stream.str().c_str());
+         }
+      }
+
    };
 }